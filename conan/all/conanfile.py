@@ -103,6 +103,8 @@ class RealTimeMonitorRecipe(ConanFile):
     def package_info(self):
         self.cpp_info.libs = ["rtm"]
         self.cpp_info.bindirs = ["bin"]
+        if self.settings.os == "Linux":
+            self.cpp_info.system_libs = ["pthread"]
         self.cpp_info.set_property(
             "cmake_build_modules",
             ["cmake/real_time_monitor_recorder_target.cmake"])
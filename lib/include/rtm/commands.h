@@ -2,6 +2,7 @@
 #define RTM_LIB_COMMANDS_H
 
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 
 #include "rtm/io/io.h"
@@ -11,7 +12,7 @@ namespace rtm
     using std::chrono::nanoseconds;
 
     constexpr uint16_t PROTOCOL_MAJOR = 2;
-    constexpr uint16_t PROTOCOL_MINOR = 0;
+    constexpr uint16_t PROTOCOL_MINOR = 1;   // 2.1: DATA_GAP and SET_TRIGGER (see protocol.md)
 
     constexpr uint32_t ESCAPE = (1u << 31);
     enum Command
@@ -21,8 +22,32 @@ namespace rtm
         UPDATE_REFERENCE = (1 << 2),
         SET_THRESHOLD    = (1 << 3),
         DATA_STREAM_END  = (1 << 4),
+        DATA_GAP         = (1 << 5),    // u64 payload: number of datagrams lost upstream
+        SET_TRIGGER      = (1 << 6),    // 16 bytes payload: a TriggerRule (see trigger.h)
     };
 
+    // Size of the stream element (sample or command with its payload) starting with word
+    constexpr std::size_t element_size(uint32_t word)
+    {
+        if (not (word & ESCAPE))
+        {
+            return sizeof(uint32_t);
+        }
+        if (word & (Command::UPDATE_REFERENCE | Command::UPDATE_PERIOD | Command::SET_THRESHOLD | Command::DATA_GAP))
+        {
+            return sizeof(uint32_t) + sizeof(uint64_t);
+        }
+        if (word & Command::SET_TRIGGER)
+        {
+            return sizeof(uint32_t) + 2 * sizeof(uint64_t);
+        }
+        if (word & Command::UPDATE_PRIORITY)
+        {
+            return sizeof(uint32_t) + sizeof(int32_t);
+        }
+        return sizeof(uint32_t);
+    }
+
     template<typename T>
     void write_command(AbstractIO& io, uint32_t command, T value)
     {
@@ -1,6 +1,7 @@
 #ifndef RTM_LIB_DATA_H
 #define RTM_LIB_DATA_H
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -14,6 +15,56 @@ namespace rtm
         double y;
     };
 
+    // Contiguous points owned by someone else (a vector, a mapped file)
+    struct PointSpan
+    {
+        Point const* data{nullptr};
+        std::size_t size{0};
+
+        Point const* begin() const  { return data; }
+        Point const* end() const    { return data + size; }
+        bool empty() const          { return size == 0; }
+    };
+
+    // Points of a Columns owned by someone else (a mapped file): size floats at xs and at ys
+    struct ColumnSpan
+    {
+        double origin{0};
+        float const* xs{nullptr};
+        float const* ys{nullptr};
+        std::size_t size{0};
+    };
+
+    // Points stored by column, 8 bytes each instead of 16: x as a float offset (s) from the
+    // first point, y as a float (ms). Over a 2 min section, x keeps a ~7 µs resolution.
+    class Columns
+    {
+    public:
+        Columns() = default;
+        Columns(Point const* begin, Point const* end);
+        explicit Columns(ColumnSpan const& span);   // copied as is
+
+        void push_back(Point const& point);
+        void decimate();    // keeps one point out of two
+
+        std::size_t size() const    { return xs_.size(); }
+        bool empty() const          { return xs_.empty(); }
+        double x(std::size_t i) const { return origin_ + static_cast<double>(xs_[i]); }
+        double y(std::size_t i) const { return static_cast<double>(ys_[i]); }
+        Point at(std::size_t i) const { return {x(i), y(i)}; }
+
+        // Index of the first point at or after x (lower) / after x (upper)
+        std::size_t lower_bound(double x) const;
+        std::size_t upper_bound(double x) const;
+
+        ColumnSpan span() const     { return {origin_, xs_.data(), ys_.data(), xs_.size()}; }
+
+    private:
+        double origin_{0};
+        std::vector<float> xs_;
+        std::vector<float> ys_;
+    };
+
     // Helper to downsample big series
     // First pass with min/max to decimate a bit
     // Second pass with LTTB
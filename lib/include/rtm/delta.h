@@ -0,0 +1,27 @@
+#ifndef RTM_LIB_DELTA_H
+#define RTM_LIB_DELTA_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "rtm/os/time.h"
+
+namespace rtm
+{
+    // Converts the run of plain deltas (u32 words without the ESCAPE bit, unaligned) at the
+    // beginning of words to reference + delta in out, up to count words: stops on the first
+    // escaped one. Returns the number of samples written.
+    // Uses the widest vector unit available (AVX2 detected at runtime, SSE2, NEON).
+    std::size_t decode_deltas(uint8_t const* words, std::size_t count, nanoseconds reference, nanoseconds* out);
+
+    // Same, one word at a time: the reference implementation.
+    std::size_t decode_deltas_scalar(uint8_t const* words, std::size_t count, nanoseconds reference, nanoseconds* out);
+
+    // Number of plain deltas at the beginning of words, up to count: what decode_deltas() converts.
+    std::size_t delta_run(uint8_t const* words, std::size_t count);
+
+    // Name of the implementation behind decode_deltas(): "avx2", "sse2", "neon" or "scalar".
+    char const* decode_deltas_isa();
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef RTM_LIB_FANOUT_H
+#define RTM_LIB_FANOUT_H
+
+#include <cstdint>
+
+namespace rtm
+{
+    // Live stream sent by the recorder to its subscribers: the data of every client,
+    // multiplexed in frames. A frame is a FrameHeader followed by size bytes of payload.
+    namespace fanout
+    {
+        enum FrameType : uint16_t
+        {
+            // A client is available. Payload: u64 current reference (0 if none yet),
+            // the tick header of the client, UPDATE_PERIOD and UPDATE_PRIORITY commands.
+            // Samples deltas of the following DATA frames are relative to this reference
+            // until the next UPDATE_REFERENCE. They start on a start sample: a subscriber joining
+            // in the middle of a pair is announced the client at its next start.
+            CLIENT_BEGIN = 1,
+
+            // Raw tick stream elements of the client (never split across frames).
+            CLIENT_DATA  = 2,
+
+            // The client is gone. No payload.
+            CLIENT_END   = 3,
+        };
+
+        struct FrameHeader
+        {
+            uint32_t client_id;
+            uint16_t type;
+            uint16_t reserved;
+            uint32_t size;
+        };
+        static_assert(sizeof(FrameHeader) == 12);
+    }
+}
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef RTM_LIB_IO_ASYNC_H
+#define RTM_LIB_IO_ASYNC_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rtm/io/io.h"
+
+namespace rtm
+{
+    // Background thread executing jobs in submission order.
+    class IOWorker
+    {
+    public:
+        IOWorker();
+        ~IOWorker(); // executes the pending jobs before returning
+
+        IOWorker(IOWorker const&) = delete;
+        IOWorker& operator=(IOWorker const&) = delete;
+
+        void post(std::function<void()>&& job);
+
+        // Block until every job posted so far has been executed.
+        void wait_idle();
+
+    private:
+        void run();
+
+        std::mutex mutex_;
+        std::condition_variable wake_up_;
+        std::condition_variable idle_;
+        std::deque<std::function<void()>> jobs_;
+        bool busy_{false};
+        bool stop_{false};
+        std::thread thread_;
+    };
+
+
+    // Decorator handing every operation on the wrapped IO to an IOWorker:
+    // open/write/sync/close return immediately and are executed in order in
+    // the background. Small writes are staged and submitted in batches.
+    // Errors are reported by the worker since the caller is long gone.
+    class AsyncIO final : public AbstractIO
+    {
+    public:
+        AsyncIO(std::unique_ptr<AbstractIO> io, std::shared_ptr<IOWorker> worker);
+        virtual ~AsyncIO();
+
+        int64_t read(void* data, int64_t data_size) override;
+        int64_t write(void const* data, int64_t data_size) override;
+        std::error_code seek(int64_t pos) override;
+        std::error_code sync() override;
+
+        // Hand a buffer over without copying it.
+        int64_t write(std::vector<uint8_t>&& buffer);
+
+        // Run a job on the wrapped IO, ordered with the writes.
+        void post(std::function<void(AbstractIO&)>&& job);
+
+    private:
+        std::error_code do_open(access::Mode mode) override;
+        std::error_code do_close() override;
+
+        void submit();
+
+        static constexpr std::size_t STAGING_SIZE = 64 * 1024;
+
+        std::shared_ptr<AbstractIO> io_;
+        std::shared_ptr<IOWorker> worker_;
+        std::vector<uint8_t> staging_{};
+    };
+}
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef RTM_LIB_IO_DATAGRAM_H
+#define RTM_LIB_IO_DATAGRAM_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "rtm/io/io.h"
+#include "rtm/io/posix/udp_socket.h"
+#include "rtm/os/time.h"
+#include "rtm/trigger.h"
+
+namespace rtm
+{
+    // Tick stream over an unreliable transport (UDP): a lost datagram is lost, the stream goes on.
+    // A datagram is a Header followed by size bytes of payload. The sequence number of a channel
+    // grows by one per datagram, so that the receiver knows how many were lost.
+    namespace datagram
+    {
+        constexpr uint32_t MAGIC = 0x444d5452;  // "RTMD"
+        constexpr std::size_t MAX_SIZE = 1400;  // fits in the usual MTUs: no IP fragmentation
+
+        enum Type : uint16_t
+        {
+            // Payload: the tick header of the stream, UPDATE_PERIOD and UPDATE_PRIORITY commands,
+            // then the SET_THRESHOLD and SET_TRIGGER commands of the probe, if any.
+            // Repeated regularly so that a receiver survives the loss of the first one, and right
+            // after the data carrying a SET_THRESHOLD or a SET_TRIGGER: the receiver replays the
+            // commands of the first header following a loss.
+            STREAM_HEADER = 1,
+
+            // Payload: commands and whole pairs of samples. Self-contained: the first sample is
+            // an UPDATE_REFERENCE and the following deltas are relative to the batch only.
+            STREAM_DATA   = 2,
+
+            // The probe is gone. No payload.
+            STREAM_END    = 3,
+        };
+
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t channel;   // random, tells apart the streams of a same sender
+            uint64_t sequence;
+            uint16_t type;
+            uint16_t flags;     // 0 over UDP (see relay.h)
+            uint32_t size;
+        };
+        static_assert(sizeof(Header) == 24);
+    }
+
+    // Probe side: cut the tick stream written by a Probe in datagrams, sent through io
+    // (typically a connected UdpSocket). The complete pairs are sent at the end of every write.
+    class DatagramWriter final : public AbstractIO
+    {
+    public:
+        DatagramWriter(std::unique_ptr<AbstractIO> io);
+        ~DatagramWriter();
+
+        int64_t read(void* data, int64_t data_size) override;
+        int64_t write(void const* data, int64_t data_size) override;
+
+        // Data datagrams sent between two STREAM_HEADER
+        static constexpr uint32_t HEADER_REPEAT = 64;
+
+    protected:
+        std::error_code do_open(access::Mode mode) override;
+        std::error_code do_close() override;
+
+    private:
+        void send(datagram::Type type, std::vector<uint8_t>& datagram);
+        void send_header();
+        void send_batches();
+
+        std::unique_ptr<AbstractIO> io_;
+        uint32_t channel_;
+        uint64_t sequence_{0};
+        uint32_t since_header_{0};
+        bool ended_{false};
+
+        std::vector<uint8_t> tick_header_{};
+        std::vector<uint8_t> pending_{};    // written but not sent yet, starts on a pair boundary
+
+        // Stream state at the beginning of pending_
+        nanoseconds reference_{0};
+        nanoseconds period_{0};
+        int32_t priority_{0};
+
+        // Blackbox configuration of the probe, as last set
+        bool has_threshold_{false};
+        nanoseconds threshold_{0};
+        std::vector<TriggerRule> triggers_{};   // one per kind
+    };
+
+    // Rebuild the tick stream of every channel from its datagrams, to be handed to
+    // Recorder::add_client(). Lost datagrams are recorded in the stream as a DATA_GAP command.
+    // UDP has no backpressure: the data datagrams that would grow a stream past QUEUE_CAPACITY
+    // bytes not read yet by the recorder are dropped, and recorded as lost.
+    class DatagramAssembler
+    {
+    public:
+        // A stream silent for idle_timeout is closed (its STREAM_END may have been lost).
+        DatagramAssembler(nanoseconds idle_timeout);
+
+        // sender identifies the origin of the datagram: a stream is a sender and a channel.
+        // The streams started by this datagram are appended to started.
+        void dispatch(std::string sender, uint8_t const* data, std::size_t size, nanoseconds now,
+                      std::vector<std::unique_ptr<AbstractIO>>& started);
+
+        // Forget the streams released by the recorder, close the silent ones.
+        void expire(nanoseconds now);
+
+        uint64_t dropped() const { return dropped_; } // datagrams lost, every stream together
+
+        static constexpr std::size_t QUEUE_CAPACITY = 4 * 1024 * 1024;
+
+    private:
+        struct Queue;
+        class Stream;
+
+        struct Channel
+        {
+            std::shared_ptr<Queue> queue{};
+            uint64_t next_sequence{0};
+            nanoseconds last_seen{0};
+            uint64_t lost{0};           // datagrams lost, not recorded in the stream yet
+            bool resync{false};         // datagrams lost since the last STREAM_HEADER
+        };
+
+        nanoseconds idle_timeout_;
+        std::unordered_map<std::string, Channel> channels_{};
+        uint64_t dropped_{0};
+    };
+
+    // Recorder side: receive the datagrams of every probe on a UDP port. A stream is identified
+    // by the sender address and the channel.
+    class DatagramListener
+    {
+    public:
+        DatagramListener(uint16_t port, nanoseconds idle_timeout = 10s);
+
+        std::error_code listen();
+
+        // Drain the pending datagrams. Returns the streams that started since the last call.
+        std::vector<std::unique_ptr<AbstractIO>> receive();
+
+        uint64_t dropped() const { return assembler_.dropped(); }
+
+        static constexpr std::size_t BATCH = 32;
+
+    private:
+        UdpSocket socket_;
+        std::vector<ReceivedDatagram> batch_;
+        DatagramAssembler assembler_;
+    };
+}
+
+#endif
@@ -9,6 +9,11 @@
 
 namespace rtm
 {
+    // With access::Mode::DIRECT, the writes bypass the page cache (O_DIRECT): they are
+    // staged in an aligned block. The aligned parts of the block are written once, by sync(),
+    // close() or when the block is full; the unaligned tail is written by sync() and close()
+    // through a second descriptor that uses the page cache, so the file never holds padding.
+    // DIRECT is for sequential writes only (no read, seek nor append).
     class File final : public AbstractIO
     {
     public:
@@ -20,13 +25,27 @@ namespace rtm
         std::error_code seek(int64_t pos) override;
         std::error_code truncate(int64_t size) override;
         std::error_code sync() override;
+        os_file native_handle() const override;
+
+        static constexpr std::size_t DIRECT_ALIGNMENT = 4096;
+        static constexpr std::size_t DIRECT_BLOCK_SIZE = 64 * 1024;
 
     private:
         std::error_code do_open(access::Mode) override;
         std::error_code do_close() override;
 
+        int64_t write_direct(void const* data, int64_t data_size);
+        std::error_code flush_direct(); // write the bytes of the current block not in the file yet
+
         os_file fd_;
         std::string filename_;
+
+        uint8_t* block_{nullptr};       // DIRECT mode staging block
+        std::size_t block_used_{0};
+        std::size_t block_direct_{0};   // bytes of the block written with O_DIRECT (aligned)
+        std::size_t block_synced_{0};   // bytes of the block in the file
+        int64_t block_offset_{0};       // file offset of the block
+        os_file tail_fd_{-1};           // DIRECT mode: writes the unaligned tail
     };
 }
 
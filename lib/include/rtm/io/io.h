@@ -4,6 +4,7 @@
 #include <cstdint>
 
 #include "rtm/error.h"
+#include "rtm/os/types.h"
 
 namespace rtm
 {
@@ -21,6 +22,7 @@ namespace rtm
             NEW_ONLY        = 0x040,
             EXISTING_ONLY   = 0x080,
             NON_BLOCKING    = 0x100,
+            DIRECT          = 0x200,    // bypass the page cache (write only)
         };
 
         constexpr enum Mode operator |  (Mode const& lhs, Mode const& rhs) { return static_cast<enum Mode>(static_cast<int>(lhs) | static_cast<int>(rhs)); }
@@ -56,6 +58,9 @@ namespace rtm
         virtual std::error_code truncate(int64_t size);
         virtual std::error_code sync();
 
+        // OS handle for zero-copy transfers (splice), -1 if the IO has none.
+        virtual os_file native_handle() const;
+
     protected:
         virtual std::error_code do_open(access::Mode mode) = 0;
         virtual std::error_code do_close() = 0;
@@ -0,0 +1,42 @@
+#ifndef RTM_LIB_IO_MAPPED_FILE_H
+#define RTM_LIB_IO_MAPPED_FILE_H
+
+#include <string>
+#include <string_view>
+
+#include "rtm/io/io.h"
+#include "rtm/os/mapping.h"
+
+namespace rtm
+{
+    // Read-only file mapped in memory as a whole. read() and seek() work as for a File, but the
+    // content is also reachable in place through data(): readers that know about it (Parser)
+    // decode from the mapping without copying. Opened for a sequential read.
+    class MappedFile final : public AbstractIO
+    {
+    public:
+        MappedFile(std::string_view filename);
+        virtual ~MappedFile();
+
+        int64_t read(void* data, int64_t data_size) override;
+        int64_t write(void const* data, int64_t data_size) override;
+        std::error_code seek(int64_t pos) override;
+
+        uint8_t const* data() const { return mapping_.data(); }    // nullptr for an empty file
+        std::size_t size() const    { return mapping_.size(); }
+        std::size_t position() const { return position_; }
+
+        // See MemoryMapping::advise()
+        void advise(std::size_t offset, std::size_t size, MemoryMapping::Advice advice) const;
+
+    private:
+        std::error_code do_open(access::Mode) override;
+        std::error_code do_close() override;
+
+        std::string filename_;
+        MemoryMapping mapping_{};
+        std::size_t position_{0};
+    };
+}
+
+#endif
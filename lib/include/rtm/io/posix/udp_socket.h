@@ -1,6 +1,7 @@
 #ifndef RTM_LIB_IO_POSIX_UDP_SOCKET_H
 #define RTM_LIB_IO_POSIX_UDP_SOCKET_H
 
+#include <array>
 #include <cstdint>
 #include <string>
 #include <string_view>
@@ -9,6 +10,17 @@
 
 namespace rtm
 {
+    /// A datagram received by UdpSocket::read_batch().
+    struct ReceivedDatagram
+    {
+        static constexpr std::size_t CAPACITY = 2048;
+
+        std::array<uint8_t, CAPACITY> data;
+        std::size_t size{0};                ///< May exceed CAPACITY: the datagram was truncated.
+        std::array<uint8_t, 128> source;    ///< Raw address of the sender.
+        uint32_t source_size{0};
+    };
+
     /// UDP socket that can operate in connected or unconnected mode.
     /// In connected mode (host + port provided), read/write use the connected peer.
     /// Use bind_port to receive on a specific port.
@@ -24,6 +36,13 @@ namespace rtm
 
         ~UdpSocket();
 
+        /// Receive up to count datagrams, with a single syscall where available (recvmmsg).
+        /// Only waits for the first one on a blocking socket.
+        /// Returns the number of datagrams received, or -1 with errno set (EAGAIN: none pending).
+        int64_t read_batch(ReceivedDatagram* datagrams, std::size_t count);
+
+        static constexpr std::size_t MAX_BATCH = 64;
+
     private:
         std::error_code do_open(access::Mode mode) override;
 
@@ -10,6 +10,10 @@ namespace rtm
 {
     class AbstractListener;
 
+    // Pending connections of a listener, for a fleet of probes (re)connecting at once.
+    // The kernel caps it (net.core.somaxconn on Linux).
+    constexpr int LISTEN_BACKLOG = 4096;
+
     class AbstractSocket : public AbstractIO
     {
     public:
@@ -18,6 +22,7 @@ namespace rtm
 
         int64_t read(void* data, int64_t data_size) override;
         int64_t write(void const* data, int64_t data_size) override;
+        os_file native_handle() const override { return is_open() ? fd_ : -1; }
 
     protected:
         std::error_code do_close() override;
@@ -32,9 +37,14 @@ namespace rtm
         virtual ~AbstractListener() = default;
 
         virtual std::error_code listen(int backlog) = 0;
+
+        // nullptr when no connection is pending: call it until then to drain the backlog.
         virtual std::unique_ptr<AbstractSocket> accept(access::Mode mode) = 0;
 
     protected:
+        // Accepted socket with close-on-exec set, non-blocking per mode in the same call. -1 if none.
+        os_socket accept_socket(access::Mode mode);
+
         os_socket fd_{};
     };
 }
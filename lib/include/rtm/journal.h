@@ -0,0 +1,55 @@
+#ifndef RTM_LIB_JOURNAL_H
+#define RTM_LIB_JOURNAL_H
+
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "rtm/os/mapping.h"
+#include "rtm/os/time.h"
+
+namespace rtm
+{
+    // Crash-surviving copy of a blackbox ring: a circular log of ring chunks kept in a
+    // memory-mapped file. Appending is a few memory stores, the page cache does the rest.
+    // A journal left behind by a dead recorder is turned back into a .tick file by
+    // recover_journal().
+    //
+    // Layout: a header page (stream state, tail/head logical offsets, tick header),
+    // then a circular data area of self-describing records. A record never wraps:
+    // the end of the data area is filled with a padding record instead.
+    class Journal
+    {
+    public:
+        static constexpr char const* EXTENSION = ".journal";
+
+        static constexpr uint32_t LEADING_REFERENCE = 1 << 0; // record data starts with UPDATE_REFERENCE
+        static constexpr uint32_t PAIR_ALIGNED      = 1 << 1; // record data starts on a start sample
+
+        std::error_code create(std::string const& path, std::vector<uint8_t> const& tick_header, std::size_t capacity);
+        void remove(); // unmap and delete the file
+
+        // Oldest records are dropped to make room. Returns false if the record is bigger than the journal.
+        bool append(nanoseconds entry_reference, nanoseconds first_sample_time,
+                    uint32_t sample_count, uint32_t flags,
+                    uint8_t const* data, std::size_t data_size);
+        void drop_oldest();
+        void clear();
+
+        void set_stream_state(nanoseconds period, int32_t priority);
+
+        uint32_t records() const;
+        bool is_open() const { return mapping_.is_mapped(); }
+
+    private:
+        uint8_t* data_area() const;
+
+        MemoryMapping mapping_{};
+        std::string path_{};
+    };
+
+    // Write the content of a journal as a standalone .tick file in output_dir.
+    std::error_code recover_journal(std::string const& journal_path, std::string const& output_dir, std::string& tick_path);
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef RTM_LIB_LOD_CACHE_H
+#define RTM_LIB_LOD_CACHE_H
+
+#include <array>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "rtm/data.h"
+#include "rtm/os/mapping.h"
+#include "rtm/os/time.h"
+
+namespace rtm
+{
+    // Identifies the content a cache was built from: any change of the tick file makes it stale.
+    struct LodKey
+    {
+        uint64_t file_size{0};
+        int64_t  file_time{0};              // last modification, in the file clock ticks
+        std::array<uint8_t, 16> uuid{};
+        uint32_t overview_size{0};          // downsampling threshold of the overviews
+    };
+
+    // Points of a serie over a time window (see Serie in the monitor), in seconds
+    struct LodSection
+    {
+        double min{0};
+        double max{0};
+        ColumnSpan points{};
+    };
+
+    // One plotted serie of a tick file: all its points, by section, and its downsampled overview
+    struct LodSerie
+    {
+        std::vector<LodSection> sections{};
+        ColumnSpan overview{};
+        milliseconds_f min{};
+        milliseconds_f max{};
+    };
+
+    // What a cache holds: enough to plot a tick file without decoding it. Times are relative to
+    // the start time, as Parser::samples().
+    struct LodContent
+    {
+        nanoseconds begin{0};
+        nanoseconds end{0};
+        int64_t sentinel_pos{0};            // see TickHeader
+        uint64_t dropped{0};                // see Parser::dropped()
+        LodSerie diff{};
+        LodSerie up{};
+    };
+
+    // Level-of-detail sidecar of a tick file ("<file>.tick.lod"): its decoded series, their
+    // overviews and bounds, in the Columns layout (see data.h: 8 bytes per point, about twice
+    // the size of the recording). Reopening a file with a valid cache skips its decoding, its
+    // downsampling and the conversion of its points.
+    //
+    // Layout: a header (key, bounds, then the overview and the section table of each serie),
+    // the section tables, then the float arrays of every column, cache line aligned.
+    class LodCache
+    {
+    public:
+        static constexpr char const* EXTENSION = ".lod";
+
+        // Key of the tick file as it is now: take it before decoding the file to cache
+        static LodKey key_of(std::string const& tick_path, std::array<uint8_t, 16> const& uuid, uint32_t overview_size);
+
+        // Map the cache of tick_path. Fails if it is missing, invalid or built from another content.
+        std::error_code open(std::string const& tick_path, LodKey const& key);
+
+        // Write the cache of tick_path. The previous one is replaced at once: readers never see
+        // a partial cache.
+        static std::error_code write(std::string const& tick_path, LodKey const& key, LodContent const& content);
+
+        // Available once opened. Columns stay valid as long as the cache is.
+        LodContent const& content() const   { return content_; }
+
+    private:
+        MemoryMapping mapping_{};
+        LodContent content_{};
+    };
+}
+
+#endif
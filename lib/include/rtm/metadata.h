@@ -4,8 +4,10 @@
 #include <cstdint>
 #include <filesystem>
 #include <string>
+#include <vector>
 
 #include "rtm/io/io.h"
+#include "rtm/summary.h"
 
 namespace rtm
 {
@@ -14,6 +16,7 @@ namespace rtm
         DISPLAY_NAME        = 1,
         DEFAULT_VISIBILITY  = 2,
         DISPLAY_WEIGHT      = 3,
+        SUMMARY_INDEX       = 4,
         USER_INFO           = 0xFFFF,
     };
 
@@ -24,8 +27,12 @@ namespace rtm
         std::string display_name;
         uint8_t default_visibility = 1; // 0 = hidden, 1 = visible
         int32_t display_weight = 0;
+        std::vector<SummaryBlock> summary;  // written by the recorder, see summary.h
     };
 
+    // entry_count followed by the entries
+    std::vector<uint8_t> serialize_footer(TickMetadata const& metadata);
+
     void save_metadata(AbstractIO& io, TickHeader const& header, TickMetadata const& metadata);
     void repair_sentinel(AbstractIO& io, int64_t eof_pos);
 
@@ -0,0 +1,90 @@
+#ifndef RTM_LIB_METRICS_H
+#define RTM_LIB_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "rtm/os/time.h"
+
+namespace rtm
+{
+    // Latency distribution over fixed buckets (a Prometheus histogram).
+    class LatencyHistogram
+    {
+    public:
+        static constexpr std::array<nanoseconds, 15> BOUNDS
+        {{
+            50us, 100us, 250us, 500us, 1ms, 2500us, 5ms, 10ms, 25ms, 50ms, 100ms, 250ms, 500ms, 1s, 2500ms
+        }};
+
+        void record(nanoseconds latency);
+
+        uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+        // Upper bound of the bucket holding the quantile q (nanoseconds::max() past the last bound).
+        nanoseconds quantile(double q) const;
+
+        void write_prometheus(std::string& out, char const* name, char const* help) const;
+
+    private:
+        std::array<std::atomic<uint64_t>, BOUNDS.size() + 1> buckets_{}; // the last one is +Inf
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> sum_{0}; // ns
+    };
+
+    // Counters of one client, updated by the recorder.
+    struct ClientMetrics
+    {
+        uint64_t id{0};
+        std::string process{};
+        std::string source{};
+
+        std::atomic<uint64_t> bytes{0};             // received
+        std::atomic<uint64_t> samples{0};           // received
+        std::atomic<uint64_t> backlog_bytes{0};     // received but not processed/written yet
+        std::atomic<uint64_t> ring_bytes{0};        // blackbox ring, in memory and spilled
+        std::atomic<uint64_t> triggers{0};
+    };
+
+    // Health of a recorder. Every counter is a relaxed atomic: any thread may read them at any
+    // time, the recorder never waits for a reader. Only the client list is behind a lock.
+    class RecorderMetrics
+    {
+    public:
+        std::shared_ptr<ClientMetrics> add_client(uint64_t id, std::string const& process, std::string const& source);
+        void remove_client(std::shared_ptr<ClientMetrics> const& client);
+
+        // Prometheus text exposition format (version 0.0.4)
+        std::string prometheus() const;
+
+        // One line of the main figures. Rates are computed since the previous call:
+        // a single thread shall call it.
+        std::string summary();
+
+        // Totals, gone clients included
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> samples{0};
+        std::atomic<uint64_t> triggers{0};
+        std::atomic<uint64_t> subscribers_dropped{0};
+        std::atomic<uint64_t> write_errors{0};          // failed writes/syncs of the recordings
+        std::atomic<uint64_t> recordings_deleted{0};    // to respect the quota
+        std::atomic<uint64_t> recorded_bytes{0};        // gauge: recordings on disk (see retention.h)
+
+        LatencyHistogram sync_latency{};    // fsync of the recording files
+        LatencyHistogram write_latency{};   // from the reception of the data to its fsync
+
+    private:
+        mutable std::mutex mutex_;
+        std::vector<std::shared_ptr<ClientMetrics>> clients_{};
+
+        nanoseconds last_summary_{0};
+        uint64_t last_bytes_{0};
+        uint64_t last_samples_{0};
+    };
+}
+
+#endif
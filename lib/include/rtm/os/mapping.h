@@ -0,0 +1,45 @@
+#ifndef RTM_LIB_OS_MAPPING_H
+#define RTM_LIB_OS_MAPPING_H
+
+#include <cstdint>
+#include <string>
+#include <system_error>
+
+namespace rtm
+{
+    // Shared memory mapping of a file: stores land in the page cache and
+    // survive the process.
+    class MemoryMapping
+    {
+    public:
+        MemoryMapping() = default;
+        ~MemoryMapping();
+
+        MemoryMapping(MemoryMapping&& other) noexcept;
+        MemoryMapping& operator=(MemoryMapping&& other) noexcept;
+
+        // Map path in memory. When writable, the file is created if needed and resized to size.
+        // Otherwise size is ignored and the whole file is mapped.
+        std::error_code map(std::string const& path, std::size_t size, bool writable);
+        void unmap();
+
+        enum class Advice
+        {
+            SEQUENTIAL, // read ahead aggressively, drop the pages behind
+            WILL_NEED,  // start reading the range now
+        };
+
+        // Hint the kernel on the access pattern of [offset, offset + size). Best effort.
+        void advise(std::size_t offset, std::size_t size, Advice advice) const;
+
+        uint8_t* data() const      { return data_; }
+        std::size_t size() const   { return size_;  }
+        bool is_mapped() const     { return data_ != nullptr; }
+
+    private:
+        uint8_t* data_{nullptr};
+        std::size_t size_{0};
+    };
+}
+
+#endif
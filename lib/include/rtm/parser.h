@@ -3,6 +3,7 @@
 
 #include <array>
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -14,6 +15,7 @@
 #include "rtm/io/io.h"
 #include "rtm/metadata.h"
 #include "rtm/os/time.h"
+#include "rtm/trigger.h"
 
 namespace rtm
 {
@@ -53,6 +55,35 @@ namespace rtm
         std::string_view process,
         std::string_view task);
 
+    // Receives the content of a tick file in stream order, see Parser::visit(). Times are relative
+    // to the start time, as Parser::samples(). Control events are ignored unless overridden.
+    class TickVisitor
+    {
+    public:
+        virtual ~TickVisitor() = default;
+
+        // One loop: a start/end pair of samples. Returns false to stop the visit.
+        virtual bool on_loop(nanoseconds start, nanoseconds end) = 0;
+
+        virtual void on_period(nanoseconds)         {}
+        virtual void on_priority(int32_t)           {}
+        virtual void on_threshold(nanoseconds)      {}
+        virtual void on_trigger(TriggerRule const&) {}
+        virtual void on_gap(uint64_t)               {}  // datagrams lost upstream
+        virtual void on_unfinished(nanoseconds)     {}  // a start without its end, at the end of the stream
+    };
+
+    // Both plotted series of a file in one pass, see Parser::load_series(). Points are as
+    // generate_times_diff() and generate_times_up() return them, statistics are in ns.
+    struct TickSeries
+    {
+        std::vector<Point> diff;    // start to start
+        std::vector<Point> up;      // end - start
+        SummaryStats diff_stats{};
+        SummaryStats up_stats{};
+    };
+
+    // Reads a tick file from any IO. With a MappedFile, the samples are decoded in place.
     class Parser
     {
     public:
@@ -62,29 +93,107 @@ namespace rtm
         void load_header();
         void print_header();
 
-        // TODO: support begin/end
-        // if end = 0, takes alls samples
-        // if begin/end is negative, reference is end, otherwise it is begin (relative)
         bool load_samples();
 
+        // Samples within [begin, end] only, rounded to whole start/end pairs.
+        // if end = 0, takes all samples up to the last one
+        // if begin/end is negative, reference is end, otherwise it is begin (relative)
+        // With the summary index (call load_metadata() first), only the blocks overlapping the
+        // range are decoded: dropped() then counts the gaps of those blocks, and the sentinel
+        // is only checked if the last block is. Without, a MappedFile ending with its sentinel is
+        // decoded from a reference update found back from its end, far enough to cover the range
+        // (dropped() counts the gaps from there); otherwise the whole file is decoded and trimmed.
+        bool load_samples(nanoseconds begin, nanoseconds end = 0ns);
+
+        // Same result as load_samples(), with the data section split in segments decoded on
+        // threads (0: one per core). Needs a MappedFile, otherwise (or for a small file) it is
+        // load_samples(). Call load_metadata() first to split on the summary index blocks
+        // instead of scanning for reference updates.
+        bool load_samples_parallel(std::size_t threads = 0);
+
         void load_metadata();
 
+        // Follows a file still being written: each call decodes the bytes appended since the
+        // previous one (the whole data section the first time) and appends them to samples().
+        // A torn trailing element is decoded by the next call, once complete. Stops once the
+        // sentinel or an unknown command is reached. Needs an IO which sees the appended bytes
+        // (File, not MappedFile). Returns the number of new samples.
+        std::size_t poll_samples();
+
+        // Streams the data section to visitor in bounded memory: nothing is stored in samples().
+        // A start without its end at the end of the stream is not a loop: it is passed to
+        // on_unfinished(). The sentinel position and dropped() are updated as by load_samples().
+        // Returns false if the visitor stopped it.
+        bool visit(TickVisitor& visitor);
+        bool visit(std::function<bool(nanoseconds start, nanoseconds end)> const& on_loop);
+
         TickHeader const& header() const                   { return header_;    }
         TickMetadata const& metadata() const               { return metadata_;  }
         std::vector<nanoseconds> const& samples() const    { return samples_;   }
 
-        std::vector<Point> generate_times_diff();
-        std::vector<Point> generate_times_up();
+        // Summary index written by the recorder at the end of the file (see summary.h), once
+        // load_metadata() is called. Empty for files not closed by a recorder.
+        std::vector<SummaryBlock> const& summary() const   { return metadata_.summary; }
 
-        nanoseconds begin() const;          // only available after a call to load_samples()
-        nanoseconds end() const;            // only available after a call to load_samples()
+        // Samples count, time range and period/up time statistics within [begin, end] (relative
+        // to the start time, as samples()) from the summary index alone, rounded to whole blocks.
+        // Returns false without index.
+        bool overview(SummaryBlock& out, nanoseconds begin = nanoseconds::min(), nanoseconds end = nanoseconds::max()) const;
 
-        milliseconds_f diff_min() const;    // only available after a call to generate_times_diff
-        milliseconds_f diff_max() const;    // only available after a call to generate_times_diff
-        milliseconds_f up_min() const;      // only available after a call to generate_times_up
-        milliseconds_f up_max() const;      // only available after a call to generate_times_up
+        // Points of samples() from the sample index from (i.e. the samples appended since)
+        std::vector<Point> generate_times_diff(std::size_t from = 0);
+        std::vector<Point> generate_times_up(std::size_t from = 0);
+
+        // load_samples() + generate_times_diff() + generate_times_up() fused in a single pass over
+        // the data, without storing samples(): begin(), end() and the min/max are also updated.
+        // Returns false without samples.
+        bool load_series(TickSeries& out);
+
+        nanoseconds begin() const;          // only available after a call to load_samples() or load_series()
+        nanoseconds end() const;            // only available after a call to load_samples() or load_series()
+
+        milliseconds_f diff_min() const;    // only available after a call to generate_times_diff or load_series()
+        milliseconds_f diff_max() const;    // only available after a call to generate_times_diff or load_series()
+        milliseconds_f up_min() const;      // only available after a call to generate_times_up or load_series()
+        milliseconds_f up_max() const;      // only available after a call to generate_times_up or load_series()
+
+        uint64_t dropped() const            { return dropped_; } // datagrams lost upstream, see load_samples()
 
     private:
+        enum class DecodeStatus
+        {
+            MORE,   // stopped at the end of the range, maybe in the middle of an element
+            END,    // stopped at the DATA_STREAM_END sentinel
+            ERROR,  // stopped at an unknown command
+        };
+
+        struct DecodeState
+        {
+            nanoseconds reference{0};           // absolute reference in effect
+            std::vector<nanoseconds> samples;   // relative to the start time
+            uint64_t dropped{0};
+            DecodeStatus status{DecodeStatus::MORE};
+            uint32_t unknown{0};                // the command that stopped the decoding on ERROR
+        };
+
+        // Decode the complete elements of [pos, end) in state. Returns where it stopped.
+        static uint8_t const* decode(uint8_t const* pos, uint8_t const* end, nanoseconds start_time, DecodeState& state);
+
+        // Reads the data version and returns the offset of the first element
+        int64_t seek_data_section();
+
+        // Decode the file from offset from to offset to (the end of the file if negative), starting
+        // with state. Returns the offset where it stopped.
+        int64_t decode_file(int64_t from, int64_t to, DecodeState& state);
+        void set_sentinel(DecodeStatus status, int64_t offset);
+
+        // load_samples(begin, end) without index: decode a MappedFile from a reference
+        // update before begin, if the data reaches the sentinel. Returns false otherwise.
+        bool decode_tail(int64_t data_start, nanoseconds begin, DecodeState& state);
+
+        // Ends a load_samples*() with its decoded data
+        bool store_samples(DecodeState&& state);
+
         std::unique_ptr<AbstractIO> io_;
 
         TickHeader header_;
@@ -96,6 +205,12 @@ namespace rtm
         milliseconds_f up_min_{nanoseconds::max()};
         milliseconds_f up_max_{-1ns};
         std::vector<nanoseconds> samples_;
+        uint64_t dropped_{0};
+
+        // poll_samples() progress
+        int64_t poll_offset_{-1};           // next element to decode, -1 before the first poll
+        nanoseconds poll_reference_{0};
+        bool poll_done_{false};
     };
 }
 
@@ -9,6 +9,7 @@
 
 #include "rtm/io/io.h"
 #include "rtm/os/time.h"
+#include "rtm/trigger.h"
 
 namespace rtm
 {
@@ -42,6 +43,7 @@ namespace rtm
         void update_priority(int32_t priority);
         void update_period(nanoseconds period);
         void set_threshold(nanoseconds threshold);
+        void set_trigger(TriggerRule const& rule);  // a blackbox trigger condition (see trigger.h)
         void log(nanoseconds timestamp = since_epoch());
         void flush();
 
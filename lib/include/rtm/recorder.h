@@ -3,13 +3,29 @@
 
 #include <deque>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "rtm/io/io.h"
+#include "rtm/journal.h"
+#include "rtm/metrics.h"
+#include "rtm/relay.h"
 #include "rtm/os/time.h"
+#include "rtm/retention.h"
+#include "rtm/trigger.h"
 
 namespace rtm
 {
+    class AsyncIO;
+    class IOWorker;
+
+    struct RecorderStats
+    {
+        std::size_t clients{0};
+        std::size_t ring_ram_bytes{0};      // blackbox ring data held in memory
+        std::size_t ring_spilled_bytes{0};  // blackbox ring data spilled to disk
+    };
+
     class Recorder
     {
     public:
@@ -24,20 +40,134 @@ namespace rtm
         void add_client(std::unique_ptr<AbstractIO>&& io);
         void process();
 
+        // Cap the memory used by all the blackbox rings together (0 = unlimited).
+        // Past the budget, the oldest ring chunks are moved to per-client
+        // append-only files in spill_path (default: <recording_path>/.spill)
+        // and read back on trigger.
+        void set_memory_budget(std::size_t bytes, std::string_view spill_path = {});
+
+        // When enabled, a trigger on any blackbox client dumps every buffering
+        // client over the same wall-clock window, into a shared incident
+        // directory (<recording_path>/incident_<trigger time>) with a manifest.
+        void set_correlated_trigger(bool enable);
+
+        // Split continuous recordings in segments of at most max_size bytes and/or
+        // max_interval of samples (0 = no limit). Each segment is a standalone .tick file
+        // named <recording>.NNNN.tick, listed with its time range in <recording>.segments.
+        void set_rotation(std::size_t max_size, nanoseconds max_interval);
+
+        // Stream the data of every client to subscribers (see fanout.h). Must be enabled
+        // before the clients connect: the stream is followed from its very first element.
+        void enable_fanout();
+
+        // The subscriber only has to read, never to write. Subscribers that fall behind
+        // by more than SUBSCRIBER_BACKLOG bytes are dropped.
+        void add_subscriber(std::unique_ptr<AbstractIO>&& io);
+
+        // Move the data of continuous recordings from the socket to the file without copying it
+        // to user space (Linux splice()), once the mode is decided. Falls back to the copying path
+        // when not available. Spliced data is not interpreted: it is not published to subscribers
+        // (no splice when the fan-out is enabled) and its samples are not counted in the metrics.
+        void set_splice(bool enable);
+
+        // Write the recordings with access::Mode::DIRECT: bypass the page cache.
+        void set_direct_io(bool enable);
+
+        // Keep the .tick files under recording_path within max_bytes (0 = unlimited) by deleting
+        // the oldest complete recordings (see retention.h). The recordings already there are
+        // scanned a few entries per process() call.
+        void set_quota(uint64_t max_bytes);
+
+        // Trigger condition of every blackbox client, unless the probe sets its own rule of the
+        // same kind (SET_TRIGGER). Probes that set neither a threshold nor a rule are still
+        // recorded continuously. Returns false if the rule is invalid (see trigger.h).
+        bool add_trigger(TriggerRule const& rule);
+
+        // Relay mode: forward the stream of every client to an upstream recorder (see relay.h)
+        // instead of recording it. Must be set before the clients connect.
+        void set_relay(std::shared_ptr<RelayLink> link);
+
+        // Mirror every blackbox ring in a memory-mapped journal of capacity bytes in
+        // journal_path (ideally on a tmpfs) so that it survives a crash of the recorder.
+        // Journals left behind by a previous run are first recovered as .tick files
+        // in the recording path.
+        void set_journal(std::string_view journal_path, std::size_t capacity);
+
+        RecorderStats stats() const;
+
+        // Live counters, safe to read from any thread (see metrics.h).
+        RecorderMetrics& metrics() { return *metrics_; }
+
+        static constexpr int64_t SPILL_SEGMENT_SIZE = 16 * 1024 * 1024;
+        static constexpr std::size_t SUBSCRIBER_BACKLOG = 8 * 1024 * 1024;
+
     private:
+        using Frame = std::shared_ptr<std::vector<uint8_t> const>;
+
+        struct Subscriber
+        {
+            std::unique_ptr<AbstractIO> io{};
+            std::deque<Frame> queue{};      // frames are shared between subscribers
+            std::size_t sent{0};            // bytes of queue.front() already sent
+            std::size_t backlog{0};         // bytes queued
+            std::vector<uint64_t> pending{};// clients announced at their next pair boundary
+
+            bool is_pending(uint64_t client_id) const;
+        };
+
+        // Stream state of a client, as announced by CLIENT_BEGIN
+        struct FanoutState
+        {
+            nanoseconds reference{0};
+            nanoseconds period{0};
+            int32_t     priority{0};
+            uint32_t    parity{0};          // 1: the next sample is an end
+        };
+
+        // Kernel buffer of the splice path
+        struct SplicePipe
+        {
+            SplicePipe() = default;
+            SplicePipe(SplicePipe&& other);
+            SplicePipe& operator=(SplicePipe&& other);
+            ~SplicePipe();
+
+            std::error_code open();
+            void close();
+            bool is_open() const { return read_end != -1; }
+
+            os_file read_end{-1};
+            os_file write_end{-1};
+        };
+
         struct Chunk
         {
             nanoseconds first_sample_time{0};
             nanoseconds entry_reference{0};
             uint32_t sample_count{0};
+            bool leading_reference{false};  // data starts with UPDATE_REFERENCE
             std::vector<uint8_t> data;
+
+            // Location of the data once spilled (data is then empty)
+            uint64_t spill_segment{0};
+            int64_t  spill_offset{-1};
+            uint32_t spill_size{0};
+        };
+
+        struct SpillSegment
+        {
+            uint64_t id{0};
+            std::string path{};
+            std::unique_ptr<AbstractIO> file{};
+            int64_t size{0};
+            uint32_t live_chunks{0};
         };
 
         enum class Mode
         {
             PENDING,    // waiting for first data/command to decide recording strategy
             NORMAL,     // no threshold set, recording continuously to a single file
-            BUFFERING,  // threshold set, filling ring buffer while waiting for a spike
+            BUFFERING,  // trigger set, filling ring buffer while waiting for a spike
             RECORDING,  // spike detected, writing to file until recording_deadline
         };
 
@@ -49,7 +179,14 @@ namespace rtm
 
             ~Client();
             void flush();
+            void discard_storage(); // delete the spill and journal files
+            void sync_sink();       // timed in the metrics
 
+            void write_segments();  // rotating flush()
+            void open_segment();
+            void close_segment();
+
+            uint64_t id{0};
             std::unique_ptr<AbstractIO> io{};
             std::unique_ptr<AbstractIO> sink{};
             std::vector<uint8_t> buffer{};
@@ -57,6 +194,7 @@ namespace rtm
 
             // Blackbox state
             nanoseconds threshold{0};
+            TriggerEngine triggers{};
             nanoseconds current_reference{0};
             nanoseconds current_period{0};
             int32_t     current_priority{0};
@@ -66,12 +204,23 @@ namespace rtm
             uint32_t    sample_parity{0};
             nanoseconds prev_start_absolute{0};
             bool        has_prev_start{false};
-            bool        pending_trigger{false};
-            nanoseconds detected_jitter{0};
+            nanoseconds previous_loop_start{0}; // start of the loop before the current one
+            bool        has_previous_loop{false};
+            nanoseconds trigger_measure{0};     // of the last trigger
+            std::string trigger_condition{};
 
             // Ring buffer (pre-event data) -- pair-aligned
             std::deque<Chunk> ring;
             uint32_t ring_sample_count{0};
+            std::size_t ring_ram_bytes{0};
+
+            // Spilled chunks always are the oldest ones: ring[0, ring_spilled_chunks)
+            std::deque<SpillSegment> spill_segments;
+            std::size_t ring_spilled_chunks{0};
+            std::size_t ring_spilled_bytes{0};
+
+            // Crash-surviving copy of the newest ring chunks
+            Journal journal{};
 
             // Header bytes (stored for re-use across files)
             std::vector<uint8_t> header_bytes;
@@ -81,17 +230,103 @@ namespace rtm
             // Recording state
             Mode mode{Mode::PENDING};
             nanoseconds recording_deadline{0};
+
+            // Rotation state (NORMAL mode): name is the recording path without its index
+            bool        rotating{false};
+            access::Mode segment_mode{};    // Recorder::sink_mode() when the client was set up
+            std::size_t rotation_size{0};
+            nanoseconds rotation_interval{0};
+            uint32_t    segment_index{0};
+            int64_t     segment_bytes{0};
+            uint64_t    segment_samples{0};
+            nanoseconds segment_begin{0};
+            nanoseconds segment_end{0};
+            bool        rebasing{false};    // deltas are rewritten against rebase_base
+            uint32_t    rebase_base{0};
+
+            // Fan-out state: the stream is followed element by element
+            bool        fanout_synced{false};
+            std::vector<uint8_t> fanout_tail{}; // incomplete element
+            FanoutState fanout{};
+
+            // Zero-copy path (NORMAL mode)
+            SplicePipe splice_pipe{};
+
+            // Metrics
+            std::shared_ptr<RecorderMetrics> metrics{};
+            std::shared_ptr<ClientMetrics> counters{};
+            std::shared_ptr<Retention> retention{};     // wraps the sinks
+            std::vector<uint8_t> counting_tail{};   // incomplete element
+            nanoseconds unwritten_since{0};         // reception of the oldest data not on disk yet
+
+            // Relay mode: stream to the upstream recorder
+            std::unique_ptr<AbstractIO> relay{};
         };
 
         bool parse_blackbox_data(Client& client);
-        void trigger_recording(Client& client, nanoseconds trigger_absolute);
+        // Dump the ring to directory and record until trigger_absolute + post_duration.
+        // Returns the path of the dump.
+        std::string trigger_recording(Client& client, nanoseconds trigger_absolute, std::string const& directory);
+        void trigger_incident(Client& client, nanoseconds trigger_absolute);
+        void set_client_trigger(Client& client, TriggerRule const& rule); // SET_TRIGGER
         void stop_recording(Client& client);
         void evict_ring(Client& client);
+        void push_ring(Client& client, Chunk&& chunk);
+        void pop_ring(Client& client);
+
+        // Move the ring content, from first_chunk onward, to the sink and reset the ring.
+        void hand_over_ring(Client& client, AsyncIO& sink, std::size_t first_chunk);
+
+        void open_journal(Client& client);
+
+        access::Mode sink_mode() const;
+
+        static Frame make_begin_frame(Client const& client, FanoutState const& state);
+        void enqueue(Subscriber& subscriber, Frame const& frame);
+        void publish(Frame const& frame, uint64_t client_id); // to the subscribers not pending on it
+        void publish_begin(Client& client);
+        void publish_data(Client& client, uint8_t const* data, std::size_t size);
+        void publish_end(Client& client);
+        void flush_subscribers();
+
+        void count_samples(Client& client, uint8_t const* data, std::size_t size);
+
+        void start_splice(Client& client);
+        bool splice_data(Client& client); // false: the copying path takes over
+
+        void relay_data(Client& client);
+
+        void enforce_memory_budget();
+        void enforce_quota();
+        bool spill_chunk(Client& client);
+
+        // Declared first: destroyed last, once every client sink has been handed over.
+        std::shared_ptr<IOWorker> writer_;
+        std::shared_ptr<RecorderMetrics> metrics_;
+        std::shared_ptr<Retention> retention_;
+        std::shared_ptr<RelayLink> relay_{};  // outlives the client streams
 
         std::vector<Client> clients_{};
+        uint64_t next_client_id_{0};
         std::string recording_path_;
         nanoseconds pre_duration_;
         nanoseconds post_duration_;
+        bool correlated_trigger_{false};
+        std::vector<TriggerRule> trigger_rules_{};
+
+        std::size_t memory_budget_{0};
+        std::string spill_path_{};
+
+        std::string journal_path_{};
+        std::size_t journal_capacity_{0};
+
+        std::size_t rotation_size_{0};
+        nanoseconds rotation_interval_{0};
+
+        bool splice_enabled_{false};
+        bool direct_io_{false};
+        bool fanout_enabled_{false};
+        std::vector<Subscriber> subscribers_{};
     };
 }
 
@@ -0,0 +1,121 @@
+#ifndef RTM_LIB_RELAY_H
+#define RTM_LIB_RELAY_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rtm/io/datagram.h"
+#include "rtm/io/socket.h"
+#include "rtm/os/time.h"
+
+namespace rtm
+{
+    // Link between a relay recorder and its upstream: the streams of the relayed probes cut in
+    // datagrams (see datagram.h), one after the other on a stream connection (TCP).
+    namespace relay
+    {
+        // First datagram of a connection. Payload: u64 relay id, random, so that the streams
+        // go on over a new connection after an outage. The channel is not used.
+        constexpr uint16_t HELLO = 0x100;
+
+        // Header::flags: the payload is compressed. It starts with its u32 uncompressed size,
+        // followed by each u32 word as the zigzag varint of its difference with a linear
+        // prediction from the words of the same parity (samples start/end alternate).
+        constexpr uint16_t COMPRESSED = 0x1;
+
+        // Larger datagrams are a desynchronized link
+        constexpr uint32_t MAX_PAYLOAD = 64 * 1024;
+
+        std::vector<uint8_t> compress(uint8_t const* data, std::size_t size);
+        bool decompress(uint8_t const* data, std::size_t size, std::vector<uint8_t>& out);
+    }
+
+    // Relay side: forward the streams of the local probes to an upstream recorder over a single
+    // connection. The datagrams of every stream are sent in batches. While the upstream is not
+    // reachable, up to buffer_size bytes are kept; past that, the oldest datagrams are dropped
+    // and the upstream records the loss as a DATA_GAP.
+    class RelayLink
+    {
+    public:
+        // upstream is (re)opened by the link, in non-blocking mode.
+        RelayLink(std::unique_ptr<AbstractIO> upstream, std::size_t buffer_size = 64 * 1024 * 1024,
+                  bool compress = false);
+        ~RelayLink();
+
+        RelayLink(RelayLink const&) = delete;
+        RelayLink& operator=(RelayLink const&) = delete;
+
+        // IO to write the tick stream of one probe to, as the probe wrote it. Closing it ends
+        // the stream. The link shall outlive its streams.
+        std::unique_ptr<AbstractIO> open_stream();
+
+        // Send what can be sent without blocking, (re)connecting if needed.
+        void flush();
+
+        bool connected() const { return connected_; }
+        std::size_t buffered() const { return queued_bytes_ + batch_.size(); }
+        uint64_t dropped() const { return dropped_; }  // datagrams
+
+        static constexpr nanoseconds RECONNECT_DELAY = 1s;
+        static constexpr std::size_t BATCH_SIZE = 64 * 1024;
+
+    private:
+        class Channel;
+
+        void queue(uint8_t const* datagram, std::size_t size);
+        bool connect();
+
+        std::unique_ptr<AbstractIO> upstream_;
+        std::size_t buffer_size_;
+        bool compress_;
+        uint64_t relay_id_;
+
+        bool connected_{false};
+        nanoseconds next_attempt_{0};
+
+        std::deque<std::vector<uint8_t>> queue_{};  // datagrams not batched yet
+        std::size_t queued_bytes_{0};
+        std::vector<uint8_t> batch_{};              // being sent
+        std::size_t sent_{0};                       // bytes of batch_ already sent
+        uint64_t dropped_{0};
+    };
+
+    // Upstream side: accept the relay connections and rebuild the relayed streams, to be handed
+    // to Recorder::add_client(). The streams of a relay survive its reconnections.
+    class RelayListener
+    {
+    public:
+        // A stream silent for idle_timeout is closed: longer than the outages to ride out.
+        RelayListener(std::unique_ptr<AbstractListener> listener, nanoseconds idle_timeout = 60s);
+
+        std::error_code listen(int backlog);
+
+        // Accept the new relays and drain the connections. Returns the streams that started
+        // since the last call.
+        std::vector<std::unique_ptr<AbstractIO>> receive();
+
+        std::size_t relays() const { return connections_.size(); }
+        uint64_t dropped() const { return assembler_.dropped(); }
+
+    private:
+        struct Connection
+        {
+            std::unique_ptr<AbstractSocket> io{};
+            std::vector<uint8_t> buffer{};
+            std::string sender{};   // relay id, once said hello
+        };
+
+        // false: the connection is desynchronized
+        bool read(Connection& connection, nanoseconds now, std::vector<std::unique_ptr<AbstractIO>>& started);
+
+        std::unique_ptr<AbstractListener> listener_;
+        std::vector<Connection> connections_{};
+        DatagramAssembler assembler_;
+        std::vector<uint8_t> plain_{};      // decompressed datagram
+    };
+}
+
+#endif
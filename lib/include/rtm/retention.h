@@ -0,0 +1,113 @@
+#ifndef RTM_LIB_RETENTION_H
+#define RTM_LIB_RETENTION_H
+
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "rtm/io/io.h"
+
+namespace rtm
+{
+    // Disk usage of the recordings (.tick files, with the level-of-detail cache a monitor left
+    // next to them when they were found complete) under a directory, kept under a quota by
+    // deleting the oldest complete recordings first. A file written through track() is never
+    // deleted while it is open: it becomes a candidate once its TrackedIO is destroyed.
+    class Retention
+    {
+    public:
+        explicit Retention(std::string root);
+
+        // 0 = unlimited. Starts the scan of the recordings already in the directory.
+        void set_quota(uint64_t bytes);
+        uint64_t quota() const { return quota_; }
+
+        // Wrap the IO writing the recording at path: its bytes are accounted and its failed
+        // writes reported.
+        std::unique_ptr<AbstractIO> track(std::string const& path, std::unique_ptr<AbstractIO> io);
+
+        // Recorder thread: account the closed files, scan up to SCAN_STEP more directory entries,
+        // then delete the oldest complete recordings while over quota. Nothing is deleted before
+        // the scan is over: the oldest recordings are not known until then.
+        void enforce();
+
+        bool scanning() const { return scanning_; }
+        uint64_t used() const;          // bytes, complete and open recordings
+        uint64_t deleted() const { return deleted_; }
+        uint64_t write_errors() const;
+
+        static constexpr std::size_t SCAN_STEP = 256;
+
+    private:
+        // Shared with the TrackedIOs, that may be destroyed by an IOWorker
+        struct State
+        {
+            std::atomic<uint64_t> open_bytes{0};
+            std::atomic<uint64_t> write_errors{0};
+
+            std::mutex mutex;
+            std::unordered_set<std::string> open{};
+            std::vector<std::string> closed{};      // not accounted yet
+        };
+        friend class TrackedIO;
+
+        struct Recording
+        {
+            std::string path;
+            uint64_t size;
+        };
+
+        void add_recording(std::filesystem::path const& path);
+        void remove_recording(std::multimap<std::filesystem::file_time_type, Recording>::iterator it);
+
+        std::string root_;
+        uint64_t quota_{0};
+        std::shared_ptr<State> state_;
+
+        // Complete recordings, oldest first
+        std::multimap<std::filesystem::file_time_type, Recording> recordings_{};
+        std::unordered_set<std::string> known_{};
+        uint64_t complete_bytes_{0};
+        uint64_t deleted_{0};
+
+        bool scanning_{false};
+        std::filesystem::recursive_directory_iterator scan_{};
+    };
+
+    // Decorator of a recording being written (see Retention::track).
+    class TrackedIO final : public AbstractIO
+    {
+    public:
+        TrackedIO(std::string path, std::unique_ptr<AbstractIO> io, std::shared_ptr<Retention::State> state);
+        virtual ~TrackedIO();
+
+        int64_t read(void* data, int64_t data_size) override;
+        int64_t write(void const* data, int64_t data_size) override;
+        std::error_code seek(int64_t pos) override;
+        std::error_code truncate(int64_t size) override;
+        std::error_code sync() override;
+        os_file native_handle() const override;
+
+        // Bytes written behind the decorator back (splice)
+        void written(int64_t size);
+
+    private:
+        std::error_code do_open(access::Mode mode) override;
+        std::error_code do_close() override;
+
+        void report(char const* operation, std::error_code const& error);
+
+        std::string path_;
+        std::unique_ptr<AbstractIO> io_;
+        std::shared_ptr<Retention::State> state_;
+        uint64_t bytes_{0};
+        bool failed_{false};    // report the first failure only
+    };
+}
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef RTM_LIB_SUMMARY_H
+#define RTM_LIB_SUMMARY_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rtm/io/io.h"
+#include "rtm/os/time.h"
+
+namespace rtm
+{
+    // Statistics of a series of durations (ns)
+    struct SummaryStats
+    {
+        uint64_t count{0};
+        int64_t  min{0};
+        int64_t  max{0};
+        int64_t  sum{0};
+        double   sum_sq{0};     // ns²: does not fit in 64 bits
+
+        void add(nanoseconds value);
+        void merge(SummaryStats const& other);
+
+        double mean() const;    // ns
+        double stddev() const;  // ns
+    };
+
+    // Overview of a block of consecutive samples of a tick file. Blocks end on a pair boundary.
+    struct SummaryBlock
+    {
+        int64_t     offset{0};      // file offset of the first element of the block
+        nanoseconds reference{0};   // absolute reference in effect at offset, to decode from there
+        nanoseconds begin{0};       // first sample, absolute
+        nanoseconds end{0};         // last sample, absolute
+        uint64_t    samples{0};
+        SummaryStats period{};      // start to start
+        SummaryStats up{};          // end - start
+
+        void merge(SummaryBlock const& other);
+    };
+
+    // SUMMARY_INDEX metadata payload: u32 size of a block record, followed by the records.
+    void append_summary(std::vector<uint8_t>& buffer, std::vector<SummaryBlock> const& blocks);
+    bool read_summary(uint8_t const* data, std::size_t size, std::vector<SummaryBlock>& blocks);
+
+    // Merge of the blocks overlapping [begin, end] (absolute times): whole blocks only.
+    // samples is 0 if none does.
+    SummaryBlock merge_summary(std::vector<SummaryBlock> const& blocks, nanoseconds begin, nanoseconds end);
+
+    // Build the summary index of a tick file from its bytes, in order, as they are written.
+    class SummaryBuilder
+    {
+    public:
+        static constexpr uint64_t BLOCK_SAMPLES = 65536;
+
+        explicit SummaryBuilder(uint64_t block_samples = BLOCK_SAMPLES);
+
+        void write(uint8_t const* data, std::size_t size);
+
+        // The stream ended: the last element written is the DATA_STREAM_END sentinel.
+        bool ended() const { return ended_; }
+        int64_t size() const { return offset_; }
+
+        // Offset of the metadata footer pointer in the header, -1 if the file has none (v1).
+        int64_t footer_pointer() const { return footer_pointer_; }
+
+        std::vector<SummaryBlock> finish();
+
+    private:
+        void parse_header();
+        void on_element(uint8_t const* element, int64_t position);
+        void on_sample(nanoseconds sample);
+
+        uint64_t block_samples_;
+
+        int64_t offset_{0};                 // bytes written so far
+        std::vector<uint8_t> header_{};     // until complete
+        std::size_t header_size_{0};        // 0 until known
+        bool header_done_{false};
+        int64_t footer_pointer_{-1};
+        std::vector<uint8_t> tail_{};       // incomplete element
+        bool ended_{false};
+
+        nanoseconds reference_{0};
+        uint64_t    index_{0};              // of the next sample in the stream
+        nanoseconds last_start_{0};
+        bool        has_start_{false};
+
+        bool open_{false};
+        SummaryBlock block_{};
+        std::vector<SummaryBlock> blocks_{};
+    };
+
+    // Decorator of a recording: once closed after the DATA_STREAM_END sentinel, its summary index
+    // is written in the metadata footer. Data written behind its back (the native handle was
+    // requested, for splice) cannot be summarized: the file is then left without index.
+    class SummaryIO final : public AbstractIO
+    {
+    public:
+        // path: the file of io, reopened to patch the footer pointer of the header (io may be
+        // unable to seek, i.e. access::Mode::DIRECT).
+        SummaryIO(std::unique_ptr<AbstractIO> io, std::string path);
+        virtual ~SummaryIO();
+
+        int64_t read(void* data, int64_t data_size) override;
+        int64_t write(void const* data, int64_t data_size) override;
+        std::error_code seek(int64_t pos) override;
+        std::error_code truncate(int64_t size) override;
+        std::error_code sync() override;
+        os_file native_handle() const override;
+
+    private:
+        std::error_code do_open(access::Mode mode) override;
+        std::error_code do_close() override;
+
+        std::error_code write_footer_pointer(int64_t footer_offset);
+
+        std::unique_ptr<AbstractIO> io_;
+        std::string path_;
+        SummaryBuilder builder_{};
+        bool valid_{true};
+        mutable bool bypassed_{false};
+    };
+}
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef RTM_LIB_TRIGGER_H
+#define RTM_LIB_TRIGGER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rtm/os/time.h"
+
+namespace rtm
+{
+    enum class TriggerKind : uint16_t
+    {
+        JITTER           = 1,   // start-to-start time above value ns (what SET_THRESHOLD sets)
+        UP_TIME          = 2,   // loop up time (end - start) above value ns
+        PERIOD_DEVIATION = 3,   // start-to-start time off the announced period by more than value %
+        MISSES           = 4,   // count loops off the period by more than value % within the last window loops
+        ROLLING_P99      = 5,   // up time above value % of its p99 over the last window loops
+    };
+
+    // One condition of the blackbox trigger: the payload of the SET_TRIGGER command.
+    // A rule with a value of 0 removes the rule of its kind.
+    struct TriggerRule
+    {
+        TriggerKind kind{TriggerKind::JITTER};
+        uint16_t count{0};
+        uint32_t window{0};
+        uint64_t value{0};
+    };
+    static_assert(sizeof(TriggerRule) == 16, "TriggerRule is a wire format");
+
+    // Timings of one loop (a start/end pair of samples), relative to the process start.
+    struct LoopTiming
+    {
+        nanoseconds start{0};
+        nanoseconds end{0};
+        nanoseconds previous_start{0};
+        bool        has_previous{false};    // false after a data gap or at the stream start
+        nanoseconds period{0};              // as announced by the probe
+    };
+
+    class TriggerCheck
+    {
+    public:
+        virtual ~TriggerCheck() = default;
+
+        // Called on every loop, in constant time. Returns true when the loop shall be recorded.
+        virtual bool on_loop(LoopTiming const& loop) = 0;
+
+        // Measure of the last loop checked (jitter, up time...), for the logs and incident manifests.
+        virtual nanoseconds measured() const = 0;
+
+        virtual std::string describe() const = 0;
+    };
+
+    // nullptr if the rule is invalid (unknown kind, null window...)
+    std::unique_ptr<TriggerCheck> make_trigger_check(TriggerRule const& rule);
+
+    // The trigger conditions of one client, at most one per kind.
+    class TriggerEngine
+    {
+    public:
+        static constexpr uint32_t MAX_WINDOW = 65536; // loops
+
+        // Replace the rule of the same kind. Returns false if the rule is invalid.
+        bool set(TriggerRule const& rule);
+        bool has(TriggerKind kind) const;
+        bool empty() const { return checks_.empty(); }
+        std::size_t size() const { return checks_.size(); }
+
+        // Returns the first check that fired on this loop, nullptr if none did.
+        // Every check sees every loop, so that the windows stay up to date.
+        TriggerCheck const* on_loop(LoopTiming const& loop);
+
+    private:
+        struct Entry
+        {
+            TriggerKind kind;
+            std::unique_ptr<TriggerCheck> check;
+        };
+        std::vector<Entry> checks_{};
+    };
+}
+
+#endif
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 
 #include "data.h"
@@ -162,4 +163,57 @@ namespace rtm
         // 2. LTTB
         return lttb(preselect, threshold);
     }
+
+
+    Columns::Columns(Point const* begin, Point const* end)
+    {
+        xs_.reserve(static_cast<std::size_t>(end - begin));
+        ys_.reserve(static_cast<std::size_t>(end - begin));
+        for (auto it = begin; it != end; ++it)
+        {
+            push_back(*it);
+        }
+    }
+
+    Columns::Columns(ColumnSpan const& span)
+        : origin_{span.origin}
+        , xs_(span.xs, span.xs + span.size)
+        , ys_(span.ys, span.ys + span.size)
+    {
+    }
+
+    void Columns::push_back(Point const& point)
+    {
+        if (xs_.empty())
+        {
+            origin_ = point.x;
+        }
+        xs_.push_back(static_cast<float>(point.x - origin_));
+        ys_.push_back(static_cast<float>(point.y));
+    }
+
+    void Columns::decimate()
+    {
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < xs_.size(); i += 2)
+        {
+            xs_[kept] = xs_[i];
+            ys_[kept] = ys_[i];
+            ++kept;
+        }
+        xs_.resize(kept);
+        ys_.resize(kept);
+    }
+
+    std::size_t Columns::lower_bound(double x) const
+    {
+        float offset = static_cast<float>(x - origin_);
+        return static_cast<std::size_t>(std::lower_bound(xs_.begin(), xs_.end(), offset) - xs_.begin());
+    }
+
+    std::size_t Columns::upper_bound(double x) const
+    {
+        float offset = static_cast<float>(x - origin_);
+        return static_cast<std::size_t>(std::upper_bound(xs_.begin(), xs_.end(), offset) - xs_.begin());
+    }
 }
@@ -0,0 +1,171 @@
+#include <cstring>
+
+#if defined(__x86_64__) or defined(_M_X64)
+#include <immintrin.h>
+#define RTM_DELTA_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define RTM_DELTA_NEON
+#endif
+
+#include "commands.h"
+#include "delta.h"
+
+namespace rtm
+{
+    struct Decoder
+    {
+        char const* isa;
+        std::size_t (*decode)(uint8_t const*, std::size_t, nanoseconds, nanoseconds*);
+    };
+
+    std::size_t decode_deltas_scalar(uint8_t const* words, std::size_t count, nanoseconds reference, nanoseconds* out)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            uint32_t word;
+            std::memcpy(&word, words + i * sizeof(uint32_t), sizeof(word));
+            if (word & ESCAPE)
+            {
+                return i;
+            }
+            out[i] = reference + nanoseconds(word);
+        }
+        return count;
+    }
+
+#ifdef RTM_DELTA_X86
+    // SSE2 is part of x86-64: no detection needed
+    static std::size_t decode_deltas_sse2(uint8_t const* words, std::size_t count, nanoseconds reference, nanoseconds* out)
+    {
+        __m128i const ref = _mm_set1_epi64x(reference.count());
+        __m128i const zero = _mm_setzero_si128();
+
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i delta = _mm_loadu_si128(reinterpret_cast<__m128i const*>(words + i * sizeof(uint32_t)));
+            if (_mm_movemask_ps(_mm_castsi128_ps(delta)) != 0)
+            {
+                break; // an escaped word: the scalar tail finds which one
+            }
+
+            __m128i low  = _mm_add_epi64(_mm_unpacklo_epi32(delta, zero), ref);
+            __m128i high = _mm_add_epi64(_mm_unpackhi_epi32(delta, zero), ref);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), low);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 2), high);
+        }
+        return i + decode_deltas_scalar(words + i * sizeof(uint32_t), count - i, reference, out + i);
+    }
+
+    __attribute__((target("avx2")))
+    static std::size_t decode_deltas_avx2(uint8_t const* words, std::size_t count, nanoseconds reference, nanoseconds* out)
+    {
+        __m256i const ref = _mm256_set1_epi64x(reference.count());
+
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i delta = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(words + i * sizeof(uint32_t)));
+            if (_mm256_movemask_ps(_mm256_castsi256_ps(delta)) != 0)
+            {
+                break; // an escaped word: the scalar tail finds which one
+            }
+
+            __m256i low  = _mm256_add_epi64(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(delta)), ref);
+            __m256i high = _mm256_add_epi64(_mm256_cvtepu32_epi64(_mm256_extracti128_si256(delta, 1)), ref);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), low);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 4), high);
+        }
+        return i + decode_deltas_scalar(words + i * sizeof(uint32_t), count - i, reference, out + i);
+    }
+
+    static Decoder select_decoder()
+    {
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return {"avx2", decode_deltas_avx2};
+        }
+        return {"sse2", decode_deltas_sse2};
+    }
+#elif defined(RTM_DELTA_NEON)
+    // NEON is part of AArch64: no detection needed
+    static std::size_t decode_deltas_neon(uint8_t const* words, std::size_t count, nanoseconds reference, nanoseconds* out)
+    {
+        int64x2_t const ref = vdupq_n_s64(reference.count());
+
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            uint32x4_t delta = vld1q_u32(reinterpret_cast<uint32_t const*>(words + i * sizeof(uint32_t)));
+            if (vmaxvq_u32(delta) & ESCAPE)
+            {
+                break; // an escaped word: the scalar tail finds which one
+            }
+
+            int64x2_t low  = vaddq_s64(vreinterpretq_s64_u64(vmovl_u32(vget_low_u32(delta))), ref);
+            int64x2_t high = vaddq_s64(vreinterpretq_s64_u64(vmovl_high_u32(delta)), ref);
+            vst1q_s64(reinterpret_cast<int64_t*>(out + i), low);
+            vst1q_s64(reinterpret_cast<int64_t*>(out + i + 2), high);
+        }
+        return i + decode_deltas_scalar(words + i * sizeof(uint32_t), count - i, reference, out + i);
+    }
+
+    static Decoder select_decoder()
+    {
+        return {"neon", decode_deltas_neon};
+    }
+#else
+    static Decoder select_decoder()
+    {
+        return {"scalar", decode_deltas_scalar};
+    }
+#endif
+
+    static Decoder const& selected()
+    {
+        static Decoder const decoder = select_decoder();
+        return decoder;
+    }
+
+    std::size_t decode_deltas(uint8_t const* words, std::size_t count, nanoseconds reference, nanoseconds* out)
+    {
+        return selected().decode(words, count, reference, out);
+    }
+
+    std::size_t delta_run(uint8_t const* words, std::size_t count)
+    {
+        // Blocks of words or'ed together: the compiler vectorizes it, the escaped word is rare
+        constexpr std::size_t BLOCK = 8;
+        std::size_t i = 0;
+        for (; i + BLOCK <= count; i += BLOCK)
+        {
+            uint32_t block[BLOCK];
+            std::memcpy(block, words + i * sizeof(uint32_t), sizeof(block));
+            uint32_t any = 0;
+            for (uint32_t word : block)
+            {
+                any |= word;
+            }
+            if (any & ESCAPE)
+            {
+                break;
+            }
+        }
+        for (; i < count; ++i)
+        {
+            uint32_t word;
+            std::memcpy(&word, words + i * sizeof(uint32_t), sizeof(word));
+            if (word & ESCAPE)
+            {
+                return i;
+            }
+        }
+        return count;
+    }
+
+    char const* decode_deltas_isa()
+    {
+        return selected().isa;
+    }
+}
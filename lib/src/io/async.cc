@@ -0,0 +1,185 @@
+#include <cerrno>
+#include <cstdio>
+
+#include "io/async.h"
+
+namespace rtm
+{
+    IOWorker::IOWorker()
+        : thread_{&IOWorker::run, this}
+    {
+
+    }
+
+    IOWorker::~IOWorker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_up_.notify_one();
+        thread_.join();
+    }
+
+    void IOWorker::post(std::function<void()>&& job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(std::move(job));
+        }
+        wake_up_.notify_one();
+    }
+
+    void IOWorker::wait_idle()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this]() { return jobs_.empty() and not busy_; });
+    }
+
+    void IOWorker::run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            wake_up_.wait(lock, [this]() { return stop_ or not jobs_.empty(); });
+            if (jobs_.empty())
+            {
+                // stop requested and nothing left to do
+                return;
+            }
+
+            auto job = std::move(jobs_.front());
+            jobs_.pop_front();
+            busy_ = true;
+
+            lock.unlock();
+            job();
+            job = nullptr; // release captured resources outside of the lock
+            lock.lock();
+
+            busy_ = false;
+            if (jobs_.empty())
+            {
+                idle_.notify_all();
+            }
+        }
+    }
+
+
+    AsyncIO::AsyncIO(std::unique_ptr<AbstractIO> io, std::shared_ptr<IOWorker> worker)
+        : io_{std::move(io)}
+        , worker_{std::move(worker)}
+    {
+        supported_modes_ = access::Mode::WRITE_ONLY    | access::Mode::READ_WRITE | access::Mode::APPEND   |
+                           access::Mode::TRUNCATE      | access::Mode::NEW_ONLY   | access::Mode::UNBUFFERED |
+                           access::Mode::EXISTING_ONLY | access::Mode::NON_BLOCKING | access::Mode::DIRECT;
+        staging_.reserve(STAGING_SIZE);
+    }
+
+    AsyncIO::~AsyncIO()
+    {
+        if (is_open())
+        {
+            close();
+        }
+
+        // The wrapped IO is destroyed by the worker, once its last job is done.
+        worker_->post([io = std::move(io_)]() mutable { io.reset(); });
+    }
+
+    int64_t AsyncIO::read(void*, int64_t)
+    {
+        errno = ENOSYS;
+        return -1;
+    }
+
+    int64_t AsyncIO::write(void const* data, int64_t data_size)
+    {
+        if (data_size <= 0)
+        {
+            return 0;
+        }
+
+        auto const* bytes = static_cast<uint8_t const*>(data);
+        staging_.insert(staging_.end(), bytes, bytes + data_size);
+        if (staging_.size() >= STAGING_SIZE)
+        {
+            submit();
+        }
+        return data_size;
+    }
+
+    int64_t AsyncIO::write(std::vector<uint8_t>&& buffer)
+    {
+        submit();
+
+        int64_t size = static_cast<int64_t>(buffer.size());
+        worker_->post([io = io_, data = std::move(buffer)]()
+        {
+            int64_t written = io->write(data.data(), static_cast<int64_t>(data.size()));
+            if (written != static_cast<int64_t>(data.size()))
+            {
+                printf("[AsyncIO] Short write (%ld / %zu)\n", static_cast<long>(written), data.size());
+            }
+        });
+        return size;
+    }
+
+    void AsyncIO::post(std::function<void(AbstractIO&)>&& job)
+    {
+        submit();
+        worker_->post([io = io_, job = std::move(job)]() { job(*io); });
+    }
+
+    void AsyncIO::submit()
+    {
+        if (staging_.empty())
+        {
+            return;
+        }
+
+        std::vector<uint8_t> buffer;
+        buffer.reserve(STAGING_SIZE);
+        buffer.swap(staging_);
+        write(std::move(buffer));
+    }
+
+    std::error_code AsyncIO::seek(int64_t pos)
+    {
+        post([pos](AbstractIO& io)
+        {
+            auto rc = io.seek(pos);
+            if (rc)
+            {
+                printf("[AsyncIO] seek() failed: %s\n", rc.message().c_str());
+            }
+        });
+        return {};
+    }
+
+    std::error_code AsyncIO::sync()
+    {
+        post([](AbstractIO& io) { io.sync(); });
+        return {};
+    }
+
+    std::error_code AsyncIO::do_open(access::Mode mode)
+    {
+        worker_->post([io = io_, mode]()
+        {
+            auto rc = io->open(mode);
+            if (rc)
+            {
+                printf("[AsyncIO] open() failed: %s\n", rc.message().c_str());
+            }
+        });
+        return {};
+    }
+
+    std::error_code AsyncIO::do_close()
+    {
+        submit();
+        worker_->post([io = io_]() { io->close(); });
+        return {};
+    }
+}
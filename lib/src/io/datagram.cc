@@ -0,0 +1,545 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "io/datagram.h"
+#include "commands.h"
+#include "serializer.h"
+
+namespace rtm
+{
+    namespace
+    {
+        // Room kept in a data datagram for the next pair: two references
+        constexpr std::size_t PAIR_ROOM = 2 * (sizeof(uint32_t) + sizeof(uint64_t));
+    }
+
+    DatagramWriter::DatagramWriter(std::unique_ptr<AbstractIO> io)
+        : io_{std::move(io)}
+    {
+        supported_modes_ = access::Mode::WRITE_ONLY | access::Mode::READ_WRITE | access::Mode::NON_BLOCKING;
+
+        std::random_device random;
+        channel_ = random();
+    }
+
+    DatagramWriter::~DatagramWriter()
+    {
+        if (is_open())
+        {
+            close();
+        }
+    }
+
+    std::error_code DatagramWriter::do_open(access::Mode mode)
+    {
+        return io_->open(mode);
+    }
+
+    std::error_code DatagramWriter::do_close()
+    {
+        if (not ended_ and not tick_header_.empty())
+        {
+            std::vector<uint8_t> end(sizeof(datagram::Header));
+            send(datagram::STREAM_END, end);
+        }
+        return io_->close();
+    }
+
+    int64_t DatagramWriter::read(void*, int64_t)
+    {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    int64_t DatagramWriter::write(void const* data, int64_t data_size)
+    {
+        if (ended_)
+        {
+            return data_size;
+        }
+
+        uint8_t const* bytes = static_cast<uint8_t const*>(data);
+        pending_.insert(pending_.end(), bytes, bytes + data_size);
+
+        if (tick_header_.empty())
+        {
+            // data_offset of the tick header, see build_tick_header()
+            if (pending_.size() < 16)
+            {
+                return data_size;
+            }
+            uint64_t data_offset;
+            std::memcpy(&data_offset, pending_.data() + 8, sizeof(data_offset));
+
+            std::size_t header_size = static_cast<std::size_t>(data_offset) + 8;
+            if (pending_.size() < header_size)
+            {
+                return data_size;
+            }
+            tick_header_.assign(pending_.begin(), pending_.begin() + static_cast<ptrdiff_t>(header_size));
+            pending_.erase(pending_.begin(), pending_.begin() + static_cast<ptrdiff_t>(header_size));
+        }
+
+        send_batches();
+        return data_size;
+    }
+
+    void DatagramWriter::send(datagram::Type type, std::vector<uint8_t>& datagram)
+    {
+        datagram::Header header{};
+        header.magic = datagram::MAGIC;
+        header.channel = channel_;
+        header.sequence = sequence_++;
+        header.type = type;
+        header.size = static_cast<uint32_t>(datagram.size() - sizeof(datagram::Header));
+        std::memcpy(datagram.data(), &header, sizeof(header));
+
+        // Best effort: a datagram that cannot be sent is a datagram lost
+        io_->write(datagram.data(), static_cast<int64_t>(datagram.size()));
+
+        if (type == datagram::STREAM_END)
+        {
+            ended_ = true;
+        }
+    }
+
+    void DatagramWriter::send_header()
+    {
+        std::vector<uint8_t> datagram(sizeof(datagram::Header));
+        datagram.insert(datagram.end(), tick_header_.begin(), tick_header_.end());
+        append(datagram, ESCAPE | Command::UPDATE_PERIOD);
+        append(datagram, static_cast<uint64_t>(period_.count()));
+        append(datagram, ESCAPE | Command::UPDATE_PRIORITY);
+        append(datagram, priority_);
+        if (has_threshold_)
+        {
+            append(datagram, ESCAPE | Command::SET_THRESHOLD);
+            append(datagram, static_cast<uint64_t>(threshold_.count()));
+        }
+        for (auto const& rule : triggers_)
+        {
+            append(datagram, ESCAPE | Command::SET_TRIGGER);
+            append(datagram, rule);
+        }
+        send(datagram::STREAM_HEADER, datagram);
+    }
+
+    void DatagramWriter::send_batches()
+    {
+        std::vector<uint8_t> batch(sizeof(datagram::Header));
+        bool has_base = false;  // the batch already holds a sample
+        uint32_t base = 0;      // raw delta of the batch reference
+        uint32_t parity = 0;
+        bool end_of_stream = false;
+        bool configured = false;    // the batch sets a threshold or a trigger
+
+        // Last pair boundary: what is sent, and the state to resume from
+        std::size_t committed_pos = 0;
+        std::size_t committed_size = batch.size();
+        nanoseconds committed_period = period_;
+        int32_t committed_priority = priority_;
+        nanoseconds committed_reference = reference_;
+
+        auto flush_batch = [&](std::size_t size)
+        {
+            if (size == sizeof(datagram::Header))
+            {
+                return;
+            }
+
+            if (since_header_ == 0)
+            {
+                send_header();
+            }
+            since_header_ = (since_header_ + 1) % HEADER_REPEAT;
+
+            batch.resize(size);
+            send(datagram::STREAM_DATA, batch);
+            batch.resize(sizeof(datagram::Header));
+            has_base = false;
+
+            if (configured)
+            {
+                // Should this datagram be lost, the next header restores the configuration
+                since_header_ = 0;
+                configured = false;
+            }
+        };
+
+        auto emit_reference = [&batch](nanoseconds reference)
+        {
+            append(batch, ESCAPE | Command::UPDATE_REFERENCE);
+            append(batch, static_cast<uint64_t>(reference.count()));
+        };
+
+        uint8_t const* const begin = pending_.data();
+        uint8_t const* pos = begin;
+        uint8_t const* const end = begin + pending_.size();
+        while (pos + sizeof(uint32_t) <= end)
+        {
+            uint32_t word;
+            std::memcpy(&word, pos, sizeof(word));
+            std::size_t elem_size = element_size(word);
+            if (pos + elem_size > end)
+            {
+                break;
+            }
+
+            uint8_t const* payload = pos + sizeof(uint32_t);
+            bool is_sample = (not (word & ESCAPE)) or (word & Command::UPDATE_REFERENCE);
+            if (word == (ESCAPE | Command::DATA_STREAM_END))
+            {
+                pos += elem_size;
+                end_of_stream = true;
+                break;
+            }
+
+            // Cut on a pair boundary, before the datagram overflows
+            if (is_sample and parity == 0 and batch.size() + PAIR_ROOM > datagram::MAX_SIZE)
+            {
+                flush_batch(batch.size());
+                committed_size = batch.size();
+            }
+
+            if (not (word & ESCAPE))
+            {
+                if (not has_base or word < base)
+                {
+                    // Start (or restart, as going backward cannot be a delta) from this sample
+                    emit_reference(reference_ + nanoseconds(word));
+                    has_base = true;
+                    base = word;
+                }
+                else
+                {
+                    append(batch, word - base);
+                }
+            }
+            else if (word & Command::UPDATE_REFERENCE)
+            {
+                reference_ = nanoseconds(extract_data<uint64_t>(payload));
+                emit_reference(reference_);
+                has_base = true;
+                base = 0;
+            }
+            else
+            {
+                if (word & Command::UPDATE_PERIOD)
+                {
+                    period_ = nanoseconds(extract_data<uint64_t>(payload));
+                }
+                else if (word & Command::UPDATE_PRIORITY)
+                {
+                    priority_ = extract_data<int32_t>(payload);
+                }
+                else if (word & Command::SET_THRESHOLD)
+                {
+                    // Both set the jitter condition: the last one wins
+                    has_threshold_ = true;
+                    threshold_ = nanoseconds(extract_data<uint64_t>(payload));
+                    triggers_.erase(std::remove_if(triggers_.begin(), triggers_.end(),
+                        [](TriggerRule const& rule) { return rule.kind == TriggerKind::JITTER; }), triggers_.end());
+                    configured = true;
+                }
+                else if (word & Command::SET_TRIGGER)
+                {
+                    TriggerRule rule = extract_data<TriggerRule>(payload);
+                    if (rule.kind == TriggerKind::JITTER)
+                    {
+                        has_threshold_ = false;
+                    }
+                    triggers_.erase(std::remove_if(triggers_.begin(), triggers_.end(),
+                        [&rule](TriggerRule const& known) { return known.kind == rule.kind; }), triggers_.end());
+                    triggers_.push_back(rule);
+                    configured = true;
+                }
+                batch.insert(batch.end(), pos, pos + elem_size);
+            }
+
+            if (is_sample)
+            {
+                parity = (parity + 1) % 2;
+            }
+            pos += elem_size;
+
+            if (parity == 0)
+            {
+                committed_pos = static_cast<std::size_t>(pos - begin);
+                committed_size = batch.size();
+                committed_period = period_;
+                committed_priority = priority_;
+                committed_reference = reference_;
+            }
+        }
+
+        // An incomplete pair waits for the next write: rewind the state to the last boundary
+        flush_batch(committed_size);
+        period_ = committed_period;
+        priority_ = committed_priority;
+        reference_ = committed_reference;
+
+        if (end_of_stream)
+        {
+            std::vector<uint8_t> end_datagram(sizeof(datagram::Header));
+            send(datagram::STREAM_END, end_datagram);
+            pending_.clear();
+            return;
+        }
+        pending_.erase(pending_.begin(), pending_.begin() + static_cast<ptrdiff_t>(committed_pos));
+    }
+
+
+    // Bytes of a stream, between the assembler (producer) and the recorder client (consumer)
+    struct DatagramAssembler::Queue
+    {
+        std::vector<uint8_t> data{};
+        std::size_t read_pos{0};
+        bool ended{false};
+
+        std::size_t pending() const { return data.size() - read_pos; }
+    };
+
+    class DatagramAssembler::Stream final : public AbstractIO
+    {
+    public:
+        Stream(std::shared_ptr<Queue> queue)
+            : queue_{std::move(queue)}
+        {
+            supported_modes_ = access::Mode::READ_ONLY | access::Mode::NON_BLOCKING;
+        }
+
+        int64_t read(void* data, int64_t data_size) override
+        {
+            std::size_t available = queue_->data.size() - queue_->read_pos;
+            if (available == 0)
+            {
+                if (queue_->ended)
+                {
+                    return 0;
+                }
+                errno = EAGAIN;
+                return -1;
+            }
+
+            std::size_t size = std::min(available, static_cast<std::size_t>(data_size));
+            std::memcpy(data, queue_->data.data() + queue_->read_pos, size);
+            queue_->read_pos += size;
+            if (queue_->read_pos == queue_->data.size())
+            {
+                queue_->data.clear();
+                queue_->read_pos = 0;
+            }
+            return static_cast<int64_t>(size);
+        }
+
+        int64_t write(void const*, int64_t) override
+        {
+            errno = ENOTSUP;
+            return -1;
+        }
+
+    protected:
+        std::error_code do_open(access::Mode) override { return {}; }
+        std::error_code do_close() override { return {}; }
+
+    private:
+        std::shared_ptr<Queue> queue_;
+    };
+
+    DatagramAssembler::DatagramAssembler(nanoseconds idle_timeout)
+        : idle_timeout_{idle_timeout}
+    {
+    }
+
+    void DatagramAssembler::expire(nanoseconds now)
+    {
+        for (auto it = channels_.begin(); it != channels_.end();)
+        {
+            auto& queue = it->second.queue;
+            if (queue.use_count() == 1)
+            {
+                // The recorder dropped the stream
+                it = channels_.erase(it);
+                continue;
+            }
+
+            if (now - it->second.last_seen > idle_timeout_)
+            {
+                printf("[Recorder] Datagram stream timed out\n");
+                queue->ended = true;
+                it = channels_.erase(it);
+                continue;
+            }
+            ++it;
+        }
+    }
+
+    void DatagramAssembler::dispatch(std::string sender, uint8_t const* data, std::size_t size, nanoseconds now,
+                                     std::vector<std::unique_ptr<AbstractIO>>& started)
+    {
+        datagram::Header header;
+        if (size < sizeof(header))
+        {
+            return;
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != datagram::MAGIC or sizeof(header) + header.size != size)
+        {
+            return;
+        }
+        uint8_t const* payload = data + sizeof(header);
+
+        std::string key = std::move(sender);
+        key.append(reinterpret_cast<char const*>(&header.channel), sizeof(header.channel));
+
+        auto it = channels_.find(key);
+        if (it == channels_.end())
+        {
+            // A stream can only be rebuilt from its header
+            if (header.type != datagram::STREAM_HEADER)
+            {
+                return;
+            }
+
+            Channel channel;
+            channel.queue = std::make_shared<Queue>();
+            channel.queue->data.assign(payload, payload + header.size);
+            channel.next_sequence = header.sequence + 1;
+            channel.last_seen = now;
+            started.push_back(std::make_unique<Stream>(channel.queue));
+            started.back()->open(access::Mode::READ_ONLY | access::Mode::NON_BLOCKING);
+            channels_.emplace(std::move(key), std::move(channel));
+            return;
+        }
+
+        Channel& channel = it->second;
+        if (header.sequence < channel.next_sequence)
+        {
+            // Late or duplicated: already counted as lost
+            return;
+        }
+
+        auto lose = [this, &channel](uint64_t count)
+        {
+            dropped_ += count;
+            channel.lost += count;
+            channel.resync = true;
+        };
+        lose(header.sequence - channel.next_sequence);
+        channel.next_sequence = header.sequence + 1;
+        channel.last_seen = now;
+
+        auto& queue = *channel.queue;
+        if (queue.read_pos >= QUEUE_CAPACITY)
+        {
+            // The consumer only releases the queue once drained
+            queue.data.erase(queue.data.begin(), queue.data.begin() + static_cast<ptrdiff_t>(queue.read_pos));
+            queue.read_pos = 0;
+        }
+
+        // The losses are recorded before the next bytes of the stream
+        auto record_gap = [&channel, &queue]()
+        {
+            if (channel.lost > 0)
+            {
+                append(queue.data, ESCAPE | Command::DATA_GAP);
+                append(queue.data, channel.lost);
+                channel.lost = 0;
+            }
+        };
+
+        switch (header.type)
+        {
+            case datagram::STREAM_HEADER:
+            {
+                // Only the commands may be new: they restore the state lost in a gap
+                if (not channel.resync or header.size < 16)
+                {
+                    break;
+                }
+                uint64_t data_offset;
+                std::memcpy(&data_offset, payload + 8, sizeof(data_offset));
+                uint64_t tick_header_size = data_offset + 8;
+                if (data_offset < header.size and tick_header_size <= header.size)
+                {
+                    record_gap();
+                    queue.data.insert(queue.data.end(), payload + tick_header_size, payload + header.size);
+                    channel.resync = false;
+                }
+                break;
+            }
+            case datagram::STREAM_DATA:
+            {
+                if (queue.pending() + header.size > QUEUE_CAPACITY)
+                {
+                    lose(1);
+                    break;
+                }
+                record_gap();
+                queue.data.insert(queue.data.end(), payload, payload + header.size);
+                break;
+            }
+            case datagram::STREAM_END:
+            {
+                record_gap();
+                append(queue.data, ESCAPE | Command::DATA_STREAM_END);
+                queue.ended = true;
+                channels_.erase(it);
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+    }
+
+    DatagramListener::DatagramListener(uint16_t port, nanoseconds idle_timeout)
+        : socket_{port}
+        , batch_(BATCH)
+        , assembler_{idle_timeout}
+    {
+    }
+
+    std::error_code DatagramListener::listen()
+    {
+        return socket_.open(access::Mode::READ_WRITE | access::Mode::NON_BLOCKING);
+    }
+
+    std::vector<std::unique_ptr<AbstractIO>> DatagramListener::receive()
+    {
+        std::vector<std::unique_ptr<AbstractIO>> started;
+        nanoseconds now = since_epoch();
+
+        while (true)
+        {
+            int64_t received = socket_.read_batch(batch_.data(), batch_.size());
+            if (received <= 0)
+            {
+                break;
+            }
+
+            for (int64_t i = 0; i < received; ++i)
+            {
+                auto const& datagram = batch_[static_cast<std::size_t>(i)];
+                if (datagram.size > datagram.data.size())
+                {
+                    continue;
+                }
+                std::string sender(reinterpret_cast<char const*>(datagram.source.data()), datagram.source_size);
+                assembler_.dispatch(std::move(sender), datagram.data.data(), datagram.size, now, started);
+            }
+
+            if (static_cast<std::size_t>(received) < batch_.size())
+            {
+                break;
+            }
+        }
+
+        assembler_.expire(now);
+        return started;
+    }
+}
@@ -37,6 +37,11 @@ namespace rtm
         return from_errno(ENOSYS);
     }
 
+    os_file AbstractIO::native_handle() const
+    {
+        return -1;
+    }
+
     std::error_code AbstractIO::open(access::Mode modes)
     {
         if (is_open())
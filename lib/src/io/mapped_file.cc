@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+#include "error.h"
+#include "io/mapped_file.h"
+
+namespace rtm
+{
+    MappedFile::MappedFile(std::string_view filename)
+        : filename_{filename}
+    {
+        supported_modes_ = access::Mode::READ_ONLY;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+    int64_t MappedFile::read(void* data, int64_t data_size)
+    {
+        std::size_t size = std::min(static_cast<std::size_t>(data_size), mapping_.size() - position_);
+        if (size > 0)
+        {
+            std::memcpy(data, mapping_.data() + position_, size);
+            position_ += size;
+        }
+        return static_cast<int64_t>(size);
+    }
+
+    int64_t MappedFile::write(void const*, int64_t)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    std::error_code MappedFile::seek(int64_t pos)
+    {
+        if (pos < 0)
+        {
+            return from_errno(EINVAL);
+        }
+
+        // As lseek(): past the end, reads return 0
+        position_ = std::min(static_cast<std::size_t>(pos), mapping_.size());
+        return {};
+    }
+
+    void MappedFile::advise(std::size_t offset, std::size_t size, MemoryMapping::Advice advice) const
+    {
+        mapping_.advise(offset, size, advice);
+    }
+
+    std::error_code MappedFile::do_open(access::Mode)
+    {
+        // An empty file cannot be mapped: it is an empty mapping
+        std::error_code ec;
+        auto file_size = std::filesystem::file_size(filename_, ec);
+        if (ec)
+        {
+            return ec;
+        }
+        position_ = 0;
+        if (file_size == 0)
+        {
+            return {};
+        }
+
+        auto rc = mapping_.map(filename_, 0, false);
+        if (rc)
+        {
+            return rc;
+        }
+        mapping_.advise(0, mapping_.size(), MemoryMapping::Advice::SEQUENTIAL);
+        mapping_.advise(0, mapping_.size(), MemoryMapping::Advice::WILL_NEED);
+        return {};
+    }
+
+    std::error_code MappedFile::do_close()
+    {
+        mapping_.unmap();
+        position_ = 0;
+        return {};
+    }
+}
@@ -1,3 +1,7 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
@@ -13,7 +17,7 @@ namespace rtm
     {
         supported_modes_ = access::Mode::READ_ONLY     | access::Mode::WRITE_ONLY | access::Mode::READ_WRITE |
                            access::Mode::NON_BLOCKING  | access::Mode::TRUNCATE   | access::Mode::NEW_ONLY   |
-                           access::Mode::EXISTING_ONLY | access::Mode::APPEND;
+                           access::Mode::EXISTING_ONLY | access::Mode::APPEND     | access::Mode::DIRECT;
     }
 
     File::~File()
@@ -28,11 +32,109 @@ namespace rtm
 
     int64_t File::write(void const* data, int64_t data_size)
     {
+        if (block_ != nullptr)
+        {
+            return write_direct(data, data_size);
+        }
         return ::write(fd_, data, static_cast<std::size_t>(data_size));
     }
 
+    os_file File::native_handle() const
+    {
+        if (block_ != nullptr)
+        {
+            // Bytes are staged: writing behind our back would break the file
+            return -1;
+        }
+        return fd_;
+    }
+
+    int64_t File::write_direct(void const* data, int64_t data_size)
+    {
+        auto const* bytes = static_cast<uint8_t const*>(data);
+        std::size_t remaining = static_cast<std::size_t>(data_size);
+        while (remaining > 0)
+        {
+            std::size_t size = std::min(remaining, DIRECT_BLOCK_SIZE - block_used_);
+            std::memcpy(block_ + block_used_, bytes, size);
+            block_used_ += size;
+            bytes += size;
+            remaining -= size;
+
+            if (block_used_ == DIRECT_BLOCK_SIZE)
+            {
+                auto rc = flush_direct();
+                if (rc)
+                {
+                    errno = rc.value();
+                    return -1;
+                }
+                block_offset_ += static_cast<int64_t>(DIRECT_BLOCK_SIZE);
+                block_used_ = 0;
+                block_direct_ = 0;
+                block_synced_ = 0;
+            }
+        }
+        return data_size;
+    }
+
+    std::error_code File::flush_direct()
+    {
+        auto write_all = [](os_file fd, uint8_t const* data, std::size_t size, int64_t offset) -> std::error_code
+        {
+            std::size_t written = 0;
+            while (written < size)
+            {
+                ssize_t rc = ::pwrite(fd, data + written, size - written, offset + static_cast<int64_t>(written));
+                if (rc < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    return from_errno(errno);
+                }
+                written += static_cast<std::size_t>(rc);
+            }
+            return {};
+        };
+
+        // Each aligned part of the block is written once, bypassing the page cache
+        std::size_t aligned = block_used_ / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+        if (aligned > block_direct_)
+        {
+            auto rc = write_all(fd_, block_ + block_direct_, aligned - block_direct_,
+                                block_offset_ + static_cast<int64_t>(block_direct_));
+            if (rc)
+            {
+                return rc;
+            }
+            block_direct_ = aligned;
+            block_synced_ = std::max(block_synced_, aligned);
+        }
+
+        // The unaligned tail goes through the page cache: the file never holds padding
+        if (block_used_ > block_synced_)
+        {
+            auto rc = write_all(tail_fd_, block_ + block_synced_, block_used_ - block_synced_,
+                                block_offset_ + static_cast<int64_t>(block_synced_));
+            if (rc)
+            {
+                return rc;
+            }
+            block_synced_ = block_used_;
+        }
+        return {};
+    }
+
     std::error_code File::do_open(access::Mode access)
     {
+        bool direct = access & access::Mode::DIRECT;
+        if (direct and (access::is_readable(access) or (access & access::Mode::APPEND)))
+        {
+            return from_errno(EINVAL);
+        }
+
         int posix_flag = 0;
         if (access & access::Mode::READ_ONLY)
         {
@@ -68,10 +170,57 @@ namespace rtm
             posix_flag |= O_APPEND;
         }
 
-        fd_ = ::open(filename_.c_str(), posix_flag, S_IRUSR | S_IWUSR);
+        if (direct)
+        {
+#ifdef O_DIRECT
+            fd_ = ::open(filename_.c_str(), posix_flag | O_DIRECT, S_IRUSR | S_IWUSR);
+            if (fd_ < 0 and errno != EINVAL)
+            {
+                return from_errno(errno);
+            }
+            // EINVAL: the filesystem does not support O_DIRECT (i.e. tmpfs), use the page cache
+#endif
+        }
         if (fd_ < 0)
         {
-            return from_errno(errno);
+            fd_ = ::open(filename_.c_str(), posix_flag, S_IRUSR | S_IWUSR);
+            if (fd_ < 0)
+            {
+                return from_errno(errno);
+            }
+#ifdef F_NOCACHE
+            if (direct)
+            {
+                ::fcntl(fd_, F_NOCACHE, 1);
+            }
+#endif
+        }
+
+        if (direct)
+        {
+            // Second descriptor, without O_DIRECT, for the unaligned tail
+            tail_fd_ = ::open(filename_.c_str(), O_WRONLY);
+            if (tail_fd_ < 0)
+            {
+                int error = errno;
+                ::close(fd_);
+                fd_ = -1;
+                return from_errno(error);
+            }
+
+            block_ = static_cast<uint8_t*>(std::aligned_alloc(DIRECT_ALIGNMENT, DIRECT_BLOCK_SIZE));
+            if (block_ == nullptr)
+            {
+                ::close(tail_fd_);
+                tail_fd_ = -1;
+                ::close(fd_);
+                fd_ = -1;
+                return from_errno(ENOMEM);
+            }
+            block_used_ = 0;
+            block_direct_ = 0;
+            block_synced_ = 0;
+            block_offset_ = 0;
         }
 
         return {};
@@ -79,6 +228,16 @@ namespace rtm
 
     std::error_code File::do_close()
     {
+        std::error_code flush_rc;
+        if (block_ != nullptr)
+        {
+            flush_rc = flush_direct();
+            std::free(block_);
+            block_ = nullptr;
+            ::close(tail_fd_);
+            tail_fd_ = -1;
+        }
+
         int rc = ::close(fd_);
         if (rc < 0)
         {
@@ -86,11 +245,16 @@ namespace rtm
         }
 
         fd_ = -1;
-        return {};
+        return flush_rc;
     }
 
     std::error_code File::seek(int64_t pos)
     {
+        if (block_ != nullptr)
+        {
+            return from_errno(EINVAL);
+        }
+
         off_t rc = ::lseek(fd_, pos, SEEK_SET);
         if (rc < 0)
         {
@@ -113,6 +277,15 @@ namespace rtm
 
     std::error_code File::sync()
     {
+        if (block_ != nullptr)
+        {
+            auto flush_rc = flush_direct();
+            if (flush_rc)
+            {
+                return flush_rc;
+            }
+        }
+
         int rc = ::fsync(fd_);
         if (rc < 0)
         {
@@ -70,17 +70,12 @@ namespace rtm
 
     std::unique_ptr<AbstractSocket> LocalListener::accept(access::Mode mode)
     {
-        int socket_fd = ::accept(fd_, nullptr, nullptr);
+        int socket_fd = accept_socket(mode);
         if (socket_fd == -1)
         {
             return nullptr;
         }
 
-        if (mode & access::Mode::NON_BLOCKING)
-        {
-            set_nonblocking(socket_fd);
-        }
-
         return std::make_unique<LocalSocket>(socket_fd, mode | access::Mode::READ_WRITE);
     }
 
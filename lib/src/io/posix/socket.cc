@@ -1,3 +1,4 @@
+#include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
@@ -14,7 +15,12 @@ namespace rtm
 
     int64_t AbstractSocket::write(void const* data, int64_t data_size)
     {
+#ifdef MSG_NOSIGNAL
+        // A peer that went away must be reported as EPIPE, not kill the process with SIGPIPE
+        return ::send(fd_, data, static_cast<std::size_t>(data_size), MSG_NOSIGNAL);
+#else
         return ::write(fd_, data, static_cast<std::size_t>(data_size));
+#endif
     }
 
 
@@ -35,4 +41,30 @@ namespace rtm
 
         return {};
     }
+
+
+    os_socket AbstractListener::accept_socket(access::Mode mode)
+    {
+#ifdef __linux__
+        int flags = SOCK_CLOEXEC;
+        if (mode & access::Mode::NON_BLOCKING)
+        {
+            flags |= SOCK_NONBLOCK;
+        }
+        return ::accept4(fd_, nullptr, nullptr, flags);
+#else
+        int socket_fd = ::accept(fd_, nullptr, nullptr);
+        if (socket_fd == -1)
+        {
+            return -1;
+        }
+
+        ::fcntl(socket_fd, F_SETFD, FD_CLOEXEC);
+        if (mode & access::Mode::NON_BLOCKING)
+        {
+            ::fcntl(socket_fd, F_SETFL, ::fcntl(socket_fd, F_GETFL, 0) | O_NONBLOCK);
+        }
+        return socket_fd;
+#endif
+    }
 }
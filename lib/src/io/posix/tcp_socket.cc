@@ -174,7 +174,7 @@ namespace rtm
 
     std::unique_ptr<AbstractSocket> TcpListener::accept(access::Mode mode)
     {
-        int socket_fd = ::accept(fd_, nullptr, nullptr);
+        int socket_fd = accept_socket(mode);
         if (socket_fd == -1)
         {
             return nullptr;
@@ -183,11 +183,6 @@ namespace rtm
         int enable = 1;
         ::setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
 
-        if (mode & access::Mode::NON_BLOCKING)
-        {
-            set_nonblocking(socket_fd);
-        }
-
         return std::unique_ptr<AbstractSocket>(
             new TcpSocket(socket_fd, mode | access::Mode::READ_WRITE)
         );
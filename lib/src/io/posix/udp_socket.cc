@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstring>
+
 #include <fcntl.h>
 #include <netdb.h>
 #include <sys/socket.h>
@@ -147,4 +150,69 @@ namespace rtm
 
         return {};
     }
+
+    int64_t UdpSocket::read_batch(ReceivedDatagram* datagrams, std::size_t count)
+    {
+        count = std::min(count, MAX_BATCH);
+        if (count == 0)
+        {
+            return 0;
+        }
+
+#ifdef __linux__
+        struct mmsghdr messages[MAX_BATCH];
+        struct iovec vectors[MAX_BATCH];
+        std::memset(messages, 0, sizeof(messages));
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            vectors[i].iov_base = datagrams[i].data.data();
+            vectors[i].iov_len  = datagrams[i].data.size();
+            messages[i].msg_hdr.msg_iov     = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen  = 1;
+            messages[i].msg_hdr.msg_name    = datagrams[i].source.data();
+            messages[i].msg_hdr.msg_namelen = static_cast<socklen_t>(datagrams[i].source.size());
+        }
+
+        int received = ::recvmmsg(fd_, messages, static_cast<unsigned int>(count), MSG_WAITFORONE, nullptr);
+        if (received < 0)
+        {
+            return -1;
+        }
+
+        for (int i = 0; i < received; ++i)
+        {
+            datagrams[i].size = messages[i].msg_len;
+            datagrams[i].source_size = messages[i].msg_hdr.msg_namelen;
+            if (messages[i].msg_hdr.msg_flags & MSG_TRUNC)
+            {
+                datagrams[i].size = ReceivedDatagram::CAPACITY + 1;
+            }
+        }
+        return received;
+#else
+        int64_t received = 0;
+        int flags = 0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            socklen_t source_size = static_cast<socklen_t>(datagrams[i].source.size());
+            ssize_t size = ::recvfrom(fd_, datagrams[i].data.data(), datagrams[i].data.size(), flags,
+                                      reinterpret_cast<struct sockaddr*>(datagrams[i].source.data()), &source_size);
+            if (size < 0)
+            {
+                if (received == 0)
+                {
+                    return -1;
+                }
+                break;
+            }
+
+            datagrams[i].size = static_cast<std::size_t>(size);
+            datagrams[i].source_size = source_size;
+            received++;
+            flags = MSG_DONTWAIT; // wait for the first datagram only
+        }
+        return received;
+#endif
+    }
 }
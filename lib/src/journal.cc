@@ -0,0 +1,373 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#include "journal.h"
+#include "commands.h"
+#include "error.h"
+#include "parser.h"
+#include "serializer.h"
+#include "io/file.h"
+
+namespace rtm
+{
+    namespace
+    {
+        constexpr char     JOURNAL_MAGIC[8] = {'R', 'T', 'M', 'J', 'R', 'N', 'L', '\0'};
+        constexpr uint32_t JOURNAL_VERSION  = 1;
+        constexpr uint32_t RECORD_MARKER    = 0x4443'5252; // "RRCD"
+        constexpr uint32_t PADDING_MARKER   = 0x4441'5050; // "PPAD"
+        constexpr std::size_t PAGE_SIZE     = 4096;
+
+        // Fixed part of a tick header: magic, version and offsets (16), uuid, start time,
+        // and the sizes of the process and source names
+        constexpr std::size_t MIN_TICK_HEADER_SIZE = 16 + 16 + sizeof(uint64_t) + 2 * sizeof(uint16_t);
+
+        struct RecordHeader
+        {
+            uint32_t marker;
+            uint32_t size;              // whole record, header and padding included
+            uint32_t data_size;
+            uint32_t flags;
+            uint64_t offset;            // logical offset of the record: detects stale data
+            uint64_t entry_reference;
+            uint64_t first_sample_time;
+            uint32_t sample_count;
+            uint32_t reserved;
+        };
+
+        struct JournalHeader
+        {
+            char     magic[8];
+            uint32_t version;
+            uint32_t tick_header_size;  // the tick header bytes follow this structure
+            uint64_t data_offset;
+            uint64_t capacity;
+            uint64_t tail;              // logical offset of the oldest record
+            uint64_t head;              // logical offset past the newest record
+            uint64_t period;
+            int32_t  priority;
+            uint32_t records;
+        };
+
+        // Records are cache line aligned: the room left at the end of the data area
+        // always fits at least a record header.
+        constexpr std::size_t RECORD_ALIGNMENT = 64;
+        static_assert(sizeof(RecordHeader) <= RECORD_ALIGNMENT);
+        static_assert(PAGE_SIZE % RECORD_ALIGNMENT == 0);
+
+        std::size_t align_up(std::size_t value, std::size_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        JournalHeader* header_of(MemoryMapping const& mapping)
+        {
+            return reinterpret_cast<JournalHeader*>(mapping.data());
+        }
+    }
+
+    uint8_t* Journal::data_area() const
+    {
+        return mapping_.data() + header_of(mapping_)->data_offset;
+    }
+
+    std::error_code Journal::create(std::string const& path, std::vector<uint8_t> const& tick_header, std::size_t capacity)
+    {
+        std::size_t data_offset = align_up(sizeof(JournalHeader) + tick_header.size(), PAGE_SIZE);
+        capacity = align_up(std::max(capacity, PAGE_SIZE), PAGE_SIZE);
+
+        auto rc = mapping_.map(path, data_offset + capacity, true);
+        if (rc)
+        {
+            return rc;
+        }
+        path_ = path;
+
+        JournalHeader* hdr = header_of(mapping_);
+        std::memcpy(hdr->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        hdr->version = JOURNAL_VERSION;
+        hdr->tick_header_size = static_cast<uint32_t>(tick_header.size());
+        hdr->data_offset = data_offset;
+        hdr->capacity = capacity;
+        hdr->tail = 0;
+        hdr->head = 0;
+        hdr->period = 0;
+        hdr->priority = 0;
+        hdr->records = 0;
+        std::memcpy(mapping_.data() + sizeof(JournalHeader), tick_header.data(), tick_header.size());
+
+        return {};
+    }
+
+    void Journal::remove()
+    {
+        if (not is_open())
+        {
+            return;
+        }
+
+        mapping_.unmap();
+        std::error_code ec;
+        std::filesystem::remove(path_, ec);
+    }
+
+    uint32_t Journal::records() const
+    {
+        if (not is_open())
+        {
+            return 0;
+        }
+        return header_of(mapping_)->records;
+    }
+
+    void Journal::set_stream_state(nanoseconds period, int32_t priority)
+    {
+        JournalHeader* hdr = header_of(mapping_);
+        hdr->period = static_cast<uint64_t>(period.count());
+        hdr->priority = priority;
+    }
+
+    void Journal::drop_oldest()
+    {
+        JournalHeader* hdr = header_of(mapping_);
+        while (hdr->tail != hdr->head)
+        {
+            RecordHeader record;
+            std::memcpy(&record, data_area() + hdr->tail % hdr->capacity, sizeof(record));
+            hdr->tail += record.size;
+
+            if (record.marker == RECORD_MARKER)
+            {
+                hdr->records--;
+                return;
+            }
+        }
+    }
+
+    void Journal::clear()
+    {
+        if (not is_open())
+        {
+            return;
+        }
+
+        JournalHeader* hdr = header_of(mapping_);
+        hdr->tail = hdr->head;
+        hdr->records = 0;
+    }
+
+    bool Journal::append(nanoseconds entry_reference, nanoseconds first_sample_time,
+                         uint32_t sample_count, uint32_t flags,
+                         uint8_t const* data, std::size_t data_size)
+    {
+        JournalHeader* hdr = header_of(mapping_);
+
+        std::size_t record_size = align_up(sizeof(RecordHeader) + data_size, RECORD_ALIGNMENT);
+        if (record_size > hdr->capacity)
+        {
+            clear();
+            return false;
+        }
+
+        // A record never wraps: pad the end of the data area if needed.
+        std::size_t position = hdr->head % hdr->capacity;
+        std::size_t padding = 0;
+        if (position + record_size > hdr->capacity)
+        {
+            padding = hdr->capacity - position;
+        }
+
+        while (hdr->capacity - (hdr->head - hdr->tail) < padding + record_size)
+        {
+            drop_oldest();
+        }
+
+        if (padding > 0)
+        {
+            RecordHeader pad{};
+            pad.marker = PADDING_MARKER;
+            pad.size = static_cast<uint32_t>(padding);
+            pad.offset = hdr->head;
+            std::memcpy(data_area() + position, &pad, sizeof(pad));
+            hdr->head += padding;
+            position = 0;
+        }
+
+        RecordHeader record{};
+        record.marker = RECORD_MARKER;
+        record.size = static_cast<uint32_t>(record_size);
+        record.data_size = static_cast<uint32_t>(data_size);
+        record.flags = flags;
+        record.offset = hdr->head;
+        record.entry_reference = static_cast<uint64_t>(entry_reference.count());
+        record.first_sample_time = static_cast<uint64_t>(first_sample_time.count());
+        record.sample_count = sample_count;
+
+        uint8_t* destination = data_area() + position;
+        std::memcpy(destination, &record, sizeof(record));
+        std::memcpy(destination + sizeof(record), data, data_size);
+
+        // Publish the record once it is complete
+        hdr->head += record_size;
+        hdr->records++;
+        return true;
+    }
+
+
+    std::error_code recover_journal(std::string const& journal_path, std::string const& output_dir, std::string& tick_path)
+    {
+        MemoryMapping mapping;
+        auto rc = mapping.map(journal_path, 0, false);
+        if (rc)
+        {
+            return rc;
+        }
+
+        uint8_t const* base = mapping.data();
+        std::size_t const file_size = mapping.size();
+
+        JournalHeader hdr;
+        if (file_size < sizeof(hdr))
+        {
+            return from_errno(EINVAL);
+        }
+        std::memcpy(&hdr, base, sizeof(hdr));
+
+        if (std::memcmp(hdr.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 or hdr.version != JOURNAL_VERSION
+            or hdr.tick_header_size < MIN_TICK_HEADER_SIZE
+            or sizeof(hdr) + hdr.tick_header_size > hdr.data_offset
+            or hdr.data_offset + hdr.capacity > file_size
+            or hdr.head < hdr.tail or hdr.head - hdr.tail > hdr.capacity)
+        {
+            return from_errno(EINVAL);
+        }
+
+        // Walk the records until the head or the first damaged one
+        uint8_t const* data_area = base + hdr.data_offset;
+        std::vector<RecordHeader> records;
+        for (uint64_t offset = hdr.tail; offset < hdr.head;)
+        {
+            std::size_t position = offset % hdr.capacity;
+            RecordHeader record;
+            std::memcpy(&record, data_area + position, sizeof(record));
+
+            bool valid = (record.marker == RECORD_MARKER or record.marker == PADDING_MARKER)
+                     and record.offset == offset
+                     and record.size % RECORD_ALIGNMENT == 0 and record.size > 0
+                     and position + record.size <= hdr.capacity;
+            if (valid and record.marker == RECORD_MARKER)
+            {
+                valid = record.size >= sizeof(RecordHeader) + record.data_size;
+            }
+            if (not valid)
+            {
+                printf("[Journal] %s: damaged record at offset %lu, recovery stops there\n",
+                          journal_path.c_str(), static_cast<unsigned long>(offset));
+                break;
+            }
+
+            if (record.marker == RECORD_MARKER)
+            {
+                records.push_back(record);
+            }
+            offset += record.size;
+        }
+
+        // Start on a pair boundary, preferably on a record carrying its own reference
+        std::size_t start_idx = records.size();
+        for (std::size_t i = 0; i < records.size(); ++i)
+        {
+            if ((records[i].flags & Journal::PAIR_ALIGNED) and (records[i].flags & Journal::LEADING_REFERENCE))
+            {
+                start_idx = i;
+                break;
+            }
+        }
+        if (start_idx == records.size())
+        {
+            for (std::size_t i = 0; i < records.size(); ++i)
+            {
+                if (records[i].flags & Journal::PAIR_ALIGNED)
+                {
+                    start_idx = i;
+                    break;
+                }
+            }
+        }
+        if (start_idx == records.size())
+        {
+            return from_errno(ENODATA);
+        }
+
+        // Same header as a trigger dump, with a distinct task name
+        uint8_t const* hdr_pos = base + sizeof(hdr) + 16;
+        uint8_t const* const hdr_end = base + sizeof(hdr) + hdr.tick_header_size;
+        std::array<uint8_t, 16> uuid;
+        std::memcpy(uuid.data(), hdr_pos, uuid.size());
+        hdr_pos += uuid.size();
+        nanoseconds start_time = nanoseconds(extract_data<uint64_t>(hdr_pos));
+
+        // The names of a damaged header may point past it
+        auto extract_string = [&hdr_pos, hdr_end](std::string& str)
+        {
+            if (hdr_end - hdr_pos < static_cast<std::ptrdiff_t>(sizeof(uint16_t)))
+            {
+                return false;
+            }
+            uint16_t str_size = extract_data<uint16_t>(hdr_pos);
+            if (hdr_end - hdr_pos < str_size)
+            {
+                return false;
+            }
+            str.assign(reinterpret_cast<char const*>(hdr_pos), str_size);
+            hdr_pos += str_size;
+            return true;
+        };
+        std::string process_name;
+        std::string source_name;
+        if (not extract_string(process_name) or not extract_string(source_name))
+        {
+            return from_errno(EINVAL);
+        }
+
+        tick_path = output_dir + '/';
+        tick_path += format_iso_timestamp(start_time);
+        tick_path += '_';
+        tick_path += process_name;
+        tick_path += '_';
+        tick_path += source_name;
+        tick_path += "_recovered.tick";
+
+        File output{tick_path};
+        rc = output.open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE);
+        if (rc)
+        {
+            return rc;
+        }
+
+        auto header_bytes = build_tick_header(uuid, start_time, process_name, source_name + "@recovered");
+        output.write(header_bytes.data(), static_cast<int64_t>(header_bytes.size()));
+        write_command(output, Command::UPDATE_PERIOD, nanoseconds(hdr.period));
+        write_command(output, Command::UPDATE_PRIORITY, hdr.priority);
+
+        if (not (records[start_idx].flags & Journal::LEADING_REFERENCE))
+        {
+            write_command(output, Command::UPDATE_REFERENCE, nanoseconds(records[start_idx].entry_reference));
+            uint32_t zero_delta = 0;
+            output.write(&zero_delta, sizeof(zero_delta));
+        }
+
+        for (std::size_t i = start_idx; i < records.size(); ++i)
+        {
+            uint8_t const* record_data = data_area + records[i].offset % hdr.capacity + sizeof(RecordHeader);
+            output.write(record_data, records[i].data_size);
+        }
+
+        uint32_t sentinel = ESCAPE | Command::DATA_STREAM_END;
+        output.write(&sentinel, sizeof(sentinel));
+        return output.sync();
+    }
+}
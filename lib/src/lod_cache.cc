@@ -0,0 +1,283 @@
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+#include "lod_cache.h"
+#include "error.h"
+
+namespace rtm
+{
+    namespace
+    {
+        constexpr char     LOD_MAGIC[8] = {'R', 'T', 'M', 'L', 'O', 'D', '\0', '\0'};
+        constexpr uint32_t LOD_VERSION  = 2;    // 1: arrays of Point
+        constexpr std::size_t ARRAY_ALIGNMENT = 64;
+
+        struct ColumnRecord
+        {
+            double   origin;            // s
+            uint64_t size;
+            uint64_t xs_offset;
+            uint64_t ys_offset;
+        };
+
+        struct SectionRecord
+        {
+            double   min;               // s
+            double   max;               // s
+            ColumnRecord points;
+        };
+
+        struct SerieRecord
+        {
+            uint64_t sections_offset;
+            uint64_t sections_count;
+            ColumnRecord overview;
+            double   min;               // ms
+            double   max;               // ms
+        };
+
+        struct LodHeader
+        {
+            char     magic[8];
+            uint32_t version;
+            uint32_t overview_size;
+            uint64_t file_size;
+            int64_t  file_time;
+            uint8_t  uuid[16];
+            int64_t  begin;
+            int64_t  end;
+            int64_t  sentinel_pos;
+            uint64_t dropped;
+            SerieRecord diff;
+            SerieRecord up;
+        };
+
+        std::size_t align_up(std::size_t value, std::size_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        std::string cache_path(std::string const& tick_path)
+        {
+            return tick_path + LodCache::EXTENSION;
+        }
+
+        // An array of count T of the mapping, if it lies within it
+        template<typename T>
+        T const* resolve(MemoryMapping const& mapping, uint64_t offset, uint64_t count)
+        {
+            if (offset % alignof(T) != 0 or offset > mapping.size()
+                or count > (mapping.size() - offset) / sizeof(T))
+            {
+                return nullptr;
+            }
+            return reinterpret_cast<T const*>(mapping.data() + offset);
+        }
+
+        bool resolve(MemoryMapping const& mapping, ColumnRecord const& record, ColumnSpan& out)
+        {
+            out.origin = record.origin;
+            out.size = record.size;
+            out.xs = resolve<float>(mapping, record.xs_offset, record.size);
+            out.ys = resolve<float>(mapping, record.ys_offset, record.size);
+            return out.xs != nullptr and out.ys != nullptr;
+        }
+
+        bool resolve(MemoryMapping const& mapping, SerieRecord const& record, LodSerie& out)
+        {
+            out.min = milliseconds_f{record.min};
+            out.max = milliseconds_f{record.max};
+            if (not resolve(mapping, record.overview, out.overview))
+            {
+                return false;
+            }
+
+            auto const* sections = resolve<SectionRecord>(mapping, record.sections_offset, record.sections_count);
+            if (sections == nullptr)
+            {
+                return false;
+            }
+            out.sections.resize(record.sections_count);
+            for (std::size_t i = 0; i < out.sections.size(); ++i)
+            {
+                SectionRecord section;
+                std::memcpy(&section, sections + i, sizeof(SectionRecord));
+                out.sections[i].min = section.min;
+                out.sections[i].max = section.max;
+                if (not resolve(mapping, section.points, out.sections[i].points))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    LodKey LodCache::key_of(std::string const& tick_path, std::array<uint8_t, 16> const& uuid, uint32_t overview_size)
+    {
+        LodKey key;
+        key.uuid = uuid;
+        key.overview_size = overview_size;
+
+        std::error_code ec;
+        auto size = std::filesystem::file_size(tick_path, ec);
+        if (not ec)
+        {
+            key.file_size = static_cast<uint64_t>(size);
+        }
+        auto time = std::filesystem::last_write_time(tick_path, ec);
+        if (not ec)
+        {
+            key.file_time = static_cast<int64_t>(time.time_since_epoch().count());
+        }
+        return key;
+    }
+
+    std::error_code LodCache::open(std::string const& tick_path, LodKey const& key)
+    {
+        auto rc = mapping_.map(cache_path(tick_path), 0, false);
+        if (rc)
+        {
+            return rc;
+        }
+
+        LodHeader header;
+        if (mapping_.size() < sizeof(LodHeader))
+        {
+            mapping_.unmap();
+            return from_errno(EINVAL);
+        }
+        std::memcpy(&header, mapping_.data(), sizeof(LodHeader));
+
+        if (std::memcmp(header.magic, LOD_MAGIC, sizeof(LOD_MAGIC)) != 0 or header.version != LOD_VERSION)
+        {
+            mapping_.unmap();
+            return from_errno(EINVAL);
+        }
+
+        if (header.file_size != key.file_size or header.file_time != key.file_time
+            or header.overview_size != key.overview_size
+            or std::memcmp(header.uuid, key.uuid.data(), sizeof(header.uuid)) != 0)
+        {
+            mapping_.unmap();
+            return from_errno(ESTALE);
+        }
+
+        LodContent content;
+        if (not resolve(mapping_, header.diff, content.diff) or not resolve(mapping_, header.up, content.up))
+        {
+            mapping_.unmap();
+            return from_errno(EINVAL);
+        }
+
+        content.begin = nanoseconds{header.begin};
+        content.end = nanoseconds{header.end};
+        content.sentinel_pos = header.sentinel_pos;
+        content.dropped = header.dropped;
+        content_ = std::move(content);
+        return {};
+    }
+
+    std::error_code LodCache::write(std::string const& tick_path, LodKey const& key, LodContent const& content)
+    {
+        LodHeader header{};
+        std::memcpy(header.magic, LOD_MAGIC, sizeof(LOD_MAGIC));
+        header.version = LOD_VERSION;
+        header.overview_size = key.overview_size;
+        header.file_size = key.file_size;
+        header.file_time = key.file_time;
+        std::memcpy(header.uuid, key.uuid.data(), sizeof(header.uuid));
+        header.begin = content.begin.count();
+        header.end = content.end.count();
+        header.sentinel_pos = content.sentinel_pos;
+        header.dropped = content.dropped;
+
+        // Section tables follow the header, then the columns, each array cache line aligned
+        std::size_t offset = align_up(sizeof(LodHeader), ARRAY_ALIGNMENT);
+        auto place = [&offset](std::size_t size)
+        {
+            std::size_t array_offset = offset;
+            offset = align_up(offset + size, ARRAY_ALIGNMENT);
+            return array_offset;
+        };
+        auto place_column = [&](ColumnSpan const& column, ColumnRecord& record)
+        {
+            record.origin = column.origin;
+            record.size = column.size;
+            record.xs_offset = place(column.size * sizeof(float));
+            record.ys_offset = place(column.size * sizeof(float));
+        };
+
+        struct Placed
+        {
+            LodSerie const* serie;
+            SerieRecord* record;
+            std::vector<SectionRecord> sections;
+        };
+        Placed series[] = {{&content.diff, &header.diff, {}}, {&content.up, &header.up, {}}};
+        for (auto& placed : series)
+        {
+            placed.record->sections_count = placed.serie->sections.size();
+            placed.record->sections_offset = place(placed.serie->sections.size() * sizeof(SectionRecord));
+            placed.record->min = placed.serie->min.count();
+            placed.record->max = placed.serie->max.count();
+        }
+        for (auto& placed : series)
+        {
+            place_column(placed.serie->overview, placed.record->overview);
+            for (auto const& section : placed.serie->sections)
+            {
+                SectionRecord record{};
+                record.min = section.min;
+                record.max = section.max;
+                place_column(section.points, record.points);
+                placed.sections.push_back(record);
+            }
+        }
+
+        // Built aside, then renamed over the previous cache
+        std::string path = cache_path(tick_path);
+        std::string tmp_path = path + ".tmp";
+        {
+            MemoryMapping mapping;
+            auto rc = mapping.map(tmp_path, offset, true);
+            if (rc)
+            {
+                return rc;
+            }
+
+            std::memcpy(mapping.data(), &header, sizeof(LodHeader));
+            auto copy = [&mapping](void const* data, std::size_t size, uint64_t array_offset)
+            {
+                if (size > 0)
+                {
+                    std::memcpy(mapping.data() + array_offset, data, size);
+                }
+            };
+            auto copy_column = [&copy](ColumnSpan const& column, ColumnRecord const& record)
+            {
+                copy(column.xs, column.size * sizeof(float), record.xs_offset);
+                copy(column.ys, column.size * sizeof(float), record.ys_offset);
+            };
+            for (auto const& placed : series)
+            {
+                copy(placed.sections.data(), placed.sections.size() * sizeof(SectionRecord), placed.record->sections_offset);
+                copy_column(placed.serie->overview, placed.record->overview);
+                for (std::size_t i = 0; i < placed.sections.size(); ++i)
+                {
+                    copy_column(placed.serie->sections[i].points, placed.sections[i].points);
+                }
+            }
+        }
+
+        std::error_code rc;
+        std::filesystem::rename(tmp_path, path, rc);
+        if (rc)
+        {
+            std::error_code ignored;
+            std::filesystem::remove(tmp_path, ignored);
+        }
+        return rc;
+    }
+}
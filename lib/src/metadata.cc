@@ -59,10 +59,35 @@ namespace rtm
                 count++;
             }
 
+            if (not meta.summary.empty())
+            {
+                std::vector<uint8_t> payload;
+                append_summary(payload, meta.summary);
+
+                uint16_t key_id = MetadataKey::SUMMARY_INDEX;
+                uint32_t payload_size = static_cast<uint32_t>(payload.size());
+                append(buf, key_id);
+                append(buf, payload_size);
+                buf.insert(buf.end(), payload.begin(), payload.end());
+                count++;
+            }
+
             return count;
         }
     }
 
+    std::vector<uint8_t> serialize_footer(TickMetadata const& metadata)
+    {
+        std::vector<uint8_t> entries;
+        uint32_t entry_count = serialize_entries(entries, metadata);
+
+        std::vector<uint8_t> footer;
+        footer.reserve(sizeof(entry_count) + entries.size());
+        append(footer, entry_count);
+        footer.insert(footer.end(), entries.begin(), entries.end());
+        return footer;
+    }
+
     void save_metadata(AbstractIO& io, TickHeader const& header, TickMetadata const& metadata)
     {
         if (header.sentinel_pos <= 0)
@@ -70,18 +95,13 @@ namespace rtm
             return;
         }
 
-        std::vector<uint8_t> entries;
-        uint32_t entry_count = serialize_entries(entries, metadata);
+        auto footer = serialize_footer(metadata);
 
         int64_t footer_offset = header.sentinel_pos + 4;
         io.seek(footer_offset);
-        io.write(&entry_count, sizeof(entry_count));
-        if (not entries.empty())
-        {
-            io.write(entries.data(), static_cast<int64_t>(entries.size()));
-        }
+        io.write(footer.data(), static_cast<int64_t>(footer.size()));
 
-        int64_t new_size = footer_offset + 4 + static_cast<int64_t>(entries.size());
+        int64_t new_size = footer_offset + static_cast<int64_t>(footer.size());
         io.truncate(new_size);
 
         io.seek(metadata_ptr_offset(header));
@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+#include "metrics.h"
+
+namespace rtm
+{
+    namespace
+    {
+        // Formatted in place at the end of out: a line is never truncated
+        void append_format(std::string& out, char const* format, ...)
+        {
+            va_list args;
+            va_start(args, format);
+            va_list retry;
+            va_copy(retry, args);
+
+            char line[512];
+            int size = vsnprintf(line, sizeof(line), format, args);
+            if (size > 0 and static_cast<std::size_t>(size) < sizeof(line))
+            {
+                out.append(line, static_cast<std::size_t>(size));
+            }
+            else if (size > 0)
+            {
+                // Too long (labels): format again in the string itself
+                std::size_t const end = out.size();
+                out.resize(end + static_cast<std::size_t>(size) + 1);
+                vsnprintf(out.data() + end, static_cast<std::size_t>(size) + 1, format, retry);
+                out.resize(end + static_cast<std::size_t>(size));
+            }
+
+            va_end(retry);
+            va_end(args);
+        }
+
+        std::string escape_label(std::string const& value)
+        {
+            std::string escaped;
+            escaped.reserve(value.size());
+            for (char c : value)
+            {
+                if (c == '\\' or c == '"')
+                {
+                    escaped += '\\';
+                    escaped += c;
+                }
+                else if (c == '\n')
+                {
+                    escaped += "\\n";
+                }
+                else
+                {
+                    escaped += c;
+                }
+            }
+            return escaped;
+        }
+
+        std::string format_bytes(double bytes)
+        {
+            char const* units[] = {"B", "KiB", "MiB", "GiB"};
+            std::size_t unit = 0;
+            while (bytes >= 1024.0 and unit < std::size(units) - 1)
+            {
+                bytes /= 1024.0;
+                unit++;
+            }
+
+            char text[32];
+            snprintf(text, sizeof(text), "%.1f %s", bytes, units[unit]);
+            return text;
+        }
+
+        std::string format_quantile(LatencyHistogram const& histogram)
+        {
+            if (histogram.count() == 0)
+            {
+                return "-";
+            }
+
+            nanoseconds bound = histogram.quantile(0.99);
+            if (bound == nanoseconds::max())
+            {
+                return "> 2.5s";
+            }
+
+            char text[32];
+            snprintf(text, sizeof(text), "<= %.2fms", milliseconds_f(bound).count());
+            return text;
+        }
+    }
+
+    void LatencyHistogram::record(nanoseconds latency)
+    {
+        auto bucket = std::lower_bound(BOUNDS.begin(), BOUNDS.end(), latency) - BOUNDS.begin();
+        buckets_[static_cast<std::size_t>(bucket)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(static_cast<uint64_t>(std::max(latency, 0ns).count()), std::memory_order_relaxed);
+    }
+
+    nanoseconds LatencyHistogram::quantile(double q) const
+    {
+        double target = q * static_cast<double>(count());
+        uint64_t cumulative = 0;
+        for (std::size_t i = 0; i < BOUNDS.size(); ++i)
+        {
+            cumulative += buckets_[i].load(std::memory_order_relaxed);
+            if (static_cast<double>(cumulative) >= target)
+            {
+                return BOUNDS[i];
+            }
+        }
+        return nanoseconds::max();
+    }
+
+    void LatencyHistogram::write_prometheus(std::string& out, char const* name, char const* help) const
+    {
+        append_format(out, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+
+        uint64_t cumulative = 0;
+        for (std::size_t i = 0; i < BOUNDS.size(); ++i)
+        {
+            cumulative += buckets_[i].load(std::memory_order_relaxed);
+            append_format(out, "%s_bucket{le=\"%g\"} %lu\n", name, seconds_f(BOUNDS[i]).count(),
+                          static_cast<unsigned long>(cumulative));
+        }
+        cumulative += buckets_.back().load(std::memory_order_relaxed);
+        append_format(out, "%s_bucket{le=\"+Inf\"} %lu\n", name, static_cast<unsigned long>(cumulative));
+        append_format(out, "%s_sum %.9f\n", name, static_cast<double>(sum_.load(std::memory_order_relaxed)) * 1e-9);
+        append_format(out, "%s_count %lu\n", name, static_cast<unsigned long>(cumulative));
+    }
+
+    std::shared_ptr<ClientMetrics> RecorderMetrics::add_client(uint64_t id, std::string const& process, std::string const& source)
+    {
+        auto client = std::make_shared<ClientMetrics>();
+        client->id = id;
+        client->process = process;
+        client->source = source;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        clients_.push_back(client);
+        return client;
+    }
+
+    void RecorderMetrics::remove_client(std::shared_ptr<ClientMetrics> const& client)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        clients_.erase(std::remove(clients_.begin(), clients_.end(), client), clients_.end());
+    }
+
+    std::string RecorderMetrics::prometheus() const
+    {
+        std::string out;
+        out.reserve(4096);
+
+        auto counter = [&out](char const* name, char const* help, uint64_t value)
+        {
+            append_format(out, "# HELP %s %s\n# TYPE %s counter\n%s %lu\n",
+                          name, help, name, name, static_cast<unsigned long>(value));
+        };
+        counter("rtm_received_bytes_total", "Bytes received from the probes.", bytes.load(std::memory_order_relaxed));
+        counter("rtm_received_samples_total", "Samples received from the probes.", samples.load(std::memory_order_relaxed));
+        counter("rtm_triggers_total", "Blackbox triggers.", triggers.load(std::memory_order_relaxed));
+        counter("rtm_subscribers_dropped_total", "Subscribers dropped for being too slow.",
+                subscribers_dropped.load(std::memory_order_relaxed));
+        counter("rtm_write_errors_total", "Failed writes or syncs of the recordings.",
+                write_errors.load(std::memory_order_relaxed));
+        counter("rtm_recordings_deleted_total", "Recordings deleted to respect the disk quota.",
+                recordings_deleted.load(std::memory_order_relaxed));
+        append_format(out, "# HELP rtm_recorded_bytes Size of the recordings on disk.\n# TYPE rtm_recorded_bytes gauge\n"
+                           "rtm_recorded_bytes %lu\n", static_cast<unsigned long>(recorded_bytes.load(std::memory_order_relaxed)));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        append_format(out, "# HELP rtm_clients Connected probes.\n# TYPE rtm_clients gauge\nrtm_clients %zu\n", clients_.size());
+
+        struct Series
+        {
+            char const* name;
+            char const* type;
+            char const* help;
+            std::atomic<uint64_t> ClientMetrics::* value;
+        };
+        static constexpr Series SERIES[] =
+        {
+            {"rtm_client_received_bytes_total",   "counter", "Bytes received from the probe.",              &ClientMetrics::bytes},
+            {"rtm_client_received_samples_total", "counter", "Samples received from the probe.",            &ClientMetrics::samples},
+            {"rtm_client_backlog_bytes",          "gauge",   "Bytes received but not processed yet.",       &ClientMetrics::backlog_bytes},
+            {"rtm_client_ring_bytes",             "gauge",   "Blackbox ring size, in memory and spilled.",  &ClientMetrics::ring_bytes},
+            {"rtm_client_triggers_total",         "counter", "Blackbox triggers of the probe.",             &ClientMetrics::triggers},
+        };
+
+        for (auto const& series : SERIES)
+        {
+            append_format(out, "# HELP %s %s\n# TYPE %s %s\n", series.name, series.help, series.name, series.type);
+            for (auto const& client : clients_)
+            {
+                append_format(out, "%s{client=\"%lu\",process=\"%s\",source=\"%s\"} %lu\n", series.name,
+                              static_cast<unsigned long>(client->id),
+                              escape_label(client->process).c_str(), escape_label(client->source).c_str(),
+                              static_cast<unsigned long>(((*client).*series.value).load(std::memory_order_relaxed)));
+            }
+        }
+
+        sync_latency.write_prometheus(out, "rtm_sync_latency_seconds", "Duration of the fsync of the recordings.");
+        write_latency.write_prometheus(out, "rtm_write_latency_seconds", "Delay between the reception of data and its fsync.");
+        return out;
+    }
+
+    std::string RecorderMetrics::summary()
+    {
+        nanoseconds now = since_epoch();
+        uint64_t total_bytes = bytes.load(std::memory_order_relaxed);
+        uint64_t total_samples = samples.load(std::memory_order_relaxed);
+
+        double elapsed = 0.0;
+        if (last_summary_ > 0ns)
+        {
+            elapsed = seconds_f(now - last_summary_).count();
+        }
+        double byte_rate = 0.0;
+        double sample_rate = 0.0;
+        if (elapsed > 0.0)
+        {
+            byte_rate = static_cast<double>(total_bytes - last_bytes_) / elapsed;
+            sample_rate = static_cast<double>(total_samples - last_samples_) / elapsed;
+        }
+        last_summary_ = now;
+        last_bytes_ = total_bytes;
+        last_samples_ = total_samples;
+
+        std::size_t clients = 0;
+        uint64_t backlog = 0;
+        uint64_t rings = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            clients = clients_.size();
+            for (auto const& client : clients_)
+            {
+                backlog += client->backlog_bytes.load(std::memory_order_relaxed);
+                rings += client->ring_bytes.load(std::memory_order_relaxed);
+            }
+        }
+
+        std::string line;
+        append_format(line, "%zu client(s), %s/s, %.0f samples/s, backlog %s, rings %s, %lu trigger(s), "
+                            "sync p99 %s, read-to-disk p99 %s",
+                      clients, format_bytes(byte_rate).c_str(), sample_rate,
+                      format_bytes(static_cast<double>(backlog)).c_str(), format_bytes(static_cast<double>(rings)).c_str(),
+                      static_cast<unsigned long>(triggers.load(std::memory_order_relaxed)),
+                      format_quantile(sync_latency).c_str(), format_quantile(write_latency).c_str());
+        return line;
+    }
+}
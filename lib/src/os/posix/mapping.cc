@@ -0,0 +1,118 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "error.h"
+#include "os/mapping.h"
+
+namespace rtm
+{
+    MemoryMapping::~MemoryMapping()
+    {
+        unmap();
+    }
+
+    MemoryMapping::MemoryMapping(MemoryMapping&& other) noexcept
+        : data_{std::exchange(other.data_, nullptr)}
+        , size_{std::exchange(other.size_, 0)}
+    {
+
+    }
+
+    MemoryMapping& MemoryMapping::operator=(MemoryMapping&& other) noexcept
+    {
+        if (this != &other)
+        {
+            unmap();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    std::error_code MemoryMapping::map(std::string const& path, std::size_t size, bool writable)
+    {
+        unmap();
+
+        int fd = ::open(path.c_str(), writable ? (O_RDWR | O_CREAT) : O_RDONLY, S_IRUSR | S_IWUSR);
+        if (fd < 0)
+        {
+            return from_errno(errno);
+        }
+
+        if (writable)
+        {
+            if (::ftruncate(fd, static_cast<off_t>(size)) < 0)
+            {
+                int err = errno;
+                ::close(fd);
+                return from_errno(err);
+            }
+        }
+        else
+        {
+            struct stat st;
+            if (::fstat(fd, &st) < 0)
+            {
+                int err = errno;
+                ::close(fd);
+                return from_errno(err);
+            }
+            size = static_cast<std::size_t>(st.st_size);
+        }
+
+        if (size == 0)
+        {
+            ::close(fd);
+            return from_errno(EINVAL);
+        }
+
+        int prot = PROT_READ;
+        if (writable)
+        {
+            prot |= PROT_WRITE;
+        }
+
+        void* address = ::mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+        int err = errno;
+        ::close(fd); // the mapping keeps its own reference on the file
+        if (address == MAP_FAILED)
+        {
+            return from_errno(err);
+        }
+
+        data_ = static_cast<uint8_t*>(address);
+        size_ = size;
+        return {};
+    }
+
+    void MemoryMapping::unmap()
+    {
+        if (data_ != nullptr)
+        {
+            ::munmap(data_, size_);
+            data_ = nullptr;
+            size_ = 0;
+        }
+    }
+
+    void MemoryMapping::advise(std::size_t offset, std::size_t size, Advice advice) const
+    {
+        if (data_ == nullptr or offset >= size_)
+        {
+            return;
+        }
+
+        // madvise() wants a page aligned address
+        static std::size_t const page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        std::size_t begin = offset / page_size * page_size;
+        std::size_t end = offset + std::min(size, size_ - offset);
+
+        int posix_advice = (advice == Advice::SEQUENTIAL) ? MADV_SEQUENTIAL : MADV_WILLNEED;
+        (void) ::madvise(data_ + begin, end - begin, posix_advice);
+    }
+}
@@ -1,9 +1,73 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "io/mapped_file.h"
+#include "delta.h"
 #include "serializer.h"
 #include "parser.h"
 
 namespace rtm
 {
-    bool Parser::load_samples()
+    uint8_t const* Parser::decode(uint8_t const* pos, uint8_t const* end, nanoseconds start_time, DecodeState& state)
+    {
+        state.status = DecodeStatus::MORE;
+        while (pos + sizeof(uint32_t) <= end)
+        {
+            uint32_t raw_sample;
+            std::memcpy(&raw_sample, pos, sizeof(raw_sample));
+            if (not (raw_sample & ESCAPE))
+            {
+                // Plain deltas come in long runs between rare commands: converted in bulk, by
+                // chunks to keep the words in cache between the run scan and the conversion.
+                // The run is measured first: resize() zero fills only what is decoded.
+                constexpr std::size_t CHUNK = 4096;
+                std::size_t count = std::min(static_cast<std::size_t>(end - pos) / sizeof(uint32_t), CHUNK);
+                count = delta_run(pos, count);
+                std::size_t size = state.samples.size();
+                state.samples.resize(size + count);
+                decode_deltas(pos, count, state.reference - start_time, state.samples.data() + size);
+                pos += count * sizeof(uint32_t);
+                continue;
+            }
+
+            if (raw_sample == (ESCAPE | Command::DATA_STREAM_END))
+            {
+                state.status = DecodeStatus::END;
+                return pos;
+            }
+
+            std::size_t size = element_size(raw_sample);
+            if (size == sizeof(uint32_t))
+            {
+                // Unrecognized escape command — the stream is desynced,
+                // any further parsing would produce garbage. Bail out.
+                state.status = DecodeStatus::ERROR;
+                state.unknown = raw_sample;
+                return pos;
+            }
+            if (pos + size > end)
+            {
+                return pos; // the payload is in the next chunk
+            }
+
+            uint8_t const* payload = pos + sizeof(uint32_t);
+            if (raw_sample & Command::UPDATE_REFERENCE)
+            {
+                state.reference = nanoseconds{extract_data<uint64_t>(payload)};
+                state.samples.push_back(state.reference - start_time);
+            }
+            else if (raw_sample & Command::DATA_GAP)
+            {
+                state.dropped += extract_data<uint64_t>(payload);
+            }
+            // UPDATE_PERIOD, UPDATE_PRIORITY, SET_THRESHOLD and SET_TRIGGER: not needed to plot
+            pos += size;
+        }
+        return pos;
+    }
+
+    int64_t Parser::seek_data_section()
     {
         // jump to data section
         io_->seek(header_.data_section_offset);
@@ -11,140 +75,221 @@ namespace rtm
         // Get version
         io_->read(&header_.data_version, 2);
         io_->seek(header_.data_section_offset + 8);
+        return static_cast<int64_t>(header_.data_section_offset) + 8;
+    }
 
-        // extracts samples
-        nanoseconds last_reference{};
-        std::vector<nanoseconds> samples;
+    int64_t Parser::decode_file(int64_t from, int64_t to, DecodeState& state)
+    {
+        if (auto* mapped = dynamic_cast<MappedFile*>(io_.get()))
+        {
+            // Decode in place: no copy, no chunk boundary
+            int64_t const size = static_cast<int64_t>(mapped->size());
+            if (to < 0 or to > size)
+            {
+                to = size;
+            }
+            uint8_t const* const data = mapped->data();
+            if (data == nullptr or from >= to)
+            {
+                return from;
+            }
+
+            state.samples.reserve(state.samples.size() + static_cast<std::size_t>(to - from) / sizeof(uint32_t));
+            return decode(data + from, data + to, header_.start_time, state) - data;
+        }
 
         constexpr std::size_t BUFFER_SIZE = 2 << 15; // 64KB;
         uint8_t buffer[BUFFER_SIZE];
-        uint8_t const* pos = buffer;
-        int64_t available_bytes = 0;
-        int64_t file_base = static_cast<int64_t>(header_.data_section_offset) + 8;
+        std::size_t available_bytes = 0;
+        int64_t file_base = from;
+        int64_t read_pos = from;
+        io_->seek(from);
 
-        auto refill = [&]() -> int64_t
+        state.status = DecodeStatus::MORE;
+        while (state.status == DecodeStatus::MORE)
         {
-            std::size_t remaining = available_bytes - (pos - buffer);
-            file_base += (pos - buffer);
-            // pos overlaps with buffer (it is a pointer into buffer), so memmove is required.
-            std::memmove(buffer, pos, remaining);
-            pos = buffer;
-            int64_t newly_read = io_->read(buffer + remaining, BUFFER_SIZE - remaining);
-            if (newly_read > 0)
+            int64_t to_read = static_cast<int64_t>(BUFFER_SIZE - available_bytes);
+            if (to >= 0)
             {
-                available_bytes = static_cast<int64_t>(remaining) + newly_read;
-                return available_bytes;
+                to_read = std::min(to_read, to - read_pos);
             }
-            available_bytes = static_cast<int64_t>(remaining);
-            return 0;
-        };
+            int64_t newly_read = 0;
+            if (to_read > 0)
+            {
+                newly_read = io_->read(buffer + available_bytes, to_read);
+            }
+            if (newly_read <= 0)
+            {
+                break; // end of the range, or truncated stream: the sentinel is missing
+            }
+            read_pos += newly_read;
+            available_bytes += static_cast<std::size_t>(newly_read);
+
+            uint8_t const* pos = decode(buffer, buffer + available_bytes, header_.start_time, state);
+            std::size_t consumed = static_cast<std::size_t>(pos - buffer);
+
+            // Keep the incomplete element for the next read
+            file_base += static_cast<int64_t>(consumed);
+            available_bytes -= consumed;
+            std::memmove(buffer, pos, available_bytes);
+        }
+        return file_base;
+    }
+
+    void Parser::set_sentinel(DecodeStatus status, int64_t offset)
+    {
+        if (status == DecodeStatus::END)
+        {
+            header_.sentinel_pos = offset;
+        }
+        else if (status == DecodeStatus::MORE)
+        {
+            header_.sentinel_pos = -offset; // truncated stream: the sentinel is missing
+        }
+    }
+
+    bool Parser::load_samples()
+    {
+        DecodeState state;
+        int64_t offset = decode_file(seek_data_section(), -1, state);
+        set_sentinel(state.status, offset);
+        return store_samples(std::move(state));
+    }
 
-        auto check_boundary = [&](std::size_t up_to)
+    bool Parser::load_samples(nanoseconds begin, nanoseconds end)
+    {
+        if (begin == 0ns and end == 0ns)
+        {
+            return load_samples();
+        }
+
+        int64_t const data_start = seek_data_section();
+        nanoseconds const start_time = header_.start_time;
+        auto const& blocks = metadata_.summary;
+
+        // Negative bounds are relative to the last sample, end = 0 is the last sample
+        auto resolve = [&](nanoseconds last)
         {
-            return ((pos + up_to) <= (buffer + available_bytes));
+            if (begin < 0ns)
+            {
+                begin += last;
+            }
+            if (end <= 0ns)
+            {
+                end += last;
+            }
         };
 
-        bool end_of_stream = false;
-        while (not end_of_stream)
+        DecodeState state;
+        if (blocks.empty())
         {
-            // read a chunk
-            if (refill() <= 0)
+            // No index: the end of the file is decoded until it covers the range, or everything
+            if (not decode_tail(data_start, begin, state))
+            {
+                state = DecodeState{};
+                int64_t offset = decode_file(data_start, -1, state);
+                set_sentinel(state.status, offset);
+            }
+            if (not state.samples.empty())
+            {
+                resolve(state.samples.back());
+            }
+        }
+        else
+        {
+            resolve(blocks.back().end - start_time);
+
+            // Decode the blocks overlapping the range only
+            std::size_t first = 0;
+            while (first < blocks.size() and blocks[first].end - start_time < begin)
+            {
+                ++first;
+            }
+            std::size_t last = first;
+            while (last < blocks.size() and blocks[last].begin - start_time <= end)
             {
-                header_.sentinel_pos = -(file_base + available_bytes);
-                break;
+                ++last;
             }
 
-            // parse data in the chunk
-            while (check_boundary(sizeof(uint32_t)))
+            if (first < last)
             {
-                uint32_t raw_sample = extract_data<uint32_t>(pos);
-                if (raw_sample & ESCAPE)
+                state.reference = blocks[first].reference;
+                int64_t to = (last < blocks.size()) ? blocks[last].offset : -1;
+                int64_t offset = decode_file(blocks[first].offset, to, state);
+                if (to < 0)
                 {
-                    if (raw_sample == (ESCAPE | Command::DATA_STREAM_END))
-                    {
-                        header_.sentinel_pos = file_base + (pos - buffer) - 4;
-                        end_of_stream = true;
-                        break;
-                    }
-
-                    if (raw_sample & Command::UPDATE_REFERENCE)
-                    {
-                        if (not check_boundary(sizeof(uint64_t)))
-                        {
-                            refill();
-                            if (not check_boundary(sizeof(uint64_t)))
-                            {
-                                end_of_stream = true;
-                                break;
-                            }
-                        }
-
-                        last_reference = nanoseconds{extract_data<uint64_t>(pos)};
-                        samples_.push_back(last_reference - header_.start_time);
-                        continue;
-                    }
-
-                    if (raw_sample & Command::UPDATE_PERIOD)
-                    {
-                        if (not check_boundary(sizeof(uint64_t)))
-                        {
-                            refill();
-                            if (not check_boundary(sizeof(uint64_t)))
-                            {
-                                end_of_stream = true;
-                                break;
-                            }
-                        }
-
-                        extract_data<uint64_t>(pos);
-                        continue;
-                    }
-
-                    if (raw_sample & Command::UPDATE_PRIORITY)
-                    {
-                        if (not check_boundary(sizeof(int32_t)))
-                        {
-                            refill();
-                            if (not check_boundary(sizeof(int32_t)))
-                            {
-                                end_of_stream = true;
-                                break;
-                            }
-                        }
-
-                        extract_data<int32_t>(pos);
-                        continue;
-                    }
-
-                    if (raw_sample & Command::SET_THRESHOLD)
-                    {
-                        if (not check_boundary(sizeof(uint64_t)))
-                        {
-                            refill();
-                            if (not check_boundary(sizeof(uint64_t)))
-                            {
-                                end_of_stream = true;
-                                break;
-                            }
-                        }
-
-                        extract_data<uint64_t>(pos);
-                        continue;
-                    }
-
-                    // Unrecognized escape command — the stream is desynced,
-                    // any further parsing would produce garbage. Bail out.
-                    printf("Something wrong happened: command not recognized! (%08x)\n", raw_sample);
-                    end_of_stream = true;
-                    break;
+                    set_sentinel(state.status, offset);
+                }
+                else if (state.status == DecodeStatus::END)
+                {
+                    state.status = DecodeStatus::MORE; // the summary index does not match the data
                 }
-
-                nanoseconds sample = nanoseconds(raw_sample) + (last_reference - header_.start_time);
-                samples_.push_back(sample);
             }
+        }
+
+        // Trim to the range, on whole start/end pairs: blocks start on a pair.
+        auto& samples = state.samples;
+        std::size_t from = static_cast<std::size_t>(std::lower_bound(samples.begin(), samples.end(), begin) - samples.begin());
+        std::size_t to = static_cast<std::size_t>(std::upper_bound(samples.begin(), samples.end(), end) - samples.begin());
+        from -= from % 2;
+        to = std::min(to + to % 2, samples.size());
+        if (from >= to)
+        {
+            samples.clear();
+        }
+        else
+        {
+            samples.erase(samples.begin() + static_cast<std::ptrdiff_t>(to), samples.end());
+            samples.erase(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(from));
+        }
+
+        return store_samples(std::move(state));
+    }
 
+    std::size_t Parser::poll_samples()
+    {
+        if (poll_done_)
+        {
+            return 0;
+        }
+
+        DecodeState state;
+        if (poll_offset_ < 0)
+        {
+            poll_offset_ = seek_data_section();
         }
+        state.reference = poll_reference_;
 
+        poll_offset_ = decode_file(poll_offset_, -1, state);
+        poll_reference_ = state.reference;
+        set_sentinel(state.status, poll_offset_);
+        dropped_ += state.dropped;
+        if (state.status == DecodeStatus::ERROR)
+        {
+            printf("Something wrong happened: command not recognized! (%08x)\n", state.unknown);
+        }
+        poll_done_ = (state.status != DecodeStatus::MORE);
+
+        std::size_t const count = state.samples.size();
+        if (count == 0)
+        {
+            return 0;
+        }
+        samples_.insert(samples_.end(), state.samples.begin(), state.samples.end());
+        begin_ = samples_.front();
+        end_   = samples_.back();
+        return count;
+    }
+
+    bool Parser::store_samples(DecodeState&& state)
+    {
+        if (state.status == DecodeStatus::ERROR)
+        {
+            printf("Something wrong happened: command not recognized! (%08x)\n", state.unknown);
+        }
+
+        samples_ = std::move(state.samples);
+        dropped_ = state.dropped;
         if (samples_.empty())
         {
             return false;
@@ -156,12 +301,12 @@ namespace rtm
     }
 
 
-    std::vector<Point> Parser::generate_times_diff()
+    std::vector<Point> Parser::generate_times_diff(std::size_t from)
     {
         std::vector<Point> serie;
-        serie.reserve(samples_.size() / 2);
+        serie.reserve((samples_.size() - std::min(from, samples_.size())) / 2);
 
-        for (std::size_t i = 2; i < samples_.size(); i += 2)
+        for (std::size_t i = std::max<std::size_t>(2, from + from % 2); i < samples_.size(); i += 2)
         {
             seconds_f x = samples_[i];
             milliseconds_f y = samples_[i] - samples_[i - 2];
@@ -173,12 +318,12 @@ namespace rtm
         return serie;
     }
 
-    std::vector<Point> Parser::generate_times_up()
+    std::vector<Point> Parser::generate_times_up(std::size_t from)
     {
         std::vector<Point> serie;
-        serie.reserve(samples_.size() / 2);
+        serie.reserve((samples_.size() - std::min(from, samples_.size())) / 2);
 
-        for (std::size_t i = 1; i < samples_.size(); i += 2)
+        for (std::size_t i = from + 1 - from % 2; i < samples_.size(); i += 2)
         {
             seconds_f x = samples_[i - 1];
             milliseconds_f y = samples_[i] - samples_[i - 1];
@@ -190,6 +335,93 @@ namespace rtm
         return serie;
     }
 
+    namespace
+    {
+        class SeriesBuilder final : public TickVisitor
+        {
+        public:
+            SeriesBuilder(TickSeries& out)
+                : out_{out}
+            {
+            }
+
+            bool on_loop(nanoseconds start, nanoseconds end) override
+            {
+                on_start(start);
+                milliseconds_f up = end - start;
+                out_.up.push_back({seconds_f(start).count(), up.count()});
+                out_.up_stats.add(end - start);
+                last_ = end;
+                return true;
+            }
+
+            void on_unfinished(nanoseconds start) override
+            {
+                on_start(start);
+                last_ = start;
+            }
+
+            bool empty() const          { return not has_start_; }
+            nanoseconds first() const   { return first_; }
+            nanoseconds last() const    { return last_; }
+
+        private:
+            void on_start(nanoseconds start)
+            {
+                if (has_start_)
+                {
+                    milliseconds_f diff = start - previous_start_;
+                    out_.diff.push_back({seconds_f(start).count(), diff.count()});
+                    out_.diff_stats.add(start - previous_start_);
+                }
+                else
+                {
+                    first_ = start;
+                    has_start_ = true;
+                }
+                previous_start_ = start;
+            }
+
+            TickSeries& out_;
+            bool has_start_{false};
+            nanoseconds previous_start_{0};
+            nanoseconds first_{0};
+            nanoseconds last_{0};
+        };
+    }
+
+    bool Parser::load_series(TickSeries& out)
+    {
+        if (auto* mapped = dynamic_cast<MappedFile*>(io_.get()))
+        {
+            // One point per loop in each series: 8 bytes of data per loop
+            std::size_t data_size = mapped->size() - std::min(mapped->size(), static_cast<std::size_t>(header_.data_section_offset));
+            out.diff.reserve(data_size / (2 * sizeof(uint32_t)));
+            out.up.reserve(data_size / (2 * sizeof(uint32_t)));
+        }
+
+        SeriesBuilder builder{out};
+        visit(builder);
+        if (builder.empty())
+        {
+            return false;
+        }
+
+        begin_ = builder.first();
+        end_   = builder.last();
+        if (out.diff_stats.count > 0)
+        {
+            diff_min_ = nanoseconds{out.diff_stats.min};
+            diff_max_ = nanoseconds{out.diff_stats.max};
+        }
+        if (out.up_stats.count > 0)
+        {
+            up_min_ = nanoseconds{out.up_stats.min};
+            up_max_ = nanoseconds{out.up_stats.max};
+        }
+        return true;
+    }
+
     nanoseconds Parser::begin() const
     {
         return begin_;
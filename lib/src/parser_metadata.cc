@@ -8,6 +8,9 @@ namespace rtm
     // (display name, weight, visibility). Anything past this is corruption.
     constexpr uint32_t MAX_PAYLOAD_SIZE = 64 * 1024;
 
+    // The summary index grows with the file: ~2 KiB per million samples.
+    constexpr uint32_t MAX_SUMMARY_PAYLOAD_SIZE = 64 * 1024 * 1024;
+
     void Parser::load_metadata()
     {
         if (header_.metadata_footer_offset <= 0)
@@ -35,11 +38,16 @@ namespace rtm
                 return;
             }
 
-            if (payload_size > MAX_PAYLOAD_SIZE)
+            uint32_t max_payload_size = MAX_PAYLOAD_SIZE;
+            if (key_id == MetadataKey::SUMMARY_INDEX)
+            {
+                max_payload_size = MAX_SUMMARY_PAYLOAD_SIZE;
+            }
+            if (payload_size > max_payload_size)
             {
                 printf("[Metadata] Payload size %u exceeds cap (%u) at entry %u — "
                        "footer is likely corrupt, aborting.\n",
-                       payload_size, MAX_PAYLOAD_SIZE, i);
+                       payload_size, max_payload_size, i);
                 return;
             }
 
@@ -73,6 +81,14 @@ namespace rtm
                     }
                     break;
                 }
+                case MetadataKey::SUMMARY_INDEX:
+                {
+                    if (not read_summary(reinterpret_cast<uint8_t const*>(buf.data()), payload_size, metadata_.summary))
+                    {
+                        printf("[Metadata] Invalid summary index\n");
+                    }
+                    break;
+                }
                 default:
                 {
                     printf("[Metadata] Unknown key id: %u\n", key_id);
@@ -81,4 +97,29 @@ namespace rtm
             }
         }
     }
+
+    bool Parser::overview(SummaryBlock& out, nanoseconds begin, nanoseconds end) const
+    {
+        if (metadata_.summary.empty())
+        {
+            return false;
+        }
+
+        auto to_absolute = [this](nanoseconds time)
+        {
+            if (time == nanoseconds::min() or time == nanoseconds::max())
+            {
+                return time;
+            }
+            return time + header_.start_time;
+        };
+        out = merge_summary(metadata_.summary, to_absolute(begin), to_absolute(end));
+        if (out.samples > 0)
+        {
+            out.begin -= header_.start_time;
+            out.end -= header_.start_time;
+            out.reference -= header_.start_time;
+        }
+        return true;
+    }
 }
@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "io/mapped_file.h"
+#include "parser.h"
+
+namespace rtm
+{
+    // Below this, a segment costs more to schedule than to decode
+    constexpr std::size_t MIN_SEGMENT_SIZE = 1 << 20;
+
+    // First span of the file decoded backward by load_samples(begin, end) without index
+    constexpr std::size_t MIN_TAIL_SIZE = 1 << 16;
+
+    // True if the word at pos would be the payload of a command starting in the 16 bytes before.
+    // Samples never have the ESCAPE bit: a reference update that follows samples is never rejected.
+    static bool in_payload(uint8_t const* data, std::size_t first, std::size_t pos)
+    {
+        for (std::size_t back = sizeof(uint32_t); back <= 4 * sizeof(uint32_t) and pos - back >= first; back += sizeof(uint32_t))
+        {
+            uint32_t word;
+            std::memcpy(&word, data + pos - back, sizeof(word));
+            if ((word & ESCAPE) and element_size(word) > back)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // First UPDATE_REFERENCE candidate in [pos, end), element aligned (relative to first). Returns end if none.
+    // The word may still be the payload of another command: the stitching validates it.
+    static std::size_t find_reference(uint8_t const* data, std::size_t first, std::size_t pos, std::size_t end, std::size_t size)
+    {
+        pos -= (pos - first) % sizeof(uint32_t);
+        for (; pos < end and pos + sizeof(uint32_t) + sizeof(uint64_t) <= size; pos += sizeof(uint32_t))
+        {
+            uint32_t word;
+            std::memcpy(&word, data + pos, sizeof(word));
+            if (word == (ESCAPE | Command::UPDATE_REFERENCE) and not in_payload(data, first, pos))
+            {
+                return pos;
+            }
+        }
+        return end;
+    }
+
+    bool Parser::decode_tail(int64_t data_start, nanoseconds begin, DecodeState& out)
+    {
+        auto* mapped = dynamic_cast<MappedFile*>(io_.get());
+        if (mapped == nullptr or mapped->data() == nullptr)
+        {
+            return false;
+        }
+
+        uint8_t const* const data = mapped->data();
+        std::size_t const first = static_cast<std::size_t>(data_start);
+        std::size_t const size = mapped->size();
+        if (first >= size)
+        {
+            return false;
+        }
+
+        // Spans doubling from the end: at most twice the decoding of the range
+        for (std::size_t span = MIN_TAIL_SIZE; span < size - first; span *= 2)
+        {
+            std::size_t from = find_reference(data, first, size - span, size, size);
+            if (from == size)
+            {
+                continue;
+            }
+
+            DecodeState state;
+            uint8_t const* stop = decode(data + from, data + size, header_.start_time, state);
+            if (state.status != DecodeStatus::END or state.samples.empty())
+            {
+                // Without the sentinel, the pairs are only known from the start of the data
+                return false;
+            }
+
+            nanoseconds const range_begin = (begin < 0ns) ? begin + state.samples.back() : begin;
+            if (state.samples.front() > range_begin)
+            {
+                continue;
+            }
+
+            // The stream ends with a whole pair: an odd count starts with the end of a loop
+            if (state.samples.size() % 2 != 0)
+            {
+                state.samples.erase(state.samples.begin());
+            }
+            set_sentinel(state.status, stop - data);
+            out = std::move(state);
+            return true;
+        }
+        return false;
+    }
+
+    bool Parser::load_samples_parallel(std::size_t threads)
+    {
+        auto* mapped = dynamic_cast<MappedFile*>(io_.get());
+        if (mapped == nullptr or mapped->data() == nullptr)
+        {
+            return load_samples();
+        }
+
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        std::size_t const first = static_cast<std::size_t>(seek_data_section());
+        std::size_t const size = mapped->size();
+        if (first >= size or (size - first) / MIN_SEGMENT_SIZE < 2 or threads < 2)
+        {
+            return load_samples();
+        }
+        threads = std::min(threads, (size - first) / MIN_SEGMENT_SIZE);
+        std::size_t const chunk = (size - first) / threads;
+
+        // A segment starts on an element with a known reference: either a summary index block
+        // (the reference is recorded) or an UPDATE_REFERENCE command (the reference is in it).
+        struct Segment
+        {
+            std::size_t begin;
+            std::size_t end;
+            nanoseconds first_sample;   // expected, from the summary index (nanoseconds::min() if unknown)
+            uint8_t const* stop;
+            DecodeState state;
+        };
+
+        uint8_t const* const data = mapped->data();
+        std::vector<Segment> segments;
+        segments.push_back({first, size, nanoseconds::min(), nullptr, {}});
+        if (not metadata_.summary.empty())
+        {
+            for (auto const& block : metadata_.summary)
+            {
+                std::size_t offset = static_cast<std::size_t>(block.offset);
+                if (block.offset < 0 or offset >= size or (offset - first) % sizeof(uint32_t) != 0)
+                {
+                    continue;
+                }
+                if (offset >= first + segments.size() * chunk and segments.size() < threads)
+                {
+                    segments.push_back({offset, size, block.begin - header_.start_time, nullptr, {}});
+                    segments.back().state.reference = block.reference;
+                }
+            }
+        }
+        else
+        {
+            for (std::size_t i = 1; i < threads; ++i)
+            {
+                std::size_t offset = find_reference(data, first, first + i * chunk, first + (i + 1) * chunk, size);
+                if (offset < first + (i + 1) * chunk)
+                {
+                    segments.push_back({offset, size, nanoseconds::min(), nullptr, {}});
+                }
+            }
+        }
+        for (std::size_t i = 1; i < segments.size(); ++i)
+        {
+            segments[i - 1].end = segments[i].begin;
+        }
+
+        auto decode_segment = [&](Segment& segment)
+        {
+            segment.state.samples.reserve((segment.end - segment.begin) / sizeof(uint32_t));
+            segment.stop = decode(data + segment.begin, data + segment.end, header_.start_time, segment.state);
+        };
+
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < segments.size(); ++i)
+        {
+            workers.emplace_back(decode_segment, std::ref(segments[i]));
+        }
+        decode_segment(segments[0]);
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        // Stitch: a segment is kept only if the previous one stopped exactly at its beginning,
+        // otherwise the split was not on an element (or its reference was wrong) and the data
+        // is decoded again from where the previous segment stopped.
+        DecodeState& result = segments[0].state;
+        uint8_t const* pos = segments[0].stop;
+        std::size_t total = 0;
+        for (auto const& segment : segments)
+        {
+            total += segment.state.samples.size();
+        }
+        result.samples.reserve(total);
+
+        for (std::size_t i = 1; i < segments.size() and result.status == DecodeStatus::MORE; ++i)
+        {
+            Segment& next = segments[i];
+            bool valid = (pos == data + next.begin);
+            if (next.first_sample != nanoseconds::min())
+            {
+                valid = valid and not next.state.samples.empty() and next.state.samples.front() == next.first_sample;
+            }
+
+            if (not valid)
+            {
+                pos = decode(pos, data + next.end, header_.start_time, result);
+                continue;
+            }
+
+            result.samples.insert(result.samples.end(), next.state.samples.begin(), next.state.samples.end());
+            result.dropped  += next.state.dropped;
+            result.reference = next.state.reference;
+            result.status    = next.state.status;
+            result.unknown   = next.state.unknown;
+            pos = next.stop;
+        }
+
+        set_sentinel(result.status, pos - data);
+        return store_samples(std::move(result));
+    }
+}
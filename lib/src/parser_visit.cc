@@ -0,0 +1,157 @@
+#include <cstdio>
+#include <cstring>
+
+#include "serializer.h"
+#include "parser.h"
+
+namespace rtm
+{
+    namespace
+    {
+        class LoopVisitor final : public TickVisitor
+        {
+        public:
+            LoopVisitor(std::function<bool(nanoseconds, nanoseconds)> const& on_loop)
+                : on_loop_{on_loop}
+            {
+            }
+
+            bool on_loop(nanoseconds start, nanoseconds end) override
+            {
+                return on_loop_(start, end);
+            }
+
+        private:
+            std::function<bool(nanoseconds, nanoseconds)> const& on_loop_;
+        };
+    }
+
+    bool Parser::visit(std::function<bool(nanoseconds start, nanoseconds end)> const& on_loop)
+    {
+        LoopVisitor visitor{on_loop};
+        return visit(visitor);
+    }
+
+    bool Parser::visit(TickVisitor& visitor)
+    {
+        nanoseconds const start_time = header_.start_time;
+        nanoseconds reference{0};
+        nanoseconds pending{0};
+        bool has_pending = false;
+        bool stopped = false;
+
+        auto on_sample = [&](nanoseconds sample)
+        {
+            if (not has_pending)
+            {
+                pending = sample;
+                has_pending = true;
+                return;
+            }
+            has_pending = false;
+            stopped = not visitor.on_loop(pending, sample);
+        };
+
+        constexpr std::size_t BUFFER_SIZE = 2 << 15; // 64KB;
+        uint8_t buffer[BUFFER_SIZE];
+        std::size_t available_bytes = 0;
+        int64_t file_base = seek_data_section();
+        DecodeStatus status = DecodeStatus::MORE;
+        uint32_t unknown = 0;
+        dropped_ = 0;
+
+        while (status == DecodeStatus::MORE and not stopped)
+        {
+            int64_t newly_read = io_->read(buffer + available_bytes, static_cast<int64_t>(BUFFER_SIZE - available_bytes));
+            if (newly_read <= 0)
+            {
+                break; // truncated stream: the sentinel is missing
+            }
+            available_bytes += static_cast<std::size_t>(newly_read);
+
+            uint8_t const* pos = buffer;
+            uint8_t const* const end = buffer + available_bytes;
+            while (pos + sizeof(uint32_t) <= end and not stopped)
+            {
+                uint32_t word;
+                std::memcpy(&word, pos, sizeof(word));
+                if (not (word & ESCAPE))
+                {
+                    on_sample(nanoseconds(word) + (reference - start_time));
+                    pos += sizeof(uint32_t);
+                    continue;
+                }
+
+                if (word == (ESCAPE | Command::DATA_STREAM_END))
+                {
+                    status = DecodeStatus::END;
+                    break;
+                }
+
+                std::size_t size = element_size(word);
+                if (size == sizeof(uint32_t))
+                {
+                    status = DecodeStatus::ERROR;
+                    unknown = word;
+                    break;
+                }
+                if (pos + size > end)
+                {
+                    break; // the payload is in the next chunk
+                }
+
+                uint8_t const* payload = pos + sizeof(uint32_t);
+                if (word & Command::UPDATE_REFERENCE)
+                {
+                    reference = nanoseconds{extract_data<uint64_t>(payload)};
+                    on_sample(reference - start_time);
+                }
+                else if (word & Command::UPDATE_PERIOD)
+                {
+                    visitor.on_period(nanoseconds{extract_data<uint64_t>(payload)});
+                }
+                else if (word & Command::SET_THRESHOLD)
+                {
+                    visitor.on_threshold(nanoseconds{extract_data<uint64_t>(payload)});
+                }
+                else if (word & Command::DATA_GAP)
+                {
+                    uint64_t dropped = extract_data<uint64_t>(payload);
+                    dropped_ += dropped;
+                    visitor.on_gap(dropped);
+                }
+                else if (word & Command::SET_TRIGGER)
+                {
+                    visitor.on_trigger(extract_data<TriggerRule>(payload));
+                }
+                else if (word & Command::UPDATE_PRIORITY)
+                {
+                    visitor.on_priority(extract_data<int32_t>(payload));
+                }
+                pos += size;
+            }
+
+            // Keep the incomplete element for the next read
+            std::size_t consumed = static_cast<std::size_t>(pos - buffer);
+            file_base += static_cast<int64_t>(consumed);
+            available_bytes -= consumed;
+            std::memmove(buffer, pos, available_bytes);
+        }
+
+        if (stopped)
+        {
+            return false;
+        }
+        if (has_pending)
+        {
+            visitor.on_unfinished(pending);
+        }
+
+        if (status == DecodeStatus::ERROR)
+        {
+            printf("Something wrong happened: command not recognized! (%08x)\n", unknown);
+        }
+        set_sentinel(status, file_base);
+        return true;
+    }
+}
@@ -70,6 +70,12 @@ namespace rtm
         write_command(*io_, Command::SET_THRESHOLD, threshold);
     }
 
+    void Probe::set_trigger(TriggerRule const& rule)
+    {
+        flush();
+        write_command(*io_, Command::SET_TRIGGER, rule);
+    }
+
     void Probe::update_reference(nanoseconds new_ref)
     {
         flush();
@@ -6,6 +6,8 @@
 #include "commands.h"
 #include "parser.h"
 #include "serializer.h"
+#include "summary.h"
+#include "io/async.h"
 #include "io/file.h"
 #include "io/null.h"
 #include "os/time.h"
@@ -14,13 +16,38 @@ namespace rtm
 {
     Recorder::Client::~Client()
     {
-        flush();
+        if (rotating)
+        {
+            write_segments();
+            close_segment();
+        }
+        else
+        {
+            flush();
+        }
+        discard_storage();
+    }
+
+    void Recorder::Client::discard_storage()
+    {
+        journal.remove();
+
+        for (auto& segment : spill_segments)
+        {
+            segment.file.reset();
+            std::error_code ec;
+            std::filesystem::remove(segment.path, ec);
+        }
+        spill_segments.clear();
     }
 
     Recorder::Recorder(std::string_view recording_path,
                        nanoseconds pre_duration,
                        nanoseconds post_duration)
-        : recording_path_{recording_path}
+        : writer_{std::make_shared<IOWorker>()}
+        , metrics_{std::make_shared<RecorderMetrics>()}
+        , retention_{std::make_shared<Retention>(std::string{recording_path})}
+        , recording_path_{recording_path}
         , pre_duration_{std::max(pre_duration, nanoseconds(2s))}
         , post_duration_{std::max(post_duration, nanoseconds(2s))}
     {
@@ -32,14 +59,32 @@ namespace rtm
         if (sink != nullptr)
         {
             sink->write(buffer.data(), static_cast<int64_t>(buffer.size()));
-            sink->sync();
+            sync_sink();
         }
         buffer.clear();
     }
 
+    void Recorder::set_direct_io(bool enable)
+    {
+        direct_io_ = enable;
+    }
+
+    access::Mode Recorder::sink_mode() const
+    {
+        access::Mode mode = access::Mode::WRITE_ONLY | access::Mode::TRUNCATE;
+        if (direct_io_)
+        {
+            mode |= access::Mode::DIRECT;
+        }
+        return mode;
+    }
+
     void Recorder::add_client(std::unique_ptr<AbstractIO>&& io)
     {
         Client client;
+        client.id = next_client_id_++;
+        client.metrics = metrics_;
+        client.retention = retention_;
         client.io = std::move(io);
         client.sink = nullptr;
         client.buffer.reserve(4096);
@@ -48,6 +93,77 @@ namespace rtm
         printf("[Recorder] New client\n");
     }
 
+    void Recorder::push_ring(Client& client, Chunk&& chunk)
+    {
+        if (chunk.data.size() >= sizeof(uint32_t))
+        {
+            uint32_t first_word;
+            std::memcpy(&first_word, chunk.data.data(), sizeof(first_word));
+            chunk.leading_reference = (first_word == (ESCAPE | Command::UPDATE_REFERENCE));
+        }
+
+        if (client.journal.is_open())
+        {
+            uint32_t flags = 0;
+            if (chunk.leading_reference)
+            {
+                flags |= Journal::LEADING_REFERENCE;
+            }
+            if ((client.sample_parity + chunk.sample_count) % 2 == 0)
+            {
+                flags |= Journal::PAIR_ALIGNED;
+            }
+            client.journal.set_stream_state(client.current_period, client.current_priority);
+            client.journal.append(chunk.entry_reference, chunk.first_sample_time, chunk.sample_count, flags,
+                                  chunk.data.data(), chunk.data.size());
+        }
+
+        client.ring_sample_count += chunk.sample_count;
+        client.ring_ram_bytes += chunk.data.size();
+        client.ring.push_back(std::move(chunk));
+    }
+
+    void Recorder::pop_ring(Client& client)
+    {
+        Chunk const& front = client.ring.front();
+        client.ring_sample_count -= front.sample_count;
+
+        // The journal holds the newest chunks of the ring
+        if (client.journal.records() >= client.ring.size())
+        {
+            client.journal.drop_oldest();
+        }
+
+        if (front.spill_offset < 0)
+        {
+            client.ring_ram_bytes -= front.data.size();
+            client.ring.pop_front();
+            return;
+        }
+
+        client.ring_spilled_chunks--;
+        client.ring_spilled_bytes -= front.spill_size;
+        for (auto& segment : client.spill_segments)
+        {
+            if (segment.id == front.spill_segment)
+            {
+                segment.live_chunks--;
+                break;
+            }
+        }
+        client.ring.pop_front();
+
+        // Chunks are spilled and evicted in order: dead segments are always at the front
+        while (not client.spill_segments.empty() and client.spill_segments.front().live_chunks == 0)
+        {
+            auto& segment = client.spill_segments.front();
+            segment.file.reset();
+            std::error_code ec;
+            std::filesystem::remove(segment.path, ec);
+            client.spill_segments.pop_front();
+        }
+    }
+
     void Recorder::evict_ring(Client& client)
     {
         nanoseconds cutoff = client.prev_start_absolute - pre_duration_;
@@ -64,25 +180,22 @@ namespace rtm
                     break;
                 }
 
-                uint32_t next_count = client.ring[1].sample_count;
-                client.ring_sample_count -= (front_count + next_count);
-                client.ring.pop_front();
-                client.ring.pop_front();
+                pop_ring(client);
+                pop_ring(client);
             }
             else
             {
-                client.ring_sample_count -= front_count;
-                client.ring.pop_front();
+                pop_ring(client);
             }
         }
     }
 
 
-    void Recorder::trigger_recording(Client& client, nanoseconds trigger_absolute)
+    std::string Recorder::trigger_recording(Client& client, nanoseconds trigger_absolute, std::string const& directory)
     {
         long trigger_s = std::chrono::duration_cast<std::chrono::seconds>(trigger_absolute).count();
 
-        std::string path = recording_path_ + '/';
+        std::string path = directory + '/';
         path += format_iso_timestamp(client.start_time);
         path += '_';
         path += client.process_name;
@@ -91,11 +204,11 @@ namespace rtm
         path += '_';
         path += std::to_string(trigger_s) + 's';
         path += ".tick";
-        printf("[Recorder] Blackbox trigger %ldns @ %lds! Writing %s\n",
-               static_cast<long>(client.detected_jitter.count()), trigger_s, path.c_str());
 
-        client.sink = std::make_unique<File>(path);
-        client.sink->open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE);
+        // The dump is handed to the background writer: a burst of triggers
+        // must not stall the ingestion of the other clients.
+        auto sink = std::make_unique<AsyncIO>(retention_->track(path, std::make_unique<SummaryIO>(std::make_unique<File>(path), path)), writer_);
+        sink->open(sink_mode());
 
         // Rebuild header with a unique task name so the GUI can distinguish files
         std::string unique_task = client.source_name + "@" + std::to_string(trigger_s) + "s";
@@ -103,13 +216,10 @@ namespace rtm
             std::array<uint8_t, 16> uuid;
             std::memcpy(uuid.data(), client.header_bytes.data() + 16, uuid.size());
 
-            std::vector<uint8_t> header = build_tick_header(
-                uuid, client.start_time, client.process_name, unique_task);
-
-            client.sink->write(header.data(), static_cast<int64_t>(header.size()));
+            sink->write(build_tick_header(uuid, client.start_time, client.process_name, unique_task));
         }
-        write_command(*client.sink, Command::UPDATE_PERIOD, client.current_period);
-        write_command(*client.sink, Command::UPDATE_PRIORITY, client.current_priority);
+        write_command(*sink, Command::UPDATE_PERIOD, client.current_period);
+        write_command(*sink, Command::UPDATE_PRIORITY, client.current_priority);
 
         // Skip ring chunks until we find one starting with UPDATE_REFERENCE.
         // Chunks split at reference boundaries are self-contained; earlier chunks
@@ -117,39 +227,28 @@ namespace rtm
         std::size_t start_idx = client.ring.size();
         for (std::size_t i = 0; i < client.ring.size(); ++i)
         {
-            if (client.ring[i].data.size() >= sizeof(uint32_t))
+            if (client.ring[i].leading_reference)
             {
-                uint32_t first_word;
-                std::memcpy(&first_word, client.ring[i].data.data(), sizeof(first_word));
-                if (first_word == (ESCAPE | Command::UPDATE_REFERENCE))
-                {
-                    start_idx = i;
-                    break;
-                }
+                start_idx = i;
+                break;
             }
         }
 
         if (start_idx == client.ring.size() and not client.ring.empty())
         {
-            write_command(*client.sink, Command::UPDATE_REFERENCE, client.ring.front().entry_reference);
+            write_command(*sink, Command::UPDATE_REFERENCE, client.ring.front().entry_reference);
             uint32_t zero_delta = 0;
-            client.sink->write(&zero_delta, sizeof(zero_delta));
+            sink->write(&zero_delta, sizeof(zero_delta));
             start_idx = 0;
         }
 
-        for (std::size_t i = start_idx; i < client.ring.size(); ++i)
-        {
-            if (not client.ring[i].data.empty())
-            {
-                client.sink->write(client.ring[i].data.data(), static_cast<int64_t>(client.ring[i].data.size()));
-            }
-        }
-
-        client.ring.clear();
-        client.ring_sample_count = 0;
+        hand_over_ring(client, *sink, start_idx);
+        client.sink = std::move(sink);
 
         client.mode = Mode::RECORDING;
         client.recording_deadline = trigger_absolute + post_duration_;
+
+        return path;
     }
 
     void Recorder::stop_recording(Client& client)
@@ -161,7 +260,7 @@ namespace rtm
         {
             uint32_t sentinel = ESCAPE | Command::DATA_STREAM_END;
             client.sink->write(&sentinel, sizeof(sentinel));
-            client.sink->sync();
+            client.sync_sink();
             client.sink.reset();
         }
 
@@ -196,12 +295,25 @@ namespace rtm
             current_chunk.sample_count++;
 
             client.sample_parity = 0;
-            client.pending_trigger = false;
 
-            client.ring_sample_count += current_chunk.sample_count;
-            client.ring.push_back(std::move(current_chunk));
+            push_ring(client, std::move(current_chunk));
 
-            trigger_recording(client, absolute);
+            // Once per trigger: the peers dumped by an incident did not fire
+            metrics_->triggers.fetch_add(1, std::memory_order_relaxed);
+            client.counters->triggers.fetch_add(1, std::memory_order_relaxed);
+
+            if (correlated_trigger_)
+            {
+                trigger_incident(client, absolute);
+            }
+            else
+            {
+                std::string path = trigger_recording(client, absolute, recording_path_);
+                printf("[Recorder] Blackbox trigger %ldns (%s) @ %lds! Writing %s\n",
+                       static_cast<long>(client.trigger_measure.count()), client.trigger_condition.c_str(),
+                       static_cast<long>(std::chrono::duration_cast<std::chrono::seconds>(absolute).count()),
+                       path.c_str());
+            }
 
             current_chunk = Chunk{};
             current_chunk.entry_reference = client.current_reference;
@@ -212,29 +324,35 @@ namespace rtm
         {
             if (client.sample_parity == 0)
             {
-                if (client.has_prev_start and client.threshold.count() > 0)
-                {
-                    nanoseconds jitter = absolute - client.prev_start_absolute;
-                    if (jitter > client.threshold)
-                    {
-                        client.pending_trigger = true;
-                        client.detected_jitter = jitter;
-                    }
-                }
+                client.previous_loop_start = client.prev_start_absolute;
+                client.has_previous_loop = client.has_prev_start;
                 client.prev_start_absolute = absolute;
                 client.has_prev_start = true;
             }
-            else if (client.pending_trigger)
+            else
             {
-                if (client.mode == Mode::BUFFERING)
-                {
-                    fire_trigger(absolute, elem_start, elem_end);
-                    return true;
-                }
-                else if (client.mode == Mode::RECORDING)
+                // The loop is complete: run the trigger checks on it
+                LoopTiming loop;
+                loop.start = client.prev_start_absolute;
+                loop.end = absolute;
+                loop.previous_start = client.previous_loop_start;
+                loop.has_previous = client.has_previous_loop;
+                loop.period = client.current_period;
+
+                TriggerCheck const* fired = client.triggers.on_loop(loop);
+                if (fired != nullptr)
                 {
-                    client.recording_deadline = absolute + post_duration_;
-                    client.pending_trigger = false;
+                    client.trigger_measure = fired->measured();
+                    if (client.mode == Mode::BUFFERING)
+                    {
+                        client.trigger_condition = fired->describe();
+                        fire_trigger(absolute, elem_start, elem_end);
+                        return true;
+                    }
+                    else if (client.mode == Mode::RECORDING)
+                    {
+                        client.recording_deadline = absolute + post_duration_;
+                    }
                 }
             }
 
@@ -249,10 +367,7 @@ namespace rtm
 
             if (client.mode == Mode::RECORDING and client.sample_parity == 0 and absolute >= client.recording_deadline)
             {
-                if (client.sink != nullptr)
-                {
-                    client.sink->sync();
-                }
+                client.sync_sink();
                 stop_recording(client);
                 current_chunk = Chunk{};
                 current_chunk.entry_reference = client.current_reference;
@@ -285,6 +400,18 @@ namespace rtm
                         break;
                     }
                     client.threshold = nanoseconds(extract_data<uint64_t>(pos));
+                    client.triggers.set({TriggerKind::JITTER, 0, 0, static_cast<uint64_t>(client.threshold.count())});
+                    continue;
+                }
+
+                if (raw & Command::SET_TRIGGER)
+                {
+                    if (pos + sizeof(TriggerRule) > buf_end)
+                    {
+                        pos = elem_start;
+                        break;
+                    }
+                    set_client_trigger(client, extract_data<TriggerRule>(pos));
                     continue;
                 }
 
@@ -300,8 +427,7 @@ namespace rtm
                     // Split chunk at reference boundaries so each chunk is self-contained
                     if (client.mode == Mode::BUFFERING and current_chunk.sample_count > 0)
                     {
-                        client.ring_sample_count += current_chunk.sample_count;
-                        client.ring.push_back(std::move(current_chunk));
+                        push_ring(client, std::move(current_chunk));
                         evict_ring(client);
                         current_chunk = Chunk{};
                         current_chunk.sample_count = 0;
@@ -337,6 +463,21 @@ namespace rtm
                     continue;
                 }
 
+                if (raw & Command::DATA_GAP)
+                {
+                    if (pos + sizeof(uint64_t) > buf_end)
+                    {
+                        pos = elem_start;
+                        break;
+                    }
+                    pos += sizeof(uint64_t);
+
+                    // The samples lost in between are not jitter
+                    client.has_prev_start = false;
+                    route(elem_start, static_cast<std::size_t>(pos - elem_start));
+                    continue;
+                }
+
                 route(elem_start, static_cast<std::size_t>(pos - elem_start));
                 continue;
             }
@@ -350,14 +491,13 @@ namespace rtm
 
         if (client.mode == Mode::BUFFERING and not current_chunk.data.empty())
         {
-            client.ring_sample_count += current_chunk.sample_count;
-            client.ring.push_back(std::move(current_chunk));
+            push_ring(client, std::move(current_chunk));
             evict_ring(client);
         }
 
-        if (client.mode == Mode::RECORDING and client.sink != nullptr)
+        if (client.mode == Mode::RECORDING)
         {
-            client.sink->sync();
+            client.sync_sink();
         }
 
         return end_of_stream;
@@ -367,6 +507,11 @@ namespace rtm
     {
         for (auto& client : clients_)
         {
+            if (client.splice_pipe.is_open() and splice_data(client))
+            {
+                continue;
+            }
+
             uint8_t read_buf[2048];
             int64_t bytes_read = client.io->read(read_buf, sizeof(read_buf));
 
@@ -390,6 +535,11 @@ namespace rtm
                     parse_blackbox_data(client);
                     stop_recording(client);
                 }
+                else if (client.mode == Mode::NORMAL and client.rotating)
+                {
+                    client.write_segments();
+                    client.close_segment();
+                }
                 else if (client.mode == Mode::NORMAL)
                 {
                     client.flush();
@@ -397,7 +547,7 @@ namespace rtm
                     {
                         uint32_t sentinel = ESCAPE | Command::DATA_STREAM_END;
                         client.sink->write(&sentinel, sizeof(sentinel));
-                        client.sink->sync();
+                        client.sync_sink();
                     }
                 }
 
@@ -407,6 +557,21 @@ namespace rtm
             else
             {
                 client.buffer.insert(client.buffer.end(), read_buf, read_buf + bytes_read);
+                metrics_->bytes.fetch_add(static_cast<uint64_t>(bytes_read), std::memory_order_relaxed);
+                if (client.unwritten_since == 0ns and client.mode != Mode::BUFFERING)
+                {
+                    client.unwritten_since = since_epoch();
+                }
+
+                if (not client.header_bytes.empty())
+                {
+                    client.counters->bytes.fetch_add(static_cast<uint64_t>(bytes_read), std::memory_order_relaxed);
+                    count_samples(client, read_buf, static_cast<std::size_t>(bytes_read));
+                    if (fanout_enabled_)
+                    {
+                        publish_data(client, read_buf, static_cast<std::size_t>(bytes_read));
+                    }
+                }
             }
 
             // --- Header parsing ---
@@ -440,6 +605,16 @@ namespace rtm
                 client.buffer.erase(client.buffer.begin(), header_end);
 
                 printf("[Recorder] Header parsed: %s_%s\n", client.process_name.c_str(), client.source_name.c_str());
+
+                client.counters = metrics_->add_client(client.id, client.process_name, client.source_name);
+                client.counters->bytes.store(header_total + client.buffer.size(), std::memory_order_relaxed);
+                count_samples(client, client.buffer.data(), client.buffer.size());
+
+                if (fanout_enabled_)
+                {
+                    publish_begin(client);
+                    publish_data(client, client.buffer.data(), client.buffer.size());
+                }
             }
 
             if (client.header_bytes.empty())
@@ -447,6 +622,12 @@ namespace rtm
                 continue;
             }
 
+            if (relay_ != nullptr)
+            {
+                relay_data(client);
+                continue;
+            }
+
             // --- Mode decision (PENDING -> NORMAL or BUFFERING) ---
             if (client.mode == Mode::PENDING)
             {
@@ -480,6 +661,18 @@ namespace rtm
                         }
                         pos += 4;
                         client.threshold = nanoseconds(extract_data<uint64_t>(pos));
+                        client.triggers.set({TriggerKind::JITTER, 0, 0, static_cast<uint64_t>(client.threshold.count())});
+                        continue;
+                    }
+
+                    if (raw & Command::SET_TRIGGER)
+                    {
+                        if (pos + 4 + sizeof(TriggerRule) > buf_end)
+                        {
+                            break;
+                        }
+                        pos += 4;
+                        set_client_trigger(client, extract_data<TriggerRule>(pos));
                         continue;
                     }
 
@@ -517,12 +710,26 @@ namespace rtm
                     continue;
                 }
 
-                if (client.threshold.count() > 0)
+                if (not client.triggers.empty())
                 {
+                    for (auto const& rule : trigger_rules_)
+                    {
+                        if (not client.triggers.has(rule.kind))
+                        {
+                            client.triggers.set(rule);
+                        }
+                    }
+
                     client.mode = Mode::BUFFERING;
-                    printf("[Recorder] Blackbox mode: %s_%s (threshold: %ld ns)\n",
+                    client.unwritten_since = 0ns;
+                    printf("[Recorder] Blackbox mode: %s_%s (threshold: %ld ns, %zu trigger rule(s))\n",
                            client.process_name.c_str(), client.source_name.c_str(),
-                           static_cast<long>(client.threshold.count()));
+                           static_cast<long>(client.threshold.count()), client.triggers.size());
+
+                    if (not journal_path_.empty())
+                    {
+                        open_journal(client);
+                    }
                 }
                 else
                 {
@@ -550,22 +757,44 @@ namespace rtm
                     else
                     {
                         client.name = file_name;
-                        client.sink = std::make_unique<File>(client.name);
+                        client.rotating = (rotation_size_ > 0 or rotation_interval_ > 0ns);
+                        client.rotation_size = rotation_size_;
+                        client.rotation_interval = rotation_interval_;
+                        client.segment_mode = sink_mode();
+                        if (not client.rotating)
+                        {
+                            client.sink = retention_->track(client.name, std::make_unique<SummaryIO>(std::make_unique<File>(client.name), client.name));
+                        }
                     }
 
-                    client.sink->open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE);
+                    if (client.rotating)
+                    {
+                        client.open_segment();
+                    }
+                    else
+                    {
+                        client.sink->open(sink_mode());
 
-                    client.sink->write(client.header_bytes.data(), static_cast<int64_t>(client.header_bytes.size()));
+                        client.sink->write(client.header_bytes.data(), static_cast<int64_t>(client.header_bytes.size()));
 
-                    write_command(*client.sink, Command::UPDATE_PERIOD, client.current_period);
-                    write_command(*client.sink, Command::UPDATE_PRIORITY, client.current_priority);
+                        write_command(*client.sink, Command::UPDATE_PERIOD, client.current_period);
+                        write_command(*client.sink, Command::UPDATE_PRIORITY, client.current_priority);
 
-                    client.flush();
+                        client.flush();
+                        start_splice(client);
+                    }
                 }
             }
 
             // --- Per-mode data handling ---
-            if (client.mode == Mode::NORMAL and client.sink != nullptr)
+            if (client.mode == Mode::NORMAL and client.rotating)
+            {
+                if (client.buffer.size() > 2048)
+                {
+                    client.write_segments();
+                }
+            }
+            else if (client.mode == Mode::NORMAL and client.sink != nullptr)
             {
                 if (client.buffer.size() > 2048)
                 {
@@ -585,7 +814,35 @@ namespace rtm
             }
         }
 
+        // Moving clients around does not delete files: do it before the erase
+        for (auto& client : clients_)
+        {
+            if (client.io == nullptr)
+            {
+                client.relay.reset(); // ends the upstream stream
+                publish_end(client);
+                client.discard_storage();
+                if (client.counters != nullptr)
+                {
+                    metrics_->remove_client(client.counters);
+                }
+            }
+            else if (client.counters != nullptr)
+            {
+                client.counters->backlog_bytes.store(client.buffer.size(), std::memory_order_relaxed);
+                client.counters->ring_bytes.store(client.ring_ram_bytes + client.ring_spilled_bytes, std::memory_order_relaxed);
+            }
+        }
+
         clients_.erase(std::remove_if(clients_.begin(), clients_.end(),
             [](Client const& client) { return client.io == nullptr; }), clients_.end());
+
+        enforce_memory_budget();
+        enforce_quota();
+        flush_subscribers();
+        if (relay_ != nullptr)
+        {
+            relay_->flush();
+        }
     }
 }
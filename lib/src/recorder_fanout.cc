@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "recorder.h"
+#include "commands.h"
+#include "fanout.h"
+#include "serializer.h"
+
+namespace rtm
+{
+    namespace
+    {
+        void write_frame_header(std::vector<uint8_t>& frame, uint32_t client_id, fanout::FrameType type)
+        {
+            fanout::FrameHeader header{};
+            header.client_id = client_id;
+            header.type = type;
+            header.size = static_cast<uint32_t>(frame.size() - sizeof(fanout::FrameHeader));
+            std::memcpy(frame.data(), &header, sizeof(header));
+        }
+    }
+
+    void Recorder::enable_fanout()
+    {
+        fanout_enabled_ = true;
+    }
+
+    void Recorder::add_subscriber(std::unique_ptr<AbstractIO>&& io)
+    {
+        enable_fanout();
+
+        subscribers_.emplace_back();
+        subscribers_.back().io = std::move(io);
+        printf("[Recorder] New subscriber\n");
+
+        // Announce the clients already streaming to the newcomer only. Its first data must start
+        // on a pair: a client in the middle of one is announced at its next start sample.
+        auto& subscriber = subscribers_.back();
+        for (auto& client : clients_)
+        {
+            if (not client.fanout_synced)
+            {
+                continue;
+            }
+            if (client.fanout.parity == 0)
+            {
+                enqueue(subscriber, make_begin_frame(client, client.fanout));
+            }
+            else
+            {
+                subscriber.pending.push_back(client.id);
+            }
+        }
+    }
+
+    bool Recorder::Subscriber::is_pending(uint64_t client_id) const
+    {
+        return std::find(pending.begin(), pending.end(), client_id) != pending.end();
+    }
+
+    Recorder::Frame Recorder::make_begin_frame(Client const& client, FanoutState const& state)
+    {
+        std::vector<uint8_t> frame(sizeof(fanout::FrameHeader));
+        append(frame, static_cast<uint64_t>(state.reference.count()));
+        frame.insert(frame.end(), client.header_bytes.begin(), client.header_bytes.end());
+        append(frame, ESCAPE | Command::UPDATE_PERIOD);
+        append(frame, static_cast<uint64_t>(state.period.count()));
+        append(frame, ESCAPE | Command::UPDATE_PRIORITY);
+        append(frame, state.priority);
+        write_frame_header(frame, static_cast<uint32_t>(client.id), fanout::CLIENT_BEGIN);
+
+        return std::make_shared<std::vector<uint8_t> const>(std::move(frame));
+    }
+
+    void Recorder::enqueue(Subscriber& subscriber, Frame const& frame)
+    {
+        if (subscriber.io == nullptr)
+        {
+            return;
+        }
+
+        if (subscriber.backlog + frame->size() > SUBSCRIBER_BACKLOG)
+        {
+            // Never block the ingestion for a subscriber
+            printf("[Recorder] Subscriber too slow (%zu bytes behind): dropped\n", subscriber.backlog);
+            subscriber.io.reset();
+            metrics_->subscribers_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        subscriber.backlog += frame->size();
+        subscriber.queue.push_back(frame);
+    }
+
+    void Recorder::publish(Frame const& frame, uint64_t client_id)
+    {
+        for (auto& subscriber : subscribers_)
+        {
+            if (not subscriber.is_pending(client_id))
+            {
+                enqueue(subscriber, frame);
+            }
+        }
+    }
+
+    void Recorder::publish_begin(Client& client)
+    {
+        client.fanout_synced = true;
+        if (subscribers_.empty())
+        {
+            return;
+        }
+
+        publish(make_begin_frame(client, client.fanout), client.id);
+    }
+
+    void Recorder::publish_data(Client& client, uint8_t const* data, std::size_t size)
+    {
+        if (not client.fanout_synced)
+        {
+            return;
+        }
+
+        // The stream is followed even without subscribers: a newcomer must start on an element
+        bool const publishing = not subscribers_.empty();
+        std::vector<uint8_t> frame;
+        if (publishing)
+        {
+            frame.reserve(sizeof(fanout::FrameHeader) + client.fanout_tail.size() + size);
+            frame.resize(sizeof(fanout::FrameHeader));
+        }
+
+        auto& state = client.fanout;
+        auto follow = [&state](uint8_t const* element)
+        {
+            uint32_t word;
+            std::memcpy(&word, element, sizeof(word));
+            if (not (word & ESCAPE))
+            {
+                state.parity ^= 1;
+                return;
+            }
+
+            uint8_t const* payload = element + sizeof(word);
+            if (word & Command::UPDATE_REFERENCE)
+            {
+                state.reference = nanoseconds(extract_data<uint64_t>(payload));
+                state.parity ^= 1; // the reference is a sample too
+            }
+            else if (word & Command::UPDATE_PERIOD)
+            {
+                state.period = nanoseconds(extract_data<uint64_t>(payload));
+            }
+            else if (word & Command::UPDATE_PRIORITY)
+            {
+                state.priority = extract_data<int32_t>(payload);
+            }
+        };
+
+        // First pair boundary of the frame (offset and state there), for the pending subscribers
+        bool synced = false;
+        std::size_t sync_offset = 0;
+        FanoutState sync_state{};
+        auto mark = [&](std::size_t offset)
+        {
+            if (not synced and state.parity == 0)
+            {
+                synced = true;
+                sync_offset = offset;
+                sync_state = state;
+            }
+        };
+        mark(sizeof(fanout::FrameHeader));
+
+        // Complete the element left over by the previous read
+        std::size_t used = 0;
+        auto& tail = client.fanout_tail;
+        if (not tail.empty())
+        {
+            while (tail.size() < sizeof(uint32_t) and used < size)
+            {
+                tail.push_back(data[used++]);
+            }
+            if (tail.size() < sizeof(uint32_t))
+            {
+                return;
+            }
+
+            uint32_t word;
+            std::memcpy(&word, tail.data(), sizeof(word));
+            std::size_t missing = std::min(element_size(word) - tail.size(), size - used);
+            tail.insert(tail.end(), data + used, data + used + missing);
+            used += missing;
+            if (tail.size() < element_size(word))
+            {
+                return;
+            }
+
+            follow(tail.data());
+            if (publishing)
+            {
+                frame.insert(frame.end(), tail.begin(), tail.end());
+            }
+            mark(sizeof(fanout::FrameHeader) + tail.size());
+            tail.clear();
+        }
+
+        std::size_t const data_offset = publishing ? frame.size() : sizeof(fanout::FrameHeader);
+        uint8_t const* begin = data + used;
+        uint8_t const* pos = begin;
+        uint8_t const* const end = data + size;
+        while (pos + sizeof(uint32_t) <= end)
+        {
+            uint32_t word;
+            std::memcpy(&word, pos, sizeof(word));
+            std::size_t elem_size = element_size(word);
+            if (pos + elem_size > end)
+            {
+                break;
+            }
+
+            follow(pos);
+            pos += elem_size;
+            mark(data_offset + static_cast<std::size_t>(pos - begin));
+        }
+        tail.assign(pos, end);
+
+        if (not publishing)
+        {
+            return;
+        }
+
+        frame.insert(frame.end(), begin, pos);
+        if (synced)
+        {
+            // Pending subscribers get the stream from the pair boundary on
+            for (auto& subscriber : subscribers_)
+            {
+                if (not subscriber.is_pending(client.id))
+                {
+                    continue;
+                }
+                subscriber.pending.erase(std::find(subscriber.pending.begin(), subscriber.pending.end(), client.id));
+
+                enqueue(subscriber, make_begin_frame(client, sync_state));
+                if (sync_offset < frame.size())
+                {
+                    std::vector<uint8_t> rest(sizeof(fanout::FrameHeader));
+                    rest.insert(rest.end(), frame.begin() + static_cast<std::ptrdiff_t>(sync_offset), frame.end());
+                    write_frame_header(rest, static_cast<uint32_t>(client.id), fanout::CLIENT_DATA);
+                    enqueue(subscriber, std::make_shared<std::vector<uint8_t> const>(std::move(rest)));
+                }
+            }
+        }
+
+        if (frame.size() > sizeof(fanout::FrameHeader))
+        {
+            write_frame_header(frame, static_cast<uint32_t>(client.id), fanout::CLIENT_DATA);
+            publish(std::make_shared<std::vector<uint8_t> const>(std::move(frame)), client.id);
+        }
+    }
+
+    void Recorder::publish_end(Client& client)
+    {
+        if (not client.fanout_synced)
+        {
+            return;
+        }
+        client.fanout_synced = false;
+
+        if (subscribers_.empty())
+        {
+            return;
+        }
+
+        std::vector<uint8_t> frame(sizeof(fanout::FrameHeader));
+        write_frame_header(frame, static_cast<uint32_t>(client.id), fanout::CLIENT_END);
+        publish(std::make_shared<std::vector<uint8_t> const>(std::move(frame)), client.id);
+
+        // Never announced to them: nothing to end
+        for (auto& subscriber : subscribers_)
+        {
+            subscriber.pending.erase(std::remove(subscriber.pending.begin(), subscriber.pending.end(), client.id),
+                                     subscriber.pending.end());
+        }
+    }
+
+    void Recorder::flush_subscribers()
+    {
+        for (auto& subscriber : subscribers_)
+        {
+            while (subscriber.io != nullptr and not subscriber.queue.empty())
+            {
+                auto const& frame = *subscriber.queue.front();
+                int64_t written = subscriber.io->write(frame.data() + subscriber.sent,
+                                                       static_cast<int64_t>(frame.size() - subscriber.sent));
+                if (written < 0)
+                {
+                    if (errno != EAGAIN)
+                    {
+                        printf("[Recorder] Subscriber disconnected\n");
+                        subscriber.io.reset();
+                    }
+                    break;
+                }
+
+                subscriber.sent += static_cast<std::size_t>(written);
+                if (subscriber.sent == frame.size())
+                {
+                    subscriber.backlog -= frame.size();
+                    subscriber.sent = 0;
+                    subscriber.queue.pop_front();
+                }
+            }
+        }
+
+        subscribers_.erase(std::remove_if(subscribers_.begin(), subscribers_.end(),
+            [](Subscriber const& subscriber) { return subscriber.io == nullptr; }), subscribers_.end());
+    }
+}
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+#include "recorder.h"
+#include "io/async.h"
+#include "io/file.h"
+#include "os/time.h"
+
+namespace rtm
+{
+    void Recorder::set_correlated_trigger(bool enable)
+    {
+        correlated_trigger_ = enable;
+    }
+
+    bool Recorder::add_trigger(TriggerRule const& rule)
+    {
+        if (make_trigger_check(rule) == nullptr)
+        {
+            return false;
+        }
+        trigger_rules_.push_back(rule);
+        return true;
+    }
+
+    void Recorder::set_client_trigger(Client& client, TriggerRule const& rule)
+    {
+        if (not client.triggers.set(rule))
+        {
+            printf("[Recorder] %s_%s: invalid trigger rule (kind %u) ignored\n",
+                   client.process_name.c_str(), client.source_name.c_str(), static_cast<unsigned>(rule.kind));
+        }
+    }
+
+    void Recorder::trigger_incident(Client& client, nanoseconds trigger_absolute)
+    {
+        // Clients have their own start time: the incident window is expressed in wall-clock time.
+        nanoseconds trigger_time = client.start_time + trigger_absolute;
+
+        std::string const base = recording_path_ + "/incident_" + format_iso_timestamp(trigger_time);
+        std::string directory = base;
+        for (int i = 1; std::filesystem::exists(directory); ++i)
+        {
+            directory = base + '_' + std::to_string(i);
+        }
+
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+        if (ec)
+        {
+            printf("[Recorder] Cannot create incident directory %s: %s\n", directory.c_str(), ec.message().c_str());
+            trigger_recording(client, trigger_absolute, recording_path_);
+            return;
+        }
+
+        printf("[Recorder] Blackbox trigger %ldns (%s) on %s_%s! Writing incident %s\n",
+               static_cast<long>(client.trigger_measure.count()), client.trigger_condition.c_str(),
+               client.process_name.c_str(), client.source_name.c_str(), directory.c_str());
+
+        std::string manifest;
+        manifest += "trigger_time=" + format_iso_timestamp(trigger_time) + '\n';
+        manifest += "trigger_time_ns=" + std::to_string(trigger_time.count()) + '\n';
+        manifest += "trigger_client=" + client.process_name + '_' + client.source_name + '\n';
+        manifest += "trigger_condition=" + client.trigger_condition + '\n';
+        manifest += "trigger_measure_ns=" + std::to_string(client.trigger_measure.count()) + '\n';
+        manifest += "pre_duration_ns=" + std::to_string(pre_duration_.count()) + '\n';
+        manifest += "post_duration_ns=" + std::to_string(post_duration_.count()) + '\n';
+
+        auto add_file = [&](std::string const& path)
+        {
+            manifest += "file=" + std::filesystem::path(path).filename().string() + '\n';
+        };
+
+        add_file(trigger_recording(client, trigger_absolute, directory));
+
+        for (auto& peer : clients_)
+        {
+            if (&peer == &client or peer.io == nullptr)
+            {
+                continue;
+            }
+
+            nanoseconds peer_deadline = trigger_time - peer.start_time + post_duration_;
+            if (peer.mode == Mode::RECORDING)
+            {
+                // Already dumping for a previous incident: cover this one too.
+                peer.recording_deadline = std::max(peer.recording_deadline, peer_deadline);
+                continue;
+            }
+
+            if (peer.mode != Mode::BUFFERING)
+            {
+                continue;
+            }
+
+            add_file(trigger_recording(peer, trigger_time - peer.start_time, directory));
+        }
+
+        auto sink = std::make_unique<AsyncIO>(std::make_unique<File>(directory + "/incident.manifest"), writer_);
+        sink->open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE);
+        sink->write(manifest.data(), static_cast<int64_t>(manifest.size()));
+    }
+}
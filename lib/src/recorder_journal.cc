@@ -0,0 +1,62 @@
+#include <cstdio>
+#include <filesystem>
+
+#include "recorder.h"
+#include "os/time.h"
+
+namespace rtm
+{
+    void Recorder::set_journal(std::string_view journal_path, std::size_t capacity)
+    {
+        journal_path_ = journal_path;
+        journal_capacity_ = capacity;
+
+        std::error_code ec;
+        std::filesystem::create_directories(journal_path_, ec);
+        if (ec)
+        {
+            printf("[Recorder] Cannot create journal directory %s: %s\n", journal_path_.c_str(), ec.message().c_str());
+            journal_path_.clear();
+            return;
+        }
+
+        // Journals still there belong to a recorder that did not shut down cleanly
+        for (auto const& entry : std::filesystem::directory_iterator(journal_path_, ec))
+        {
+            if (entry.path().extension() != Journal::EXTENSION)
+            {
+                continue;
+            }
+
+            std::string tick_path;
+            auto rc = recover_journal(entry.path().string(), recording_path_, tick_path);
+            if (rc)
+            {
+                printf("[Recorder] Cannot recover journal %s: %s\n", entry.path().c_str(), rc.message().c_str());
+                continue;
+            }
+
+            printf("[Recorder] Recovered journal %s into %s\n", entry.path().c_str(), tick_path.c_str());
+            std::filesystem::remove(entry.path(), ec);
+        }
+    }
+
+    void Recorder::open_journal(Client& client)
+    {
+        std::string path = journal_path_ + '/';
+        path += format_iso_timestamp(client.start_time);
+        path += '_';
+        path += client.process_name;
+        path += '_';
+        path += client.source_name;
+        path += '_';
+        path += std::to_string(client.id);
+        path += Journal::EXTENSION;
+
+        auto rc = client.journal.create(path, client.header_bytes, journal_capacity_);
+        if (rc)
+        {
+            printf("[Recorder] Cannot create journal %s: %s\n", path.c_str(), rc.message().c_str());
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#include <cstring>
+
+#include "recorder.h"
+#include "commands.h"
+#include "io/async.h"
+
+namespace rtm
+{
+    void Recorder::Client::sync_sink()
+    {
+        if (sink == nullptr)
+        {
+            return;
+        }
+
+        nanoseconds received = unwritten_since;
+        unwritten_since = 0ns;
+
+        auto timed_sync = [metrics = metrics, received](AbstractIO& target)
+        {
+            nanoseconds begin = since_epoch();
+            target.sync();
+            nanoseconds end = since_epoch();
+
+            if (metrics != nullptr)
+            {
+                metrics->sync_latency.record(end - begin);
+                if (received > 0ns)
+                {
+                    metrics->write_latency.record(end - received);
+                }
+            }
+        };
+
+        // Blackbox dumps are synced by the background writer: time the real fsync, not the post
+        if (auto* async = dynamic_cast<AsyncIO*>(sink.get()))
+        {
+            async->post(std::move(timed_sync));
+            return;
+        }
+        timed_sync(*sink);
+    }
+
+    void Recorder::count_samples(Client& client, uint8_t const* data, std::size_t size)
+    {
+        uint64_t samples = 0;
+        auto count = [&samples](uint32_t word)
+        {
+            if (not (word & ESCAPE) or (word & Command::UPDATE_REFERENCE))
+            {
+                samples++;
+            }
+        };
+
+        // Complete the element left over by the previous read
+        std::size_t used = 0;
+        auto& tail = client.counting_tail;
+        if (not tail.empty())
+        {
+            while (tail.size() < sizeof(uint32_t) and used < size)
+            {
+                tail.push_back(data[used++]);
+            }
+            if (tail.size() < sizeof(uint32_t))
+            {
+                return;
+            }
+
+            uint32_t word;
+            std::memcpy(&word, tail.data(), sizeof(word));
+            std::size_t missing = std::min(element_size(word) - tail.size(), size - used);
+            tail.insert(tail.end(), data + used, data + used + missing);
+            used += missing;
+            if (tail.size() < element_size(word))
+            {
+                return;
+            }
+
+            count(word);
+            tail.clear();
+        }
+
+        uint8_t const* pos = data + used;
+        uint8_t const* const end = data + size;
+        while (pos + sizeof(uint32_t) <= end)
+        {
+            uint32_t word;
+            std::memcpy(&word, pos, sizeof(word));
+            std::size_t elem_size = element_size(word);
+            if (pos + elem_size > end)
+            {
+                break;
+            }
+
+            count(word);
+            pos += elem_size;
+        }
+        tail.assign(pos, end);
+
+        client.counters->samples.fetch_add(samples, std::memory_order_relaxed);
+        metrics_->samples.fetch_add(samples, std::memory_order_relaxed);
+    }
+}
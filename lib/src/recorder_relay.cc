@@ -0,0 +1,26 @@
+#include <cstdio>
+
+#include "recorder.h"
+
+namespace rtm
+{
+    void Recorder::set_relay(std::shared_ptr<RelayLink> link)
+    {
+        relay_ = std::move(link);
+    }
+
+    void Recorder::relay_data(Client& client)
+    {
+        if (client.relay == nullptr)
+        {
+            printf("[Recorder] Relaying %s_%s\n", client.process_name.c_str(), client.source_name.c_str());
+            client.relay = relay_->open_stream();
+            client.relay->write(client.header_bytes.data(), static_cast<int64_t>(client.header_bytes.size()));
+        }
+
+        // The writer keeps the incomplete samples itself: the upstream receives the stream as is
+        client.relay->write(client.buffer.data(), static_cast<int64_t>(client.buffer.size()));
+        client.buffer.clear();
+        client.unwritten_since = 0ns;
+    }
+}
@@ -0,0 +1,18 @@
+#include "recorder.h"
+
+namespace rtm
+{
+    void Recorder::set_quota(uint64_t max_bytes)
+    {
+        retention_->set_quota(max_bytes);
+    }
+
+    void Recorder::enforce_quota()
+    {
+        retention_->enforce();
+
+        metrics_->recorded_bytes.store(retention_->used(), std::memory_order_relaxed);
+        metrics_->write_errors.store(retention_->write_errors(), std::memory_order_relaxed);
+        metrics_->recordings_deleted.store(retention_->deleted(), std::memory_order_relaxed);
+    }
+}
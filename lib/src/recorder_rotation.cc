@@ -0,0 +1,248 @@
+#include <array>
+#include <cstdio>
+#include <cstring>
+
+#include "recorder.h"
+#include "commands.h"
+#include "parser.h"
+#include "serializer.h"
+#include "summary.h"
+#include "io/file.h"
+
+namespace rtm
+{
+    namespace
+    {
+        std::string segment_base(std::string const& name)
+        {
+            // name is the path of the recording, without segmentation: <base>.tick
+            return name.substr(0, name.size() - std::string_view{".tick"}.size());
+        }
+
+        std::string segment_suffix(uint32_t index)
+        {
+            char suffix[16];
+            snprintf(suffix, sizeof(suffix), "%04u", index);
+            return suffix;
+        }
+    }
+
+    void Recorder::set_rotation(std::size_t max_size, nanoseconds max_interval)
+    {
+        rotation_size_ = max_size;
+        rotation_interval_ = max_interval;
+    }
+
+    void Recorder::Client::open_segment()
+    {
+        std::string base = segment_base(name);
+        std::string path = base + '.' + segment_suffix(segment_index) + ".tick";
+
+        sink = retention->track(path, std::make_unique<SummaryIO>(std::make_unique<File>(path), path));
+        auto rc = sink->open(segment_mode);
+        if (rc)
+        {
+            printf("[Recorder] Cannot open segment %s: %s\n", path.c_str(), rc.message().c_str());
+        }
+
+        if (segment_index == 0)
+        {
+            File manifest{base + ".segments"};
+            if (not manifest.open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE))
+            {
+                std::string_view legend = "# file begin_ns end_ns samples (times relative to the process start)\n";
+                manifest.write(legend.data(), static_cast<int64_t>(legend.size()));
+            }
+        }
+
+        // Each segment is standalone: its own header and the current stream state
+        std::array<uint8_t, 16> uuid;
+        std::memcpy(uuid.data(), header_bytes.data() + 16, uuid.size());
+        std::string task = source_name + '#' + segment_suffix(segment_index);
+
+        auto header = build_tick_header(uuid, start_time, process_name, task);
+        sink->write(header.data(), static_cast<int64_t>(header.size()));
+        write_command(*sink, Command::UPDATE_PERIOD, current_period);
+        write_command(*sink, Command::UPDATE_PRIORITY, current_priority);
+
+        segment_bytes = static_cast<int64_t>(header.size()) + 2 * sizeof(uint32_t) + sizeof(uint64_t) + sizeof(int32_t);
+        segment_samples = 0;
+        segment_begin = 0ns;
+        segment_end = 0ns;
+    }
+
+    void Recorder::Client::close_segment()
+    {
+        if (sink == nullptr)
+        {
+            return;
+        }
+
+        uint32_t sentinel = ESCAPE | Command::DATA_STREAM_END;
+        sink->write(&sentinel, sizeof(sentinel));
+        sync_sink();
+        sink.reset();
+
+        std::string base = segment_base(name);
+        std::string file_name = base.substr(base.find_last_of('/') + 1) + '.' + segment_suffix(segment_index) + ".tick";
+
+        char line[512];
+        int size = snprintf(line, sizeof(line), "%s %ld %ld %lu\n", file_name.c_str(),
+                            static_cast<long>(segment_begin.count()), static_cast<long>(segment_end.count()),
+                            static_cast<unsigned long>(segment_samples));
+
+        File manifest{base + ".segments"};
+        if (manifest.open(access::Mode::WRITE_ONLY | access::Mode::APPEND))
+        {
+            printf("[Recorder] Cannot update segment manifest %s.segments\n", base.c_str());
+            return;
+        }
+        manifest.write(line, std::min<int64_t>(size, sizeof(line) - 1));
+    }
+
+    void Recorder::Client::write_segments()
+    {
+        std::vector<uint8_t> out;
+        out.reserve(buffer.size() + 16);
+
+        uint8_t const* pos = buffer.data();
+        uint8_t const* const buf_end = pos + buffer.size();
+
+        auto emit = [&out](uint8_t const* from, uint8_t const* to)
+        {
+            out.insert(out.end(), from, to);
+        };
+
+        auto emit_reference = [&](uint32_t delta)
+        {
+            uint32_t command = ESCAPE | Command::UPDATE_REFERENCE;
+            uint64_t reference = static_cast<uint64_t>((current_reference + nanoseconds(delta)).count());
+            append(out, command);
+            append(out, reference);
+        };
+
+        // Cut before a start sample, once the current segment is full
+        auto rotate_if_needed = [&](nanoseconds absolute)
+        {
+            if (sample_parity != 0 or segment_samples == 0)
+            {
+                return false;
+            }
+
+            bool full = (rotation_size > 0 and segment_bytes + static_cast<int64_t>(out.size()) >= static_cast<int64_t>(rotation_size))
+                     or (rotation_interval > 0ns and absolute - segment_begin >= rotation_interval);
+            if (not full)
+            {
+                return false;
+            }
+
+            if (sink != nullptr)
+            {
+                sink->write(out.data(), static_cast<int64_t>(out.size()));
+            }
+            out.clear();
+            close_segment(); // synced with its sentinel
+
+            segment_index++;
+            open_segment();
+            return true;
+        };
+
+        auto count_sample = [&](nanoseconds absolute)
+        {
+            if (segment_samples == 0)
+            {
+                segment_begin = absolute;
+            }
+            segment_end = absolute;
+            segment_samples++;
+            sample_parity = (sample_parity + 1) % 2;
+        };
+
+        while (pos + sizeof(uint32_t) <= buf_end)
+        {
+            uint8_t const* elem_start = pos;
+            uint32_t raw = extract_data<uint32_t>(pos);
+
+            if (raw & ESCAPE)
+            {
+                if (raw == (ESCAPE | Command::DATA_STREAM_END))
+                {
+                    // The sentinel is written when the segment is closed
+                    continue;
+                }
+
+                std::size_t payload = element_size(raw) - sizeof(uint32_t);
+
+                if (pos + payload > buf_end)
+                {
+                    pos = elem_start;
+                    break;
+                }
+
+                if (raw & Command::UPDATE_REFERENCE)
+                {
+                    nanoseconds reference{extract_data<uint64_t>(pos)};
+                    nanoseconds absolute = reference - start_time;
+                    rotate_if_needed(absolute);
+
+                    current_reference = reference;
+                    rebasing = false;
+                    emit(elem_start, pos);
+                    count_sample(absolute);
+                    continue;
+                }
+
+                if (raw & Command::UPDATE_PERIOD)
+                {
+                    current_period = nanoseconds(extract_data<uint64_t>(pos));
+                }
+                else if (raw & Command::UPDATE_PRIORITY)
+                {
+                    current_priority = extract_data<int32_t>(pos);
+                }
+                else
+                {
+                    pos += payload;
+                }
+                emit(elem_start, pos);
+                continue;
+            }
+
+            nanoseconds absolute = nanoseconds(raw) + (current_reference - start_time);
+            if (rotate_if_needed(absolute))
+            {
+                // The first sample of a segment must not depend on the previous one: it becomes
+                // the reference and the following deltas are rebased on it.
+                emit_reference(raw);
+                rebasing = true;
+                rebase_base = raw;
+            }
+            else if (not rebasing)
+            {
+                emit(elem_start, pos);
+            }
+            else if (raw >= rebase_base)
+            {
+                append(out, raw - rebase_base);
+            }
+            else
+            {
+                // Going backward cannot be expressed as a delta: restart from this sample
+                emit_reference(raw);
+                rebase_base = raw;
+            }
+            count_sample(absolute);
+        }
+
+        if (sink != nullptr and not out.empty())
+        {
+            sink->write(out.data(), static_cast<int64_t>(out.size()));
+            sync_sink();
+        }
+        segment_bytes += static_cast<int64_t>(out.size());
+
+        std::size_t consumed = static_cast<std::size_t>(pos - buffer.data());
+        buffer.erase(buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(consumed));
+    }
+}
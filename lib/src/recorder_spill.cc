@@ -0,0 +1,229 @@
+#include <cstdio>
+#include <filesystem>
+
+#include "recorder.h"
+#include "io/async.h"
+#include "io/file.h"
+
+namespace rtm
+{
+    void Recorder::set_memory_budget(std::size_t bytes, std::string_view spill_path)
+    {
+        memory_budget_ = bytes;
+
+        if (spill_path.empty())
+        {
+            spill_path_ = recording_path_ + "/.spill";
+        }
+        else
+        {
+            spill_path_ = spill_path;
+        }
+
+        if (memory_budget_ > 0)
+        {
+            std::filesystem::create_directories(spill_path_);
+        }
+    }
+
+    RecorderStats Recorder::stats() const
+    {
+        RecorderStats stats;
+        stats.clients = clients_.size();
+        for (auto const& client : clients_)
+        {
+            stats.ring_ram_bytes += client.ring_ram_bytes;
+            stats.ring_spilled_bytes += client.ring_spilled_bytes;
+        }
+        return stats;
+    }
+
+    void Recorder::enforce_memory_budget()
+    {
+        if (memory_budget_ == 0)
+        {
+            return;
+        }
+
+        std::size_t ram_bytes = 0;
+        for (auto const& client : clients_)
+        {
+            ram_bytes += client.ring_ram_bytes;
+        }
+
+        while (ram_bytes > memory_budget_)
+        {
+            // Spill the oldest chunk still in memory, whatever client it belongs to.
+            Client* victim = nullptr;
+            nanoseconds oldest = nanoseconds::max();
+            for (auto& client : clients_)
+            {
+                if (client.ring_spilled_chunks >= client.ring.size())
+                {
+                    continue;
+                }
+
+                nanoseconds chunk_time = client.start_time + client.ring[client.ring_spilled_chunks].first_sample_time;
+                if (chunk_time < oldest)
+                {
+                    oldest = chunk_time;
+                    victim = &client;
+                }
+            }
+
+            if (victim == nullptr)
+            {
+                break;
+            }
+
+            std::size_t before = victim->ring_ram_bytes;
+            if (not spill_chunk(*victim))
+            {
+                break;
+            }
+            ram_bytes -= (before - victim->ring_ram_bytes);
+        }
+    }
+
+    bool Recorder::spill_chunk(Client& client)
+    {
+        Chunk& chunk = client.ring[client.ring_spilled_chunks];
+
+        if (client.spill_segments.empty() or client.spill_segments.back().size >= SPILL_SEGMENT_SIZE)
+        {
+            SpillSegment segment;
+            if (client.spill_segments.empty())
+            {
+                segment.id = 0;
+            }
+            else
+            {
+                segment.id = client.spill_segments.back().id + 1;
+            }
+
+            segment.path = spill_path_ + '/';
+            segment.path += std::to_string(client.id);
+            segment.path += '_';
+            segment.path += client.process_name;
+            segment.path += '_';
+            segment.path += client.source_name;
+            segment.path += '.';
+            segment.path += std::to_string(segment.id);
+            segment.path += ".spill";
+
+            segment.file = std::make_unique<File>(segment.path);
+            auto rc = segment.file->open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE | access::Mode::APPEND);
+            if (rc)
+            {
+                printf("[Recorder] Cannot open spill file %s: %s\n", segment.path.c_str(), rc.message().c_str());
+                return false;
+            }
+            client.spill_segments.push_back(std::move(segment));
+        }
+
+        SpillSegment& segment = client.spill_segments.back();
+        int64_t size = static_cast<int64_t>(chunk.data.size());
+        if (segment.file->write(chunk.data.data(), size) != size)
+        {
+            printf("[Recorder] Short write on spill file %s\n", segment.path.c_str());
+            return false;
+        }
+
+        chunk.spill_segment = segment.id;
+        chunk.spill_offset = segment.size;
+        chunk.spill_size = static_cast<uint32_t>(size);
+        segment.size += size;
+        segment.live_chunks++;
+
+        client.ring_ram_bytes -= chunk.data.size();
+        client.ring_spilled_bytes += chunk.spill_size;
+        client.ring_spilled_chunks++;
+        std::vector<uint8_t>{}.swap(chunk.data);
+
+        return true;
+    }
+
+    void Recorder::hand_over_ring(Client& client, AsyncIO& sink, std::size_t first_chunk)
+    {
+        // Spill segments now belong to the writer: they are deleted once read back.
+        auto segments = std::shared_ptr<std::deque<SpillSegment>>(
+            new std::deque<SpillSegment>(std::move(client.spill_segments)),
+            [](std::deque<SpillSegment>* dead)
+            {
+                for (auto& segment : *dead)
+                {
+                    segment.file.reset();
+                    std::error_code ec;
+                    std::filesystem::remove(segment.path, ec);
+                }
+                delete dead;
+            });
+
+        std::vector<Chunk> spilled;
+        auto read_back_spilled = [&]()
+        {
+            if (spilled.empty())
+            {
+                return;
+            }
+
+            sink.post([segments, chunks = std::move(spilled)](AbstractIO& io)
+            {
+                std::vector<uint8_t> data;
+                for (auto const& segment : *segments)
+                {
+                    File reader{segment.path};
+                    if (reader.open(access::Mode::READ_ONLY))
+                    {
+                        printf("[Recorder] Cannot read back spill file %s\n", segment.path.c_str());
+                        continue;
+                    }
+
+                    for (auto const& spilled_chunk : chunks)
+                    {
+                        if (spilled_chunk.spill_segment != segment.id)
+                        {
+                            continue;
+                        }
+
+                        data.resize(spilled_chunk.spill_size);
+                        if (reader.seek(spilled_chunk.spill_offset) or
+                            reader.read(data.data(), spilled_chunk.spill_size) != spilled_chunk.spill_size)
+                        {
+                            printf("[Recorder] Short read on spill file %s\n", segment.path.c_str());
+                            continue;
+                        }
+                        io.write(data.data(), static_cast<int64_t>(data.size()));
+                    }
+                }
+            });
+            spilled.clear();
+        };
+
+        // Spilled chunks are the oldest ones: they all are read back in a single job.
+        for (std::size_t i = first_chunk; i < client.ring.size(); ++i)
+        {
+            Chunk& chunk = client.ring[i];
+            if (chunk.spill_offset >= 0)
+            {
+                spilled.push_back(std::move(chunk));
+                continue;
+            }
+
+            read_back_spilled();
+            if (not chunk.data.empty())
+            {
+                sink.write(std::move(chunk.data));
+            }
+        }
+        read_back_spilled();
+
+        client.journal.clear();
+        client.ring.clear();
+        client.ring_sample_count = 0;
+        client.ring_ram_bytes = 0;
+        client.ring_spilled_chunks = 0;
+        client.ring_spilled_bytes = 0;
+        client.spill_segments.clear();
+    }
+}
@@ -0,0 +1,147 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "recorder.h"
+
+namespace rtm
+{
+    namespace
+    {
+        // Bytes moved per splice() call: the default capacity of a pipe
+        constexpr std::size_t SPLICE_CHUNK = 64 * 1024;
+    }
+
+    Recorder::SplicePipe::SplicePipe(SplicePipe&& other)
+    {
+        std::swap(read_end, other.read_end);
+        std::swap(write_end, other.write_end);
+    }
+
+    Recorder::SplicePipe& Recorder::SplicePipe::operator=(SplicePipe&& other)
+    {
+        std::swap(read_end, other.read_end);
+        std::swap(write_end, other.write_end);
+        return *this;
+    }
+
+    Recorder::SplicePipe::~SplicePipe()
+    {
+        close();
+    }
+
+    std::error_code Recorder::SplicePipe::open()
+    {
+#ifdef __linux__
+        int fds[2];
+        if (::pipe2(fds, O_CLOEXEC) < 0)
+        {
+            return from_errno(errno);
+        }
+        read_end = fds[0];
+        write_end = fds[1];
+        return {};
+#else
+        return from_errno(ENOSYS);
+#endif
+    }
+
+    void Recorder::SplicePipe::close()
+    {
+        if (read_end != -1)
+        {
+            ::close(read_end);
+            ::close(write_end);
+            read_end = -1;
+            write_end = -1;
+        }
+    }
+
+    void Recorder::set_splice(bool enable)
+    {
+        splice_enabled_ = enable;
+    }
+
+    void Recorder::start_splice(Client& client)
+    {
+        if (not splice_enabled_ or fanout_enabled_ or client.rotating or client.sink == nullptr)
+        {
+            return;
+        }
+        if (client.io->native_handle() < 0 or client.sink->native_handle() < 0)
+        {
+            return;
+        }
+
+        auto rc = client.splice_pipe.open();
+        if (rc)
+        {
+            printf("[Recorder] splice unavailable (%s): copying the data\n", rc.message().c_str());
+        }
+    }
+
+    bool Recorder::splice_data(Client& client)
+    {
+#ifdef __linux__
+        ssize_t received = ::splice(client.io->native_handle(), nullptr, client.splice_pipe.write_end, nullptr,
+                                    SPLICE_CHUNK, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (received < 0 and errno == EAGAIN)
+        {
+            return true;
+        }
+        if (received <= 0)
+        {
+            // End of stream, error or a socket that cannot be spliced: the copying path
+            // reads again and handles it.
+            client.splice_pipe.close();
+            return false;
+        }
+
+        metrics_->bytes.fetch_add(static_cast<uint64_t>(received), std::memory_order_relaxed);
+        client.counters->bytes.fetch_add(static_cast<uint64_t>(received), std::memory_order_relaxed);
+        client.unwritten_since = since_epoch();
+
+        std::size_t remaining = static_cast<std::size_t>(received);
+        while (remaining > 0)
+        {
+            ssize_t written = ::splice(client.splice_pipe.read_end, nullptr, client.sink->native_handle(), nullptr,
+                                       remaining, SPLICE_F_MOVE);
+            if (written <= 0)
+            {
+                // Get the data back from the pipe and let the copying path write it
+                printf("[Recorder] splice to file failed (%s): copying the data\n", strerror(errno));
+                std::size_t offset = client.buffer.size();
+                client.buffer.resize(offset + remaining);
+                while (remaining > 0)
+                {
+                    ssize_t r = ::read(client.splice_pipe.read_end, client.buffer.data() + offset, remaining);
+                    if (r <= 0)
+                    {
+                        break;
+                    }
+                    offset += static_cast<std::size_t>(r);
+                    remaining -= static_cast<std::size_t>(r);
+                }
+                client.buffer.resize(offset);
+                client.splice_pipe.close();
+                return false;
+            }
+            remaining -= static_cast<std::size_t>(written);
+            if (auto* tracked = dynamic_cast<TrackedIO*>(client.sink.get()))
+            {
+                tracked->written(written);
+            }
+        }
+
+        client.sync_sink();
+        return true;
+#else
+        client.splice_pipe.close();
+        return false;
+#endif
+    }
+}
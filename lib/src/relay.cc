@@ -0,0 +1,393 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "relay.h"
+#include "serializer.h"
+
+namespace rtm
+{
+    namespace relay
+    {
+        namespace
+        {
+            uint32_t predict(uint8_t const* words, std::size_t i)
+            {
+                auto word = [words](std::size_t index)
+                {
+                    uint32_t value;
+                    std::memcpy(&value, words + index * sizeof(uint32_t), sizeof(value));
+                    return value;
+                };
+
+                if (i >= 4)
+                {
+                    return 2 * word(i - 2) - word(i - 4);
+                }
+                if (i >= 2)
+                {
+                    return word(i - 2);
+                }
+                return 0;
+            }
+        }
+
+        std::vector<uint8_t> compress(uint8_t const* data, std::size_t size)
+        {
+            std::vector<uint8_t> out;
+            if (size % sizeof(uint32_t) != 0 or size > MAX_PAYLOAD)
+            {
+                return out;
+            }
+            out.reserve(size);
+            append(out, static_cast<uint32_t>(size));
+
+            for (std::size_t i = 0; i < size / sizeof(uint32_t); ++i)
+            {
+                uint32_t word;
+                std::memcpy(&word, data + i * sizeof(uint32_t), sizeof(word));
+                uint32_t residual = word - predict(data, i);
+                uint32_t zigzag = (residual << 1) ^ (0u - (residual >> 31));
+                while (zigzag >= 0x80)
+                {
+                    out.push_back(static_cast<uint8_t>(zigzag | 0x80));
+                    zigzag >>= 7;
+                }
+                out.push_back(static_cast<uint8_t>(zigzag));
+            }
+            return out;
+        }
+
+        bool decompress(uint8_t const* data, std::size_t size, std::vector<uint8_t>& out)
+        {
+            if (size < sizeof(uint32_t))
+            {
+                return false;
+            }
+            uint8_t const* pos = data;
+            uint8_t const* const end = data + size;
+            uint32_t raw_size = extract_data<uint32_t>(pos);
+            if (raw_size % sizeof(uint32_t) != 0 or raw_size > MAX_PAYLOAD)
+            {
+                return false;
+            }
+
+            std::size_t const offset = out.size();
+            out.resize(offset + raw_size);
+            uint8_t* words = out.data() + offset;
+            for (std::size_t i = 0; i < raw_size / sizeof(uint32_t); ++i)
+            {
+                uint32_t zigzag = 0;
+                for (unsigned shift = 0; ; shift += 7)
+                {
+                    if (pos == end or shift > 28)
+                    {
+                        return false;
+                    }
+                    uint8_t byte = *pos++;
+                    zigzag |= static_cast<uint32_t>(byte & 0x7f) << shift;
+                    if (not (byte & 0x80))
+                    {
+                        break;
+                    }
+                }
+
+                uint32_t residual = (zigzag >> 1) ^ (0u - (zigzag & 1));
+                uint32_t word = residual + predict(words, i);
+                std::memcpy(words + i * sizeof(uint32_t), &word, sizeof(word));
+            }
+            return pos == end;
+        }
+    }
+
+
+    // Datagrams of one stream, from its DatagramWriter to the link
+    class RelayLink::Channel final : public AbstractIO
+    {
+    public:
+        Channel(RelayLink& link)
+            : link_{link}
+        {
+            supported_modes_ = access::Mode::WRITE_ONLY | access::Mode::READ_WRITE | access::Mode::NON_BLOCKING;
+        }
+
+        int64_t read(void*, int64_t) override
+        {
+            errno = ENOTSUP;
+            return -1;
+        }
+
+        int64_t write(void const* data, int64_t data_size) override
+        {
+            link_.queue(static_cast<uint8_t const*>(data), static_cast<std::size_t>(data_size));
+            return data_size;
+        }
+
+    protected:
+        std::error_code do_open(access::Mode) override { return {}; }
+        std::error_code do_close() override { return {}; }
+
+    private:
+        RelayLink& link_;
+    };
+
+    RelayLink::RelayLink(std::unique_ptr<AbstractIO> upstream, std::size_t buffer_size, bool compress)
+        : upstream_{std::move(upstream)}
+        , buffer_size_{buffer_size}
+        , compress_{compress}
+    {
+        std::random_device random;
+        relay_id_ = (static_cast<uint64_t>(random()) << 32) | random();
+    }
+
+    RelayLink::~RelayLink()
+    {
+        // Best effort: what the upstream cannot take right now is lost
+        flush();
+    }
+
+    std::unique_ptr<AbstractIO> RelayLink::open_stream()
+    {
+        auto stream = std::make_unique<DatagramWriter>(std::make_unique<Channel>(*this));
+        stream->open(access::Mode::WRITE_ONLY);
+        return stream;
+    }
+
+    void RelayLink::queue(uint8_t const* datagram, std::size_t size)
+    {
+        datagram::Header header;
+        if (size < sizeof(header))
+        {
+            return;
+        }
+        std::memcpy(&header, datagram, sizeof(header));
+
+        std::vector<uint8_t> entry;
+        if (compress_ and header.type == datagram::STREAM_DATA)
+        {
+            auto compressed = relay::compress(datagram + sizeof(header), header.size);
+            if (not compressed.empty() and compressed.size() < header.size)
+            {
+                header.flags = relay::COMPRESSED;
+                header.size = static_cast<uint32_t>(compressed.size());
+                entry.resize(sizeof(header));
+                std::memcpy(entry.data(), &header, sizeof(header));
+                entry.insert(entry.end(), compressed.begin(), compressed.end());
+            }
+        }
+        if (entry.empty())
+        {
+            entry.assign(datagram, datagram + size);
+        }
+
+        queued_bytes_ += entry.size();
+        queue_.push_back(std::move(entry));
+
+        // Keep the newest data: the upstream notices the loss in the sequence numbers
+        while (buffered() > buffer_size_ and not queue_.empty())
+        {
+            queued_bytes_ -= queue_.front().size();
+            queue_.pop_front();
+            dropped_++;
+        }
+    }
+
+    bool RelayLink::connect()
+    {
+        nanoseconds now = since_epoch();
+        if (now < next_attempt_)
+        {
+            return false;
+        }
+
+        if (upstream_->is_open())
+        {
+            upstream_->close();
+        }
+        auto rc = upstream_->open(access::Mode::READ_WRITE | access::Mode::NON_BLOCKING);
+        if (rc)
+        {
+            if (next_attempt_ == 0ns)
+            {
+                printf("[Recorder] Upstream unreachable (%s): buffering\n", rc.message().c_str());
+            }
+            next_attempt_ = now + RECONNECT_DELAY;
+            return false;
+        }
+
+        printf("[Recorder] Relaying to the upstream\n");
+        connected_ = true;
+        next_attempt_ = 0ns;
+
+        // The batch interrupted by the outage is sent again: the upstream ignores the duplicates
+        std::vector<uint8_t> hello(sizeof(datagram::Header));
+        datagram::Header header{};
+        header.magic = datagram::MAGIC;
+        header.type = relay::HELLO;
+        header.size = sizeof(relay_id_);
+        std::memcpy(hello.data(), &header, sizeof(header));
+        append(hello, relay_id_);
+        batch_.insert(batch_.begin(), hello.begin(), hello.end());
+        sent_ = 0;
+        return true;
+    }
+
+    void RelayLink::flush()
+    {
+        if (not connected_ and not connect())
+        {
+            return;
+        }
+
+        while (true)
+        {
+            if (sent_ == batch_.size())
+            {
+                batch_.clear();
+                sent_ = 0;
+                while (not queue_.empty() and batch_.size() + queue_.front().size() <= BATCH_SIZE)
+                {
+                    batch_.insert(batch_.end(), queue_.front().begin(), queue_.front().end());
+                    queued_bytes_ -= queue_.front().size();
+                    queue_.pop_front();
+                }
+                if (batch_.empty())
+                {
+                    return;
+                }
+            }
+
+            int64_t written = upstream_->write(batch_.data() + sent_, static_cast<int64_t>(batch_.size() - sent_));
+            if (written < 0)
+            {
+                if (errno != EAGAIN)
+                {
+                    printf("[Recorder] Upstream lost (%s): buffering\n", strerror(errno));
+                    upstream_->close();
+                    connected_ = false;
+                    next_attempt_ = since_epoch() + RECONNECT_DELAY;
+                }
+                return;
+            }
+            sent_ += static_cast<std::size_t>(written);
+        }
+    }
+
+
+    RelayListener::RelayListener(std::unique_ptr<AbstractListener> listener, nanoseconds idle_timeout)
+        : listener_{std::move(listener)}
+        , assembler_{idle_timeout}
+    {
+    }
+
+    std::error_code RelayListener::listen(int backlog)
+    {
+        return listener_->listen(backlog);
+    }
+
+    std::vector<std::unique_ptr<AbstractIO>> RelayListener::receive()
+    {
+        std::vector<std::unique_ptr<AbstractIO>> started;
+        nanoseconds now = since_epoch();
+
+        while (auto io = listener_->accept(access::Mode::NON_BLOCKING))
+        {
+            printf("[Recorder] New relay\n");
+            connections_.emplace_back();
+            connections_.back().io = std::move(io);
+        }
+
+        for (auto& connection : connections_)
+        {
+            if (not read(connection, now, started))
+            {
+                connection.io.reset();
+            }
+        }
+        connections_.erase(std::remove_if(connections_.begin(), connections_.end(),
+            [](Connection const& connection) { return connection.io == nullptr; }), connections_.end());
+
+        assembler_.expire(now);
+        return started;
+    }
+
+    bool RelayListener::read(Connection& connection, nanoseconds now, std::vector<std::unique_ptr<AbstractIO>>& started)
+    {
+        // Bounded: a busy relay shall not starve the others
+        for (int i = 0; i < 16; ++i)
+        {
+            uint8_t chunk[16 * 1024];
+            int64_t received = connection.io->read(chunk, sizeof(chunk));
+            if (received == 0)
+            {
+                printf("[Recorder] Relay disconnected\n");
+                return false;
+            }
+            if (received < 0)
+            {
+                if (errno == EAGAIN)
+                {
+                    return true;
+                }
+                printf("[Recorder] Relay read error: %s\n", strerror(errno));
+                return false;
+            }
+            connection.buffer.insert(connection.buffer.end(), chunk, chunk + received);
+
+            std::size_t pos = 0;
+            while (connection.buffer.size() - pos >= sizeof(datagram::Header))
+            {
+                datagram::Header header;
+                std::memcpy(&header, connection.buffer.data() + pos, sizeof(header));
+                if (header.magic != datagram::MAGIC or header.size > relay::MAX_PAYLOAD)
+                {
+                    printf("[Recorder] Relay stream desynchronized: disconnected\n");
+                    return false;
+                }
+
+                std::size_t size = sizeof(header) + header.size;
+                if (connection.buffer.size() - pos < size)
+                {
+                    break;
+                }
+                uint8_t const* datagram = connection.buffer.data() + pos;
+                pos += size;
+
+                if (header.type == relay::HELLO)
+                {
+                    if (header.size < sizeof(uint64_t))
+                    {
+                        return false;
+                    }
+                    connection.sender.assign(reinterpret_cast<char const*>(datagram + sizeof(header)), sizeof(uint64_t));
+                    continue;
+                }
+                if (connection.sender.empty())
+                {
+                    printf("[Recorder] Relay did not say hello: disconnected\n");
+                    return false;
+                }
+
+                if (header.flags & relay::COMPRESSED)
+                {
+                    plain_.resize(sizeof(header));
+                    if (not relay::decompress(datagram + sizeof(header), header.size, plain_))
+                    {
+                        printf("[Recorder] Relay sent a corrupted datagram: disconnected\n");
+                        return false;
+                    }
+                    header.flags = 0;
+                    header.size = static_cast<uint32_t>(plain_.size() - sizeof(header));
+                    std::memcpy(plain_.data(), &header, sizeof(header));
+                    assembler_.dispatch(connection.sender, plain_.data(), plain_.size(), now, started);
+                    continue;
+                }
+                assembler_.dispatch(connection.sender, datagram, size, now, started);
+            }
+            connection.buffer.erase(connection.buffer.begin(), connection.buffer.begin() + static_cast<ptrdiff_t>(pos));
+        }
+        return true;
+    }
+}
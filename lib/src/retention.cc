@@ -0,0 +1,325 @@
+#include <cerrno>
+#include <cstdio>
+
+#include "retention.h"
+#include "lod_cache.h"
+
+namespace rtm
+{
+    namespace
+    {
+        // Spelling of a path shared by the recorder, the scan and the TrackedIOs
+        std::string normal_path(std::filesystem::path const& path)
+        {
+            std::error_code ec;
+            std::filesystem::path normal = std::filesystem::absolute(path, ec);
+            if (ec)
+            {
+                normal = path;
+            }
+            normal = normal.lexically_normal();
+            if (not normal.has_filename() and normal.has_relative_path())
+            {
+                normal = normal.parent_path(); // trailing separator
+            }
+            return normal.string();
+        }
+    }
+
+    Retention::Retention(std::string root)
+        : root_{normal_path(root)}
+        , state_{std::make_shared<State>()}
+    {
+
+    }
+
+    void Retention::set_quota(uint64_t bytes)
+    {
+        quota_ = bytes;
+        if (quota_ == 0 or scanning_)
+        {
+            return;
+        }
+
+        std::error_code ec;
+        scan_ = std::filesystem::recursive_directory_iterator(root_, std::filesystem::directory_options::skip_permission_denied, ec);
+        if (ec)
+        {
+            printf("[Recorder] Cannot scan %s: %s\n", root_.c_str(), ec.message().c_str());
+            return;
+        }
+        scanning_ = true;
+    }
+
+    std::unique_ptr<AbstractIO> Retention::track(std::string const& path, std::unique_ptr<AbstractIO> io)
+    {
+        std::string normal = normal_path(path);
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            state_->open.insert(normal);
+        }
+        return std::make_unique<TrackedIO>(std::move(normal), std::move(io), state_);
+    }
+
+    uint64_t Retention::used() const
+    {
+        return complete_bytes_ + state_->open_bytes.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Retention::write_errors() const
+    {
+        return state_->write_errors.load(std::memory_order_relaxed);
+    }
+
+    void Retention::add_recording(std::filesystem::path const& file)
+    {
+        std::filesystem::path path{normal_path(file)};
+        if (path.extension() != ".tick" or known_.count(path.string()) > 0)
+        {
+            return;
+        }
+
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(path, ec);
+        if (ec)
+        {
+            return;
+        }
+        auto time = std::filesystem::last_write_time(path, ec);
+        if (ec)
+        {
+            return;
+        }
+
+        // Its level-of-detail cache goes with it (see remove_recording())
+        uint64_t cache_size = std::filesystem::file_size(path.string() + LodCache::EXTENSION, ec);
+        if (not ec)
+        {
+            size += cache_size;
+        }
+
+        known_.insert(path.string());
+        recordings_.insert({time, Recording{path.string(), size}});
+        complete_bytes_ += size;
+    }
+
+    void Retention::remove_recording(std::multimap<std::filesystem::file_time_type, Recording>::iterator it)
+    {
+        std::filesystem::path path{it->second.path};
+
+        bool is_open;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            is_open = state_->open.count(it->second.path) > 0;
+        }
+        if (is_open)
+        {
+            // Written again since it was found: accounted as open, then back here once closed
+            complete_bytes_ -= it->second.size;
+            known_.erase(it->second.path);
+            recordings_.erase(it);
+            return;
+        }
+
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+        if (ec)
+        {
+            printf("[Recorder] Cannot delete %s: %s\n", path.c_str(), ec.message().c_str());
+        }
+        else
+        {
+            printf("[Recorder] Quota: deleted %s (%lu bytes)\n", path.c_str(), static_cast<unsigned long>(it->second.size));
+            deleted_++;
+        }
+
+        // Its level-of-detail cache, if a monitor made one, goes with it
+        std::filesystem::remove(path.string() + LodCache::EXTENSION, ec);
+
+        // Forget it anyway: retrying a file that cannot be deleted would block the others
+        complete_bytes_ -= it->second.size;
+        known_.erase(it->second.path);
+        recordings_.erase(it);
+
+        // Drop the incident directories emptied of their recordings
+        std::filesystem::path directory = path.parent_path();
+        if (directory == std::filesystem::path{root_})
+        {
+            return;
+        }
+        std::filesystem::directory_iterator entries{directory, ec};
+        if (ec)
+        {
+            return;
+        }
+        for (auto const& entry : entries)
+        {
+            if (entry.path().filename() != "incident.manifest")
+            {
+                return;
+            }
+        }
+        std::filesystem::remove_all(directory, ec);
+    }
+
+    void Retention::enforce()
+    {
+        std::vector<std::string> closed;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            closed.swap(state_->closed);
+        }
+        for (auto const& path : closed)
+        {
+            add_recording(path);
+        }
+
+        if (quota_ == 0)
+        {
+            return;
+        }
+
+        if (scanning_)
+        {
+            std::error_code ec;
+            std::size_t step = 0;
+            for (; step < SCAN_STEP and scan_ != std::filesystem::recursive_directory_iterator{}; ++step)
+            {
+                auto const& entry = *scan_;
+                if (entry.is_regular_file(ec))
+                {
+                    bool is_open;
+                    {
+                        std::lock_guard<std::mutex> lock(state_->mutex);
+                        is_open = state_->open.count(normal_path(entry.path())) > 0;
+                    }
+                    if (not is_open)
+                    {
+                        add_recording(entry.path());
+                    }
+                }
+
+                scan_.increment(ec);
+                if (ec)
+                {
+                    printf("[Recorder] Scan of %s interrupted: %s\n", root_.c_str(), ec.message().c_str());
+                    scan_ = {};
+                }
+            }
+
+            if (scan_ != std::filesystem::recursive_directory_iterator{})
+            {
+                return;
+            }
+            scanning_ = false;
+            printf("[Recorder] Quota: %zu recording(s), %lu bytes\n",
+                   recordings_.size(), static_cast<unsigned long>(used()));
+        }
+
+        while (used() > quota_ and not recordings_.empty())
+        {
+            remove_recording(recordings_.begin());
+        }
+    }
+
+
+    TrackedIO::TrackedIO(std::string path, std::unique_ptr<AbstractIO> io, std::shared_ptr<Retention::State> state)
+        : path_{std::move(path)}
+        , io_{std::move(io)}
+        , state_{std::move(state)}
+    {
+        supported_modes_ = access::Mode::READ_ONLY     | access::Mode::WRITE_ONLY | access::Mode::READ_WRITE   |
+                           access::Mode::APPEND        | access::Mode::TRUNCATE   | access::Mode::UNBUFFERED   |
+                           access::Mode::NEW_ONLY      | access::Mode::EXISTING_ONLY | access::Mode::NON_BLOCKING |
+                           access::Mode::DIRECT;
+    }
+
+    TrackedIO::~TrackedIO()
+    {
+        if (is_open())
+        {
+            close();
+        }
+        io_.reset();
+
+        state_->open_bytes.fetch_sub(bytes_, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->open.erase(path_);
+        state_->closed.push_back(std::move(path_));
+    }
+
+    int64_t TrackedIO::read(void* data, int64_t data_size)
+    {
+        return io_->read(data, data_size);
+    }
+
+    int64_t TrackedIO::write(void const* data, int64_t data_size)
+    {
+        int64_t written_size = io_->write(data, data_size);
+        if (written_size != data_size)
+        {
+            report("write", from_errno(written_size < 0 ? errno : ENOSPC));
+        }
+        written(written_size);
+        return written_size;
+    }
+
+    void TrackedIO::written(int64_t size)
+    {
+        if (size > 0)
+        {
+            bytes_ += static_cast<uint64_t>(size);
+            state_->open_bytes.fetch_add(static_cast<uint64_t>(size), std::memory_order_relaxed);
+        }
+    }
+
+    std::error_code TrackedIO::seek(int64_t pos)
+    {
+        return io_->seek(pos);
+    }
+
+    std::error_code TrackedIO::truncate(int64_t size)
+    {
+        return io_->truncate(size);
+    }
+
+    std::error_code TrackedIO::sync()
+    {
+        auto rc = io_->sync();
+        if (rc)
+        {
+            report("sync", rc);
+        }
+        return rc;
+    }
+
+    os_file TrackedIO::native_handle() const
+    {
+        return io_->native_handle();
+    }
+
+    std::error_code TrackedIO::do_open(access::Mode mode)
+    {
+        auto rc = io_->open(mode);
+        if (rc)
+        {
+            report("open", rc);
+        }
+        return rc;
+    }
+
+    std::error_code TrackedIO::do_close()
+    {
+        return io_->close();
+    }
+
+    void TrackedIO::report(char const* operation, std::error_code const& error)
+    {
+        state_->write_errors.fetch_add(1, std::memory_order_relaxed);
+        if (not failed_)
+        {
+            failed_ = true;
+            printf("[Recorder] %s failed on %s: %s\n", operation, path_.c_str(), error.message().c_str());
+        }
+    }
+}
@@ -0,0 +1,485 @@
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#include "rtm/io/file.h"
+
+#include "commands.h"
+#include "metadata.h"
+#include "serializer.h"
+#include "summary.h"
+
+namespace rtm
+{
+    namespace
+    {
+        // offset, reference, begin, end, samples + 2 * (count, min, max, sum, sum_sq)
+        constexpr uint32_t RECORD_SIZE = 5 * 8 + 2 * 5 * 8;
+
+        void append_stats(std::vector<uint8_t>& buffer, SummaryStats const& stats)
+        {
+            append(buffer, stats.count);
+            append(buffer, stats.min);
+            append(buffer, stats.max);
+            append(buffer, stats.sum);
+            append(buffer, stats.sum_sq);
+        }
+
+        SummaryStats extract_stats(uint8_t const*& pos)
+        {
+            SummaryStats stats;
+            stats.count  = extract_data<uint64_t>(pos);
+            stats.min    = extract_data<int64_t>(pos);
+            stats.max    = extract_data<int64_t>(pos);
+            stats.sum    = extract_data<int64_t>(pos);
+            stats.sum_sq = extract_data<double>(pos);
+            return stats;
+        }
+    }
+
+    void SummaryStats::add(nanoseconds value)
+    {
+        int64_t ns = value.count();
+        if (count == 0)
+        {
+            min = ns;
+            max = ns;
+        }
+        min = std::min(min, ns);
+        max = std::max(max, ns);
+        sum += ns;
+        sum_sq += static_cast<double>(ns) * static_cast<double>(ns);
+        count++;
+    }
+
+    void SummaryStats::merge(SummaryStats const& other)
+    {
+        if (other.count == 0)
+        {
+            return;
+        }
+        if (count == 0)
+        {
+            *this = other;
+            return;
+        }
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+        sum += other.sum;
+        sum_sq += other.sum_sq;
+        count += other.count;
+    }
+
+    double SummaryStats::mean() const
+    {
+        if (count == 0)
+        {
+            return 0;
+        }
+        return static_cast<double>(sum) / static_cast<double>(count);
+    }
+
+    double SummaryStats::stddev() const
+    {
+        if (count == 0)
+        {
+            return 0;
+        }
+        double m = mean();
+        return std::sqrt(std::max(0.0, sum_sq / static_cast<double>(count) - m * m));
+    }
+
+    void SummaryBlock::merge(SummaryBlock const& other)
+    {
+        if (other.samples == 0)
+        {
+            return;
+        }
+        if (samples == 0)
+        {
+            *this = other;
+            return;
+        }
+        if (other.begin < begin)
+        {
+            offset = other.offset;
+            reference = other.reference;
+            begin = other.begin;
+        }
+        end = std::max(end, other.end);
+        samples += other.samples;
+        period.merge(other.period);
+        up.merge(other.up);
+    }
+
+    void append_summary(std::vector<uint8_t>& buffer, std::vector<SummaryBlock> const& blocks)
+    {
+        append(buffer, RECORD_SIZE);
+        for (auto const& block : blocks)
+        {
+            append(buffer, block.offset);
+            append(buffer, static_cast<int64_t>(block.reference.count()));
+            append(buffer, static_cast<int64_t>(block.begin.count()));
+            append(buffer, static_cast<int64_t>(block.end.count()));
+            append(buffer, block.samples);
+            append_stats(buffer, block.period);
+            append_stats(buffer, block.up);
+        }
+    }
+
+    bool read_summary(uint8_t const* data, std::size_t size, std::vector<SummaryBlock>& blocks)
+    {
+        if (size < sizeof(uint32_t))
+        {
+            return false;
+        }
+        uint8_t const* pos = data;
+        uint32_t record_size = extract_data<uint32_t>(pos);
+        size -= sizeof(uint32_t);
+
+        // Newer writers may append fields to the records: skip them
+        if (record_size < RECORD_SIZE or size % record_size != 0)
+        {
+            return false;
+        }
+
+        blocks.clear();
+        blocks.reserve(size / record_size);
+        for (std::size_t i = 0; i < size / record_size; ++i)
+        {
+            uint8_t const* record = pos + i * record_size;
+            SummaryBlock block;
+            block.offset    = extract_data<int64_t>(record);
+            block.reference = nanoseconds{extract_data<int64_t>(record)};
+            block.begin     = nanoseconds{extract_data<int64_t>(record)};
+            block.end       = nanoseconds{extract_data<int64_t>(record)};
+            block.samples   = extract_data<uint64_t>(record);
+            block.period    = extract_stats(record);
+            block.up        = extract_stats(record);
+            blocks.push_back(block);
+        }
+        return true;
+    }
+
+    SummaryBlock merge_summary(std::vector<SummaryBlock> const& blocks, nanoseconds begin, nanoseconds end)
+    {
+        SummaryBlock merged;
+        for (auto const& block : blocks)
+        {
+            if (block.end < begin or block.begin > end)
+            {
+                continue;
+            }
+            merged.merge(block);
+        }
+        return merged;
+    }
+
+
+    SummaryBuilder::SummaryBuilder(uint64_t block_samples)
+        : block_samples_{std::max<uint64_t>(block_samples, 2)}
+    {
+
+    }
+
+    void SummaryBuilder::write(uint8_t const* data, std::size_t size)
+    {
+        int64_t const base = offset_;
+        offset_ += static_cast<int64_t>(size);
+
+        std::size_t used = 0;
+        while (not header_done_ and used < size)
+        {
+            std::size_t wanted = (header_size_ == 0) ? 16 : header_size_;
+            std::size_t missing = std::min(wanted - header_.size(), size - used);
+            header_.insert(header_.end(), data + used, data + used + missing);
+            used += missing;
+            if (header_.size() < wanted)
+            {
+                return;
+            }
+
+            if (header_size_ == 0)
+            {
+                uint64_t data_offset;
+                std::memcpy(&data_offset, header_.data() + 8, sizeof(data_offset));
+                header_size_ = std::max<std::size_t>(static_cast<std::size_t>(data_offset) + 8, 16);
+                continue;
+            }
+            parse_header();
+        }
+        if (not header_done_)
+        {
+            return;
+        }
+
+        // Complete the element left over by the previous write
+        if (not tail_.empty())
+        {
+            int64_t position = base - static_cast<int64_t>(tail_.size());
+            while (tail_.size() < sizeof(uint32_t) and used < size)
+            {
+                tail_.push_back(data[used++]);
+            }
+            if (tail_.size() < sizeof(uint32_t))
+            {
+                return;
+            }
+
+            uint32_t word;
+            std::memcpy(&word, tail_.data(), sizeof(word));
+            std::size_t missing = std::min(element_size(word) - tail_.size(), size - used);
+            tail_.insert(tail_.end(), data + used, data + used + missing);
+            used += missing;
+            if (tail_.size() < element_size(word))
+            {
+                return;
+            }
+
+            on_element(tail_.data(), position);
+            tail_.clear();
+        }
+
+        uint8_t const* pos = data + used;
+        uint8_t const* const end = data + size;
+        while (pos + sizeof(uint32_t) <= end)
+        {
+            uint32_t word;
+            std::memcpy(&word, pos, sizeof(word));
+            std::size_t elem_size = element_size(word);
+            if (pos + elem_size > end)
+            {
+                break;
+            }
+            on_element(pos, base + (pos - data));
+            pos += elem_size;
+        }
+        tail_.assign(pos, end);
+    }
+
+    void SummaryBuilder::parse_header()
+    {
+        header_done_ = true;
+
+        uint16_t major;
+        std::memcpy(&major, header_.data(), sizeof(major));
+        if (major < 2)
+        {
+            return;
+        }
+
+        // See build_tick_header(): the pointer follows the process and task names
+        std::size_t pos = 40;
+        for (int i = 0; i < 2; ++i)
+        {
+            if (pos + sizeof(uint16_t) > header_.size())
+            {
+                return;
+            }
+            uint16_t str_size;
+            std::memcpy(&str_size, header_.data() + pos, sizeof(str_size));
+            pos += sizeof(uint16_t) + str_size;
+        }
+        if (pos + sizeof(int64_t) <= header_.size())
+        {
+            footer_pointer_ = static_cast<int64_t>(pos);
+        }
+        header_.clear();
+        header_.shrink_to_fit();
+    }
+
+    void SummaryBuilder::on_element(uint8_t const* element, int64_t position)
+    {
+        uint32_t word;
+        std::memcpy(&word, element, sizeof(word));
+        ended_ = (word == (ESCAPE | Command::DATA_STREAM_END));
+
+        if (not open_)
+        {
+            if (ended_)
+            {
+                return;
+            }
+            open_ = true;
+            block_ = SummaryBlock{};
+            block_.offset = position;
+            block_.reference = reference_;
+        }
+
+        if (not (word & ESCAPE))
+        {
+            on_sample(reference_ + nanoseconds{word});
+            return;
+        }
+        if (word & Command::UPDATE_REFERENCE)
+        {
+            uint64_t reference;
+            std::memcpy(&reference, element + sizeof(uint32_t), sizeof(reference));
+            reference_ = nanoseconds{reference};
+            on_sample(reference_);
+            return;
+        }
+        if (ended_ and block_.samples > 0)
+        {
+            blocks_.push_back(block_);
+            open_ = false;
+        }
+    }
+
+    void SummaryBuilder::on_sample(nanoseconds sample)
+    {
+        if (block_.samples == 0)
+        {
+            block_.begin = sample;
+        }
+        block_.end = sample;
+        block_.samples++;
+
+        // Same series as Parser::generate_times_diff() and generate_times_up()
+        if (index_ % 2 == 0)
+        {
+            if (has_start_)
+            {
+                block_.period.add(sample - last_start_);
+            }
+            last_start_ = sample;
+            has_start_ = true;
+        }
+        else if (has_start_)
+        {
+            block_.up.add(sample - last_start_);
+        }
+        index_++;
+
+        if (index_ % 2 == 0 and block_.samples >= block_samples_)
+        {
+            blocks_.push_back(block_);
+            open_ = false;
+        }
+    }
+
+    std::vector<SummaryBlock> SummaryBuilder::finish()
+    {
+        if (open_ and block_.samples > 0)
+        {
+            blocks_.push_back(block_);
+        }
+        open_ = false;
+        return std::move(blocks_);
+    }
+
+
+    SummaryIO::SummaryIO(std::unique_ptr<AbstractIO> io, std::string path)
+        : io_{std::move(io)}
+        , path_{std::move(path)}
+    {
+        supported_modes_ = access::Mode::READ_ONLY     | access::Mode::WRITE_ONLY | access::Mode::READ_WRITE   |
+                           access::Mode::APPEND        | access::Mode::TRUNCATE   | access::Mode::UNBUFFERED   |
+                           access::Mode::NEW_ONLY      | access::Mode::EXISTING_ONLY | access::Mode::NON_BLOCKING |
+                           access::Mode::DIRECT;
+    }
+
+    SummaryIO::~SummaryIO()
+    {
+        if (is_open())
+        {
+            close();
+        }
+    }
+
+    int64_t SummaryIO::read(void* data, int64_t data_size)
+    {
+        return io_->read(data, data_size);
+    }
+
+    int64_t SummaryIO::write(void const* data, int64_t data_size)
+    {
+        int64_t written_size = io_->write(data, data_size);
+        if (written_size != data_size)
+        {
+            valid_ = false;
+        }
+        if (valid_)
+        {
+            builder_.write(static_cast<uint8_t const*>(data), static_cast<std::size_t>(data_size));
+        }
+        return written_size;
+    }
+
+    std::error_code SummaryIO::seek(int64_t pos)
+    {
+        valid_ = false;
+        return io_->seek(pos);
+    }
+
+    std::error_code SummaryIO::truncate(int64_t size)
+    {
+        valid_ = false;
+        return io_->truncate(size);
+    }
+
+    std::error_code SummaryIO::sync()
+    {
+        return io_->sync();
+    }
+
+    os_file SummaryIO::native_handle() const
+    {
+        os_file handle = io_->native_handle();
+        if (handle >= 0)
+        {
+            bypassed_ = true;
+        }
+        return handle;
+    }
+
+    std::error_code SummaryIO::do_open(access::Mode mode)
+    {
+        // Offsets are counted from the start of the file
+        valid_ = (mode & access::Mode::TRUNCATE) or (mode & access::Mode::NEW_ONLY);
+        return io_->open(mode);
+    }
+
+    std::error_code SummaryIO::do_close()
+    {
+        if (not valid_ or bypassed_ or not builder_.ended() or builder_.footer_pointer() < 0)
+        {
+            return io_->close();
+        }
+
+        TickMetadata metadata;
+        metadata.summary = builder_.finish();
+        auto footer = serialize_footer(metadata);
+        int64_t footer_offset = builder_.size();
+        int64_t written_size = io_->write(footer.data(), static_cast<int64_t>(footer.size()));
+
+        auto rc = io_->close();
+        if (rc or written_size != static_cast<int64_t>(footer.size()))
+        {
+            return rc;
+        }
+        return write_footer_pointer(footer_offset);
+    }
+
+    std::error_code SummaryIO::write_footer_pointer(int64_t footer_offset)
+    {
+        // Written last: a file cut before has no footer rather than a broken one
+        File file{path_};
+        auto rc = file.open(access::Mode::WRITE_ONLY | access::Mode::EXISTING_ONLY);
+        if (rc)
+        {
+            return rc;
+        }
+        rc = file.seek(builder_.footer_pointer());
+        if (rc)
+        {
+            return rc;
+        }
+        if (file.write(&footer_offset, sizeof(footer_offset)) != sizeof(footer_offset))
+        {
+            return from_errno(errno);
+        }
+        return file.close();
+    }
+}
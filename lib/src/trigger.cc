@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+
+#include "trigger.h"
+
+namespace rtm
+{
+    namespace
+    {
+        std::string format(char const* fmt, unsigned long a, unsigned long b = 0, unsigned long c = 0)
+        {
+            char text[96];
+            snprintf(text, sizeof(text), fmt, a, b, c);
+            return text;
+        }
+
+        // Start-to-start time off the announced period by more than percent %
+        bool is_miss(LoopTiming const& loop, uint64_t percent, nanoseconds& measured)
+        {
+            measured = loop.start - loop.previous_start;
+            nanoseconds off = measured > loop.period ? measured - loop.period : loop.period - measured;
+            return static_cast<uint64_t>(off.count()) * 100 > percent * static_cast<uint64_t>(loop.period.count());
+        }
+
+        bool has_period(LoopTiming const& loop)
+        {
+            return loop.has_previous and loop.period > 0ns;
+        }
+
+        class JitterCheck final : public TriggerCheck
+        {
+        public:
+            explicit JitterCheck(TriggerRule const& rule)
+                : threshold_(static_cast<int64_t>(rule.value))
+            { }
+
+            bool on_loop(LoopTiming const& loop) override
+            {
+                if (not loop.has_previous)
+                {
+                    return false;
+                }
+                measured_ = loop.start - loop.previous_start;
+                return measured_ > threshold_;
+            }
+
+            nanoseconds measured() const override { return measured_; }
+
+            std::string describe() const override
+            {
+                return format("jitter > %luns", static_cast<unsigned long>(threshold_.count()));
+            }
+
+        private:
+            nanoseconds threshold_;
+            nanoseconds measured_{0};
+        };
+
+        class UpTimeCheck final : public TriggerCheck
+        {
+        public:
+            explicit UpTimeCheck(TriggerRule const& rule)
+                : threshold_(static_cast<int64_t>(rule.value))
+            { }
+
+            bool on_loop(LoopTiming const& loop) override
+            {
+                measured_ = loop.end - loop.start;
+                return measured_ > threshold_;
+            }
+
+            nanoseconds measured() const override { return measured_; }
+
+            std::string describe() const override
+            {
+                return format("up time > %luns", static_cast<unsigned long>(threshold_.count()));
+            }
+
+        private:
+            nanoseconds threshold_;
+            nanoseconds measured_{0};
+        };
+
+        class PeriodDeviationCheck final : public TriggerCheck
+        {
+        public:
+            explicit PeriodDeviationCheck(TriggerRule const& rule)
+                : percent_(rule.value)
+            { }
+
+            bool on_loop(LoopTiming const& loop) override
+            {
+                if (not has_period(loop))
+                {
+                    return false;
+                }
+                return is_miss(loop, percent_, measured_);
+            }
+
+            nanoseconds measured() const override { return measured_; }
+
+            std::string describe() const override
+            {
+                return format("period deviation > %lu%%", static_cast<unsigned long>(percent_));
+            }
+
+        private:
+            uint64_t percent_;
+            nanoseconds measured_{0};
+        };
+
+        // Sliding window of miss flags: the count is updated with the flag entering and the one leaving.
+        class MissesCheck final : public TriggerCheck
+        {
+        public:
+            explicit MissesCheck(TriggerRule const& rule)
+                : percent_(rule.value)
+                , count_(rule.count)
+                , window_(rule.window, 0)
+            { }
+
+            bool on_loop(LoopTiming const& loop) override
+            {
+                if (not has_period(loop))
+                {
+                    return false;
+                }
+
+                uint8_t miss = is_miss(loop, percent_, measured_) ? 1 : 0;
+                misses_ -= window_[next_];
+                window_[next_] = miss;
+                misses_ += miss;
+                next_ = (next_ + 1) % window_.size();
+
+                return miss and misses_ >= count_;
+            }
+
+            nanoseconds measured() const override { return measured_; }
+
+            std::string describe() const override
+            {
+                return format("%lu misses (deviation > %lu%%) in %lu loops", count_,
+                              static_cast<unsigned long>(percent_), static_cast<unsigned long>(window_.size()));
+            }
+
+        private:
+            uint64_t percent_;
+            unsigned long count_;
+            std::vector<uint8_t> window_;
+            std::size_t next_{0};
+            unsigned long misses_{0};
+            nanoseconds measured_{0};
+        };
+
+        // Log-linear histogram of the up times of the last window loops: 4 buckets per power of two
+        // (at most 25% of error on the p99). The window holds bucket indexes, so a loop costs one
+        // increment, one decrement and a scan of the upper buckets (bounded, whatever the window).
+        class RollingP99Check final : public TriggerCheck
+        {
+        public:
+            explicit RollingP99Check(TriggerRule const& rule)
+                : percent_(rule.value)
+                , window_(rule.window, 0)
+            { }
+
+            bool on_loop(LoopTiming const& loop) override
+            {
+                measured_ = std::max(loop.end - loop.start, 0ns);
+                uint64_t up_time = static_cast<uint64_t>(measured_.count());
+
+                bool fired = false;
+                if (size_ == window_.size())
+                {
+                    fired = up_time * 100 > p99() * percent_;
+                    buckets_[window_[next_]]--;
+                }
+                else
+                {
+                    size_++;
+                }
+
+                uint8_t bucket = bucket_of(up_time);
+                buckets_[bucket]++;
+                window_[next_] = bucket;
+                next_ = (next_ + 1) % window_.size();
+
+                return fired;
+            }
+
+            nanoseconds measured() const override { return measured_; }
+
+            std::string describe() const override
+            {
+                return format("up time > %lu%% of its p99 over %lu loops",
+                              static_cast<unsigned long>(percent_), static_cast<unsigned long>(window_.size()));
+            }
+
+        private:
+            static uint8_t bucket_of(uint64_t value)
+            {
+                if (value < 4)
+                {
+                    return static_cast<uint8_t>(value);
+                }
+                unsigned msb = 63u - static_cast<unsigned>(__builtin_clzll(value));
+                uint64_t sub = (value >> (msb - 2)) & 3u;
+                return static_cast<uint8_t>(4 * (msb - 1) + sub);
+            }
+
+            static uint64_t upper_bound_of(std::size_t bucket)
+            {
+                if (bucket < 4)
+                {
+                    return bucket + 1;
+                }
+                std::size_t msb = bucket / 4 + 1;
+                uint64_t sub = bucket % 4;
+                return (4 + sub + 1) << (msb - 2);
+            }
+
+            // Upper bound of the bucket holding the 99th percentile
+            uint64_t p99() const
+            {
+                std::size_t above = size_ / 100; // loops allowed above the p99
+                std::size_t cumulative = 0;
+                for (std::size_t bucket = buckets_.size(); bucket-- > 0;)
+                {
+                    cumulative += buckets_[bucket];
+                    if (cumulative > above)
+                    {
+                        return upper_bound_of(bucket);
+                    }
+                }
+                return 0;
+            }
+
+            uint64_t percent_;
+            std::vector<uint8_t> window_;
+            std::size_t next_{0};
+            std::size_t size_{0};
+            std::array<uint32_t, 256> buckets_{};
+            nanoseconds measured_{0};
+        };
+    }
+
+    std::unique_ptr<TriggerCheck> make_trigger_check(TriggerRule const& rule)
+    {
+        if (rule.value == 0)
+        {
+            return nullptr;
+        }
+
+        switch (rule.kind)
+        {
+            case TriggerKind::JITTER:           return std::make_unique<JitterCheck>(rule);
+            case TriggerKind::UP_TIME:          return std::make_unique<UpTimeCheck>(rule);
+            case TriggerKind::PERIOD_DEVIATION: return std::make_unique<PeriodDeviationCheck>(rule);
+            case TriggerKind::MISSES:
+            {
+                if (rule.window == 0 or rule.window > TriggerEngine::MAX_WINDOW
+                    or rule.count == 0 or rule.count > rule.window)
+                {
+                    return nullptr;
+                }
+                return std::make_unique<MissesCheck>(rule);
+            }
+            case TriggerKind::ROLLING_P99:
+            {
+                if (rule.window < 100 or rule.window > TriggerEngine::MAX_WINDOW)
+                {
+                    return nullptr;
+                }
+                return std::make_unique<RollingP99Check>(rule);
+            }
+        }
+        return nullptr;
+    }
+
+    bool TriggerEngine::set(TriggerRule const& rule)
+    {
+        auto it = std::find_if(checks_.begin(), checks_.end(),
+            [&rule](Entry const& entry)
+            {
+                return entry.kind == rule.kind;
+            });
+
+        if (rule.value == 0)
+        {
+            if (it != checks_.end())
+            {
+                checks_.erase(it);
+            }
+            return true;
+        }
+
+        auto check = make_trigger_check(rule);
+        if (check == nullptr)
+        {
+            return false;
+        }
+
+        if (it != checks_.end())
+        {
+            it->check = std::move(check);
+        }
+        else
+        {
+            checks_.push_back({rule.kind, std::move(check)});
+        }
+        return true;
+    }
+
+    bool TriggerEngine::has(TriggerKind kind) const
+    {
+        return std::any_of(checks_.begin(), checks_.end(),
+            [kind](Entry const& entry)
+            {
+                return entry.kind == kind;
+            });
+    }
+
+    TriggerCheck const* TriggerEngine::on_loop(LoopTiming const& loop)
+    {
+        TriggerCheck const* fired = nullptr;
+        for (auto& entry : checks_)
+        {
+            if (entry.check->on_loop(loop) and fired == nullptr)
+            {
+                fired = entry.check.get();
+            }
+        }
+        return fired;
+    }
+}
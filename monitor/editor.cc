@@ -13,7 +13,7 @@ namespace rtm
     {
         TickMetadata build_metadata(CurveInfo const& curve)
         {
-            TickMetadata meta;
+            TickMetadata meta = curve.metadata;
             meta.display_name = curve.diff->display_name();
             meta.default_visibility = curve.default_visible;
             meta.display_weight = curve.diff->display_weight();
@@ -52,11 +52,11 @@ namespace rtm
     {
     }
 
-    void Editor::add_curve(std::string const& path, TickHeader const& header,
+    void Editor::add_curve(std::string const& path, TickHeader const& header, TickMetadata const& metadata,
                            std::shared_ptr<Serie> diff, std::shared_ptr<Serie> up,
                            bool default_visible)
     {
-        curves_.push_back({path, header, std::move(diff), std::move(up), default_visible});
+        curves_.push_back({path, header, metadata, std::move(diff), std::move(up), default_visible});
     }
 
     void Editor::draw()
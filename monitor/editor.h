@@ -14,6 +14,9 @@ namespace rtm
     {
         std::string path;
         TickHeader header;
+        // Footer as parsed: the editable fields are overridden on save, the rest
+        // (the recorder's summary index) is written back as is.
+        TickMetadata metadata;
         std::shared_ptr<Serie> diff;
         std::shared_ptr<Serie> up;
         bool default_visible = true;
@@ -27,7 +30,7 @@ namespace rtm
     public:
         Editor(Plot& diff, Plot& up);
 
-        void add_curve(std::string const& path, TickHeader const& header,
+        void add_curve(std::string const& path, TickHeader const& header, TickMetadata const& metadata,
                        std::shared_ptr<Serie> diff, std::shared_ptr<Serie> up,
                        bool default_visible = true);
         void draw();
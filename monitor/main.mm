@@ -42,6 +42,12 @@ int main(int argc, char* argv[])
     parser.add_argument("inputs")
         .help("files (.tick), folders, or glob patterns — defaults to current directory")
         .nargs(argparse::nargs_pattern::any);
+    parser.add_argument("--last")
+        .help("load only the last N seconds of each file")
+        .scan<'g', double>();
+    parser.add_argument("--follow")
+        .help("extend the curves as the files grow (i.e. while being recorded)")
+        .flag();
 
     try
     {
@@ -155,6 +161,11 @@ int main(int argc, char* argv[])
     float clear_color[4] = {0.45f, 0.55f, 0.60f, 1.00f};
 
     rtm::MainWindow main_window;
+    if (auto last = parser.present<double>("--last"))
+    {
+        main_window.set_time_range(-std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(*last)), {});
+    }
+    main_window.set_follow(parser.get<bool>("--follow"));
     main_window.load_dataset(inputs);
 
     // Main loop
@@ -215,6 +226,7 @@ int main(int argc, char* argv[])
     }
 
     // Cleanup
+    main_window.set_follow(false); // its watcher wakes the event loop
     ImGui_ImplMetal_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -1,52 +1,263 @@
 #include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include "rtm/parser.h"
 #include "rtm/metadata.h"
 #include "rtm/io/file.h"
+#include "rtm/io/mapped_file.h"
+#include "rtm/lod_cache.h"
 
+#include "activity.h"
 #include "main_window.h"
 #include "editor.h"
 
 namespace rtm
 {
-    int MainWindow::load_file(std::string const& path)
+    MainWindow::LoadedFile MainWindow::prepare_file(std::string const& path, ImVec4 color, std::size_t threads,
+                                                    nanoseconds begin, nanoseconds end, bool follow)
     {
-        auto io = std::make_unique<rtm::File>(path.c_str());
+        LoadedFile file;
+        file.path = path;
+
+        // A mapping does not see the bytes appended after it: follow with plain reads
+        std::unique_ptr<AbstractIO> io;
+        if (follow)
+        {
+            io = std::make_unique<rtm::File>(path);
+        }
+        else
+        {
+            io = std::make_unique<rtm::MappedFile>(path);
+        }
         io->open(access::Mode::READ_ONLY);
-        Parser p{std::move(io)};
+        auto parser = std::make_unique<Parser>(std::move(io));
+        Parser& p = *parser;
         p.load_header();
 
         if (p.header().major < PROTOCOL_MAJOR)
         {
-            return PROTOCOL_MAJOR - p.header().major;
+            file.outdated = PROTOCOL_MAJOR - p.header().major;
+            return file;
         }
 
         p.print_header();
-        if (not p.load_samples())
+        p.load_metadata(); // first: its summary index splits (or skips) the decoding
+
+        // Everything but the series
+        auto fill = [&](LodContent const& content)
+        {
+            file.header   = p.header();
+            file.header.sentinel_pos = content.sentinel_pos;
+            file.metadata = p.metadata();
+            file.diff_min = content.diff.min;
+            file.diff_max = content.diff.max;
+            file.up_min   = content.up.min;
+            file.up_max   = content.up.max;
+            file.begin    = content.begin;
+            file.end      = content.end;
+        };
+
+        // Whole files are cached once decoded and downsampled: reopened, they are neither
+        bool const cached = not follow and begin == 0ns and end == 0ns;
+        LodKey key;
+        if (cached)
+        {
+            key = LodCache::key_of(path, p.header().uuid, Serie::DECIMATION);
+            LodCache cache;
+            if (not cache.open(path, key))
+            {
+                auto const& content = cache.content();
+                fill(content);
+                file.diff = std::make_shared<Serie>(file.header.original_name, content.diff, color);
+                file.up   = std::make_shared<Serie>(file.header.original_name, content.up, color);
+                return file;
+            }
+        }
+
+        TickSeries series;
+        bool loaded = false;
+        if (follow)
+        {
+            loaded = p.poll_samples() > 0;
+        }
+        else if (begin != 0ns or end != 0ns)
+        {
+            loaded = p.load_samples(begin, end);
+        }
+        else if (threads > 1 or threads == 0)
+        {
+            loaded = p.load_samples_parallel(threads); // few files: the wall time matters most
+        }
+        else
+        {
+            loaded = p.load_series(series); // many files at once: the peak memory matters most
+        }
+        if (not loaded and not follow) // a followed file may still be empty
         {
             printf("Empty file, skipping.\n");
-            return 0;
+            return file;
         }
-        p.load_metadata();
-        auto color = generate_random_color();
-        auto const& header = p.header();
-        auto const& meta = p.metadata();
+        if (not p.samples().empty())
+        {
+            series.diff = p.generate_times_diff();
+            series.up   = p.generate_times_up();
+        }
+        auto diff_overview = lttb(series.diff, Serie::DECIMATION);
+        auto up_overview   = lttb(series.up, Serie::DECIMATION);
+
+        std::string const& name = p.header().original_name;
+        file.diff = std::make_shared<Serie>(name, PointSpan{series.diff.data(), series.diff.size()},
+                                            PointSpan{diff_overview.data(), diff_overview.size()}, color);
+        file.up   = std::make_shared<Serie>(name, PointSpan{series.up.data(), series.up.size()},
+                                            PointSpan{up_overview.data(), up_overview.size()}, color);
+
+        // The cache holds the series as they are built: reopened, they are copied as is
+        LodContent content;
+        content.begin        = p.begin();
+        content.end          = p.end();
+        content.sentinel_pos = p.header().sentinel_pos;
+        content.dropped      = p.dropped();
+        content.diff         = file.diff->lod();
+        content.diff.min     = p.diff_min();
+        content.diff.max     = p.diff_max();
+        content.up           = file.up->lod();
+        content.up.min       = p.up_min();
+        content.up.max       = p.up_max();
+        fill(content);
+
+        if (cached)
+        {
+            auto rc = LodCache::write(path, key, content);
+            if (rc)
+            {
+                printf("Cannot write the cache of %s: %s\n", path.c_str(), rc.message().c_str());
+            }
+        }
+        if (follow)
+        {
+            file.parser = std::move(parser);
+        }
+        return file;
+    }
+
+    int MainWindow::add_file(LoadedFile&& file)
+    {
+        if (file.outdated > 0 or not file.diff)
+        {
+            return file.outdated;
+        }
+
+        auto const& meta = file.metadata;
         bool visible = meta.default_visibility;
 
-        auto diff = std::make_shared<Serie>(header.original_name, p.generate_times_diff(), color);
-        diff->set_display_name(meta.display_name);
-        diff->set_display_weight(meta.display_weight);
-        diff_.add_serie(diff, p.diff_min(), p.diff_max(), p.begin(), p.end(), visible);
+        file.diff->set_display_name(meta.display_name);
+        file.diff->set_display_weight(meta.display_weight);
+        diff_.add_serie(file.diff, file.diff_min, file.diff_max, file.begin, file.end, visible);
+
+        file.up->set_display_name(meta.display_name);
+        file.up->set_display_weight(meta.display_weight);
+        up_.add_serie(file.up, file.up_min, file.up_max, file.begin, file.end, visible);
 
-        auto up = std::make_shared<Serie>(header.original_name, p.generate_times_up(), color);
-        up->set_display_name(meta.display_name);
-        up->set_display_weight(meta.display_weight);
-        up_.add_serie(up, p.up_min(), p.up_max(), p.begin(), p.end(), visible);
+        if (file.parser)
+        {
+            followed_.push_back({std::move(file.parser), file.diff, file.up});
+            {
+                std::lock_guard<std::mutex> lock(follow_mutex_);
+                followed_paths_.push_back(file.path);
+            }
+            if (not follow_thread_.joinable())
+            {
+                follow_stop_ = false;
+                follow_thread_ = std::thread(&MainWindow::watch_files, this);
+            }
+        }
 
-        editor_.add_curve(path, header, std::move(diff), std::move(up), visible);
+        editor_.add_curve(file.path, file.header, meta, std::move(file.diff), std::move(file.up), visible);
         return 0;
     }
 
+    int MainWindow::load_file(std::string const& path)
+    {
+        return add_file(prepare_file(path, generate_random_color(), 0, range_begin_, range_end_, follow_));
+    }
+
+    MainWindow::~MainWindow()
+    {
+        set_follow(false);
+    }
+
+    void MainWindow::set_follow(bool enable)
+    {
+        follow_ = enable;
+        if (enable or not follow_thread_.joinable())
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(follow_mutex_);
+            follow_stop_ = true;
+        }
+        follow_cv_.notify_all();
+        follow_thread_.join();
+    }
+
+    void MainWindow::watch_files()
+    {
+        // Polled sizes rather than inotify: portable, and a tick file grows by small writes at a
+        // high rate, far more often than the curves need to be refreshed anyway.
+        std::vector<std::uintmax_t> sizes;
+        std::unique_lock<std::mutex> lock(follow_mutex_);
+        while (not follow_stop_)
+        {
+            sizes.resize(followed_paths_.size(), 0);
+            bool grown = false;
+            for (std::size_t i = 0; i < followed_paths_.size(); ++i)
+            {
+                std::error_code ec;
+                std::uintmax_t size = std::filesystem::file_size(followed_paths_[i], ec);
+                if (not ec and size != sizes[i])
+                {
+                    sizes[i] = size;
+                    grown = true;
+                }
+            }
+            if (grown)
+            {
+                followed_grown_ = true;
+                request_redraw();
+            }
+            follow_cv_.wait_for(lock, FOLLOW_PERIOD, [this]() { return follow_stop_; });
+        }
+    }
+
+    void MainWindow::poll_followed()
+    {
+        if (not followed_grown_.exchange(false))
+        {
+            return;
+        }
+
+        for (auto& followed : followed_)
+        {
+            Parser& p = *followed.parser;
+            std::size_t from = p.samples().size();
+            if (p.poll_samples() == 0)
+            {
+                continue;
+            }
+            diff_.extend_serie(*followed.diff, p.generate_times_diff(from), p.diff_min(), p.diff_max(), p.end());
+            up_.extend_serie(*followed.up, p.generate_times_up(from), p.up_min(), p.up_max(), p.end());
+        }
+    }
+
+    void MainWindow::set_time_range(nanoseconds begin, nanoseconds end)
+    {
+        range_begin_ = begin;
+        range_end_   = end;
+    }
+
     void MainWindow::load_dataset(std::vector<std::filesystem::path> const& inputs)
     {
         std::vector<std::string> detected_files;
@@ -68,11 +279,44 @@ namespace rtm
         std::sort(detected_files.begin(), detected_files.end());
         detected_files.erase(std::unique(detected_files.begin(), detected_files.end()), detected_files.end());
 
-        for (auto const& entry : detected_files)
+        // Files are parsed and preprocessed on a worker pool, then added here in the sorted
+        // order. Colors are drawn upfront for the same reason: the result does not depend
+        // on which worker finishes first.
+        std::size_t const cores = std::max(1u, std::thread::hardware_concurrency());
+        std::size_t const workers_count = std::min(cores, detected_files.size());
+        std::size_t const threads_per_file = std::max<std::size_t>(1, cores / std::max<std::size_t>(1, detected_files.size()));
+
+        std::vector<ImVec4> colors;
+        for (std::size_t i = 0; i < detected_files.size(); ++i)
+        {
+            colors.push_back(generate_random_color());
+        }
+
+        std::vector<LoadedFile> loaded(detected_files.size());
+        std::atomic<std::size_t> next{0};
+        auto worker = [&]()
+        {
+            for (std::size_t i = next++; i < detected_files.size(); i = next++)
+            {
+                loaded[i] = prepare_file(detected_files[i], colors[i], threads_per_file, range_begin_, range_end_, follow_);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (std::size_t i = 0; i < workers_count; ++i)
+        {
+            workers.emplace_back(worker);
+        }
+        for (auto& w : workers)
+        {
+            w.join();
+        }
+
+        for (std::size_t i = 0; i < loaded.size(); ++i)
         {
-            if (load_file(entry) > 0)
+            if (add_file(std::move(loaded[i])) > 0)
             {
-                pending_migration_.push_back(entry);
+                pending_migration_.push_back(detected_files[i]);
             }
         }
 
@@ -142,6 +386,7 @@ namespace rtm
     void MainWindow::draw()
     {
         draw_migration_modal();
+        poll_followed();
 
         if (ImGui::BeginMenuBar())
         {
@@ -1,7 +1,13 @@
 #ifndef RTM_MONITOR_MAIN_WINDOW_H
 #define RTM_MONITOR_MAIN_WINDOW_H
 
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include "editor.h"
 #include "plot.h"
@@ -11,18 +17,71 @@ namespace rtm
     class MainWindow
     {
     public:
+        ~MainWindow();
+
         void load_dataset(std::vector<std::filesystem::path> const& inputs);
 
+        // Range of the files to load, see Parser::load_samples(begin, end). Default: all.
+        void set_time_range(nanoseconds begin, nanoseconds end);
+
+        // Follow the files as they grow (i.e. while being recorded): the curves are extended with
+        // the appended samples. Whole files are loaded, the time range is ignored. Disabling it
+        // stops the watcher thread: do it before the window system is released.
+        void set_follow(bool enable);
+
         void draw();
 
     private:
+        // A file parsed and preprocessed (series downsampled and split) by prepare_file()
+        struct LoadedFile
+        {
+            std::string path;
+            int outdated{0};        // > 0: older protocol, see load_file()
+            TickHeader header{};
+            TickMetadata metadata{};
+            std::shared_ptr<Serie> diff{};
+            std::shared_ptr<Serie> up{};
+            milliseconds_f diff_min{}, diff_max{};
+            milliseconds_f up_min{}, up_max{};
+            nanoseconds begin{}, end{};
+            std::unique_ptr<Parser> parser{};   // kept to poll the file in follow mode
+        };
+
+        // Thread-safe: touches no member. threads: decoding threads of the file (0: one per core)
+        static LoadedFile prepare_file(std::string const& path, ImVec4 color, std::size_t threads,
+                                       nanoseconds begin, nanoseconds end, bool follow);
+
+        // UI thread only. Returns the protocol major versions the file is behind (0 when added)
+        int add_file(LoadedFile&& file);
         int load_file(std::string const& path);
         void draw_migration_modal();
 
+        // Follow mode: a thread watches the file sizes, the UI thread decodes what was appended
+        void watch_files();
+        void poll_followed();
+
         Plot diff_{"Times Diff", "jitter (ms)"};
         Plot up_  {"Times Up",   "up time (ms)"};
         Editor editor_{diff_, up_};
         std::vector<std::string> pending_migration_;
+        nanoseconds range_begin_{0};
+        nanoseconds range_end_{0};
+
+        struct FollowedFile
+        {
+            std::unique_ptr<Parser> parser;
+            std::shared_ptr<Serie> diff;
+            std::shared_ptr<Serie> up;
+        };
+        static constexpr std::chrono::milliseconds FOLLOW_PERIOD = 500ms;
+        bool follow_{false};
+        std::vector<FollowedFile> followed_;
+        std::vector<std::string> followed_paths_;   // guarded by follow_mutex_
+        std::atomic<bool> followed_grown_{false};
+        bool follow_stop_{false};                   // guarded by follow_mutex_
+        std::mutex follow_mutex_;
+        std::condition_variable follow_cv_;
+        std::thread follow_thread_;
     };
 }
 
@@ -72,6 +72,28 @@ namespace rtm
         serie_bounds_.push_back({seconds_f(begin), seconds_f(end), min_y, max_y, visible});
     }
 
+    void Plot::extend_serie(Serie& serie, std::vector<Point> const& points, milliseconds_f min_y, milliseconds_f max_y, nanoseconds end)
+    {
+        auto it = std::find_if(series_.begin(), series_.end(), [&](auto const& s) { return s.get() == &serie; });
+        if (it == series_.end())
+        {
+            return;
+        }
+
+        // The statistics are computed on the series in the background: wait for them first
+        if (stats_future_.valid())
+        {
+            stats_ = stats_future_.get();
+        }
+        serie.append(points);
+
+        auto& bounds = serie_bounds_[static_cast<std::size_t>(it - series_.begin())];
+        bounds.end = seconds_f(end);
+        bounds.min_y = std::min(bounds.min_y, min_y);
+        bounds.max_y = std::max(bounds.max_y, max_y);
+        old_limits_ = {}; // the visible range may have new points: update the statistics
+    }
+
     bool Plot::compute_visible_limits(double& x_min, double& x_max,
                                       double& y_min, double& y_max) const
     {
@@ -308,7 +330,7 @@ namespace rtm
                     auto limits = ImPlot::GetPlotLimits();
 
                     const rtm::Serie* closest_serie = nullptr;
-                    const Point* closest_point = nullptr;
+                    std::optional<Point> closest_point;
                     double best_dx = std::numeric_limits<double>::max();
 
                     for (std::size_t i = 0; i < series_.size(); ++i) 
@@ -316,7 +338,7 @@ namespace rtm
                         if (not serie_bounds_[i].visible)
                             continue;
 
-                        Point const* pt = series_[i]->find_nearest(mouse.x, limits);
+                        auto pt = series_[i]->find_nearest(mouse.x, limits);
                         if (pt)
                         {
                             double dx = std::abs(pt->x - mouse.x);
@@ -18,6 +18,9 @@ namespace rtm
         void add_serie(std::shared_ptr<Serie> serie, milliseconds_f min_y, milliseconds_f max_y, nanoseconds begin, nanoseconds end, bool visible = true);
         void sort_series();
 
+        // Appends points to a serie of this plot (see Serie::append()) and extends its bounds
+        void extend_serie(Serie& serie, std::vector<Point> const& points, milliseconds_f min_y, milliseconds_f max_y, nanoseconds end);
+
         void draw();
 
     private:
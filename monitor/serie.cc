@@ -24,65 +24,133 @@ namespace rtm
     }
 
 
-    void Serie::split_serie(std::vector<Section>& sections, std::vector<Point> const& flat)
+    void Serie::split_serie(std::vector<Section>& sections, PointSpan flat)
     {
-        Section section;
-        seconds_f min = seconds_f{flat.front().x};
-        seconds_f max = min + SECTION_SIZE;
-        for (auto const& point : flat)
+        // Sections are sized in time: count their points first, so that each is allocated once
+        auto section_end = [&](std::size_t first, seconds_f max)
         {
-            while (point.x >= max.count())
+            std::size_t last = first;
+            while (last < flat.size and flat.data[last].x < max.count())
             {
-                if (not section.points.empty())
-                {
-                    section.min = min;
-                    section.max = max;
-                    sections.emplace_back(std::move(section));
-                    section = Section{};
-                }
-
-                min += SECTION_SIZE;
-                max += SECTION_SIZE;
+                ++last;
             }
-            section.points.push_back(point);
-        }
+            return last;
+        };
 
-        if (not section.points.empty())
+        seconds_f min = seconds_f{flat.data[0].x};
+        seconds_f max = min + SECTION_SIZE;
+        std::size_t first = 0;
+        while (first < flat.size)
         {
-            section.min = min;
-            section.max = seconds_f{section.points.back().x};
-            sections.emplace_back(std::move(section));
+            std::size_t last = section_end(first, max);
+            if (last > first)
+            {
+                sections.push_back({min, max, Columns{flat.data + first, flat.data + last}});
+                first = last;
+            }
+
+            min += SECTION_SIZE;
+            max += SECTION_SIZE;
         }
+
+        sections.back().max = seconds_f{flat.data[flat.size - 1].x};
     }
 
 
-    Serie::Serie(std::string const& name, std::vector<Point>&& raw_serie, ImVec4 color)
+    Serie::Serie(std::string const& name, PointSpan points, PointSpan overview, ImVec4 color)
     {
-        constexpr uint32_t DECIMATION = 8'000;
-
         nanoseconds t1 = since_epoch();
 
-        if (not raw_serie.empty())
+        if (not points.empty())
         {
-            split_serie(sections_, raw_serie);
+            split_serie(sections_, points);
         }
 
-        //serie_ = minmax_downsampler(diffs_full_, DECIMATION);
-        serie_ = lttb(raw_serie, DECIMATION);
-        //serie_ = minmax_lttb(diffs_full_, DECIMATION);
+        serie_ = Columns{overview.begin(), overview.end()};
 
-        if (serie_.size() != raw_serie.size())
+        if (serie_.size() != points.size)
         {
             is_downsampled_ = true;
+            stride_ = (points.size + serie_.size() - 1) / std::max<std::size_t>(1, serie_.size());
         }
 
         nanoseconds t2 = since_epoch();
-        printf("loaded in %f ms (%ld)\n", duration_cast<milliseconds_f>(t2 - t1).count(), raw_serie.size());
+        printf("loaded in %f ms (%ld)\n", duration_cast<milliseconds_f>(t2 - t1).count(), points.size);
+
+        name_   = name;
+        color_  = color;
+    }
+
+    Serie::Serie(std::string const& name, LodSerie const& cached, ImVec4 color)
+    {
+        std::size_t size = 0;
+        sections_.reserve(cached.sections.size());
+        for (auto const& section : cached.sections)
+        {
+            sections_.push_back({seconds_f{section.min}, seconds_f{section.max}, Columns{section.points}});
+            size += section.points.size;
+        }
+
+        serie_ = Columns{cached.overview};
+        if (serie_.size() != size)
+        {
+            is_downsampled_ = true;
+            stride_ = (size + serie_.size() - 1) / std::max<std::size_t>(1, serie_.size());
+        }
 
         name_   = name;
         color_  = color;
     }
 
+    LodSerie Serie::lod() const
+    {
+        LodSerie lod;
+        lod.sections.reserve(sections_.size());
+        for (auto const& section : sections_)
+        {
+            lod.sections.push_back({section.min.count(), section.max.count(), section.points.span()});
+        }
+        lod.overview = serie_.span();
+        return lod;
+    }
+
+    void Serie::append(std::vector<Point> const& points)
+    {
+        for (auto const& point : points)
+        {
+            if (sections_.empty())
+            {
+                sections_.push_back({seconds_f{point.x}, seconds_f{point.x}, Columns{}});
+            }
+            else if (point.x >= (sections_.back().min + SECTION_SIZE).count())
+            {
+                // Same windows as split_serie(): the previous section is closed on its window
+                seconds_f min = sections_.back().min + SECTION_SIZE;
+                sections_.back().max = min;
+                while (point.x >= (min + SECTION_SIZE).count())
+                {
+                    min += SECTION_SIZE;
+                }
+                sections_.push_back({min, seconds_f{point.x}, Columns{}});
+            }
+            sections_.back().points.push_back(point);
+            sections_.back().max = seconds_f{point.x};
+
+            if (++skipped_ >= stride_)
+            {
+                serie_.push_back(point);
+                skipped_ = 0;
+            }
+            if (serie_.size() >= 2 * DECIMATION)
+            {
+                // Bounded overview: plain decimation, as it grows
+                serie_.decimate();
+                stride_ *= 2;
+                is_downsampled_ = true;
+            }
+        }
+    }
+
     std::string const& Serie::name() const
     {
         if (display_name_.empty())
@@ -100,27 +168,32 @@ namespace rtm
         return label;
     }
 
-    void Serie::plot_visible(ImPlotRect const& limits, Point const* data, int count) const
+    void Serie::plot_visible(ImPlotRect const& limits, Columns const& points) const
     {
-        auto begin = data;
-        auto end   = data + count;
+        std::size_t vis_begin = points.lower_bound(limits.X.Min);
+        std::size_t vis_end   = points.upper_bound(limits.X.Max);
 
-        Point lo{limits.X.Min, 0};
-        Point hi{limits.X.Max, 0};
-        auto cmp = [](Point const& a, Point const& b) { return a.x < b.x; };
+        if (vis_begin != 0)             --vis_begin;
+        if (vis_end   != points.size()) ++vis_end;
 
-        auto vis_begin = std::lower_bound(begin, end, lo, cmp);
-        auto vis_end   = std::upper_bound(vis_begin, end, hi, cmp);
+        if (vis_end <= vis_begin)
+        {
+            return;
+        }
 
-        if (vis_begin != begin) --vis_begin;
-        if (vis_end   != end)   ++vis_end;
+        struct Range
+        {
+            Columns const* points;
+            std::size_t first;
+        } range{&points, vis_begin};
 
-        int vis_count = static_cast<int>(vis_end - vis_begin);
-        if (vis_count > 0)
+        auto getter = [](int idx, void* data)
         {
-            ImPlot::PlotLine(plot_id().c_str(), &vis_begin->x, &vis_begin->y,
-                vis_count, 0, 0, sizeof(Point));
-        }
+            auto const* r = static_cast<Range const*>(data);
+            std::size_t i = r->first + static_cast<std::size_t>(idx);
+            return ImPlotPoint(r->points->x(i), r->points->y(i));
+        };
+        ImPlot::PlotLineG(plot_id().c_str(), getter, &range, static_cast<int>(vis_end - vis_begin));
     }
 
     bool Serie::plot() const
@@ -137,7 +210,7 @@ namespace rtm
 
         if (not is_downsampled_)
         {
-            plot_visible(limits, serie_.data(), static_cast<int>(serie_.size()));
+            plot_visible(limits, serie_);
             return is_downsampled_;
         }
 
@@ -158,7 +231,7 @@ namespace rtm
 
             for (int i = 0; i < 3; ++i)
             {
-                plot_visible(limits, it->points.data(), static_cast<int>(it->points.size()));
+                plot_visible(limits, it->points);
 
                 it++;
                 if (it == sections_.end())
@@ -171,51 +244,47 @@ namespace rtm
         }
         else
         {
-            plot_visible(limits, serie_.data(), static_cast<int>(serie_.size()));
+            plot_visible(limits, serie_);
             return is_downsampled_;
         }
     }
 
 
-    static Point const* nearest_in(Point const* data, int count, double x)
+    static std::optional<Point> nearest_in(Columns const& points, double x)
     {
-        if (count == 0)
+        if (points.empty())
         {
-            return nullptr;
+            return std::nullopt;
         }
 
-        Point target{x, 0};
-        auto cmp = [](Point const& a, Point const& b) { return a.x < b.x; };
-        auto it = std::lower_bound(data, data + count, target, cmp);
-
-        int idx = static_cast<int>(it - data);
-        int start = std::max(0, idx - 1);
-        int end = std::min(count, idx + 2);
+        std::size_t idx = points.lower_bound(x);
+        std::size_t start = (idx > 0) ? idx - 1 : 0;
+        std::size_t end = std::min(points.size(), idx + 2);
 
-        Point const* best = nullptr;
+        std::optional<Point> best;
         double best_dx = std::numeric_limits<double>::max();
-        for (int i = start; i < end; ++i)
+        for (std::size_t i = start; i < end; ++i)
         {
-            double dx = std::abs(data[i].x - x);
+            double dx = std::abs(points.x(i) - x);
             if (dx < best_dx)
             {
                 best_dx = dx;
-                best = &data[i];
+                best = points.at(i);
             }
         }
         return best;
     }
 
-    Point const* Serie::find_nearest(double x, ImPlotRect const& limits) const
+    std::optional<Point> Serie::find_nearest(double x, ImPlotRect const& limits) const
     {
         if (serie_.empty())
         {
-            return nullptr;
+            return std::nullopt;
         }
 
         if (not is_downsampled_ or limits.X.Size() >= SECTION_SIZE.count())
         {
-            return nearest_in(serie_.data(), static_cast<int>(serie_.size()), x);
+            return nearest_in(serie_, x);
         }
 
         // Zoomed in: search the same sections that plot() displays
@@ -232,12 +301,11 @@ namespace rtm
             it--;
         }
 
-        Point const* best = nullptr;
+        std::optional<Point> best;
         double best_dx = std::numeric_limits<double>::max();
         for (int i = 0; i < 3; ++i)
         {
-            Point const* candidate = nearest_in(it->points.data(),
-                static_cast<int>(it->points.size()), x);
+            auto candidate = nearest_in(it->points, x);
             if (candidate)
             {
                 double dx = std::abs(candidate->x - x);
@@ -299,20 +367,16 @@ namespace rtm
         auto const& first_section = it_first->points;
         auto const& last_section  = it_last->points;
 
-        Point begin_pt{begin, 0};
-        Point end_pt{end, 0};
-        auto pt_cmp = [](Point const& a, Point const& b) { return a.x < b.x; };
-
-        auto first_point = std::lower_bound(first_section.begin(), first_section.end(), begin_pt, pt_cmp);
-        if (first_point == first_section.end())
+        std::size_t first_point = first_section.lower_bound(begin);
+        if (first_point == first_section.size())
         {
-            first_point = first_section.begin();
+            first_point = 0;
         }
 
-        auto last_point = std::lower_bound(last_section.begin(), last_section.end(), end_pt, pt_cmp);
-        if (last_point == last_section.end())
+        std::size_t last_point = last_section.lower_bound(end);
+        if (last_point == last_section.size())
         {
-            last_point = last_section.end() - 1;
+            last_point = last_section.size() - 1;
         }
 
         Statistics stats;
@@ -323,14 +387,15 @@ namespace rtm
         stats.min = std::numeric_limits<double>::max();
         stats.max = std::numeric_limits<double>::lowest();
 
-        auto compute_section = [&](std::vector<Point>::const_iterator section_begin, std::vector<Point>::const_iterator section_end)
+        auto compute_section = [&](Columns const& points, std::size_t section_begin, std::size_t section_end)
         {
-            for (auto it = section_begin; it != section_end; ++it)
+            for (std::size_t i = section_begin; i < section_end; ++i)
             {
-                stats.min = std::min(stats.min, it->y);
-                stats.max = std::max(stats.max, it->y);
-                accumulated += it->y;
-                square_accumulated += (it->y * it->y);
+                double y = points.y(i);
+                stats.min = std::min(stats.min, y);
+                stats.max = std::max(stats.max, y);
+                accumulated += y;
+                square_accumulated += (y * y);
                 ++range_size;
             }
         };
@@ -352,21 +417,21 @@ namespace rtm
         if (it_first == it_last)
         {
             // only one section
-            compute_section(first_point, last_point);
+            compute_section(first_section, first_point, last_point);
             return finalize();
         }
 
         // first section (partial)
-        compute_section(first_point, first_section.end());
+        compute_section(first_section, first_point, first_section.size());
 
         // middle section(s) (full)
         for (auto it_section = it_first + 1; it_section != it_last; ++it_section)
         {
-            compute_section(it_section->points.begin(), it_section->points.end());
+            compute_section(it_section->points, 0, it_section->points.size());
         }
 
         // last section (partial)
-        compute_section(last_section.begin(), last_point);
+        compute_section(last_section, 0, last_point);
 
         return finalize();
     }
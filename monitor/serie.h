@@ -3,9 +3,12 @@
 
 #include <imgui.h>
 #include <implot.h>
+#include <optional>
 #include <unordered_map>
+#include <vector>
 
 #include "rtm/data.h"
+#include "rtm/lod_cache.h"
 #include "rtm/os/time.h"
 
 namespace rtm
@@ -25,11 +28,25 @@ namespace rtm
     class Serie
     {
     public:
-        Serie(std::string const& name, std::vector<Point>&& raw_serie, ImVec4 color);
+        // Overview size (see lttb()) to plot a serie when zoomed out
+        static constexpr uint32_t DECIMATION = 8'000;
+
+        // points: the whole serie, overview: its downsampled version (the same if small enough)
+        Serie(std::string const& name, PointSpan points, PointSpan overview, ImVec4 color);
+
+        // From a level-of-detail cache: its columns are copied as they are (min/max are not used)
+        Serie(std::string const& name, LodSerie const& cached, ImVec4 color);
         ~Serie() = default;
 
+        // Points past the end of the serie (i.e. the new samples of a followed file)
+        void append(std::vector<Point> const& points);
+
+        // Sections and overview as a level-of-detail cache stores them, valid as long as the serie
+        // is not modified (min/max are left to the caller)
+        LodSerie lod() const;
+
         bool plot() const;
-        Point const* find_nearest(double x, ImPlotRect const& limits) const;
+        std::optional<Point> find_nearest(double x, ImPlotRect const& limits) const;
 
         std::string const& name() const;
         std::string const& original_name() const { return name_; }
@@ -53,10 +70,10 @@ namespace rtm
         {
             seconds_f min;
             seconds_f max;
-            std::vector<Point> points;
+            Columns points;
         };
-        void split_serie(std::vector<Section>& sections, std::vector<Point> const& flat);
-        void plot_visible(ImPlotRect const& limits, Point const* data, int count) const;
+        void split_serie(std::vector<Section>& sections, PointSpan flat);
+        void plot_visible(ImPlotRect const& limits, Columns const& points) const;
 
         ImVec4 color_;
 
@@ -65,8 +82,12 @@ namespace rtm
         int32_t display_weight_{0};
 
         std::vector<Section> sections_;
-        std::vector<Point> serie_;
+        Columns serie_;
         bool is_downsampled_{false};
+
+        // append(): one point out of stride_ goes to serie_, as LTTB needs the whole serie
+        std::size_t stride_{1};
+        std::size_t skipped_{0};
     };
 }
 
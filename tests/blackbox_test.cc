@@ -1,9 +1,16 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <fstream>
+#include <string>
 #include <thread>
 #include <vector>
 
 #include "test_helpers.h"
 #include "rtm/io/file.h"
+#include "rtm/journal.h"
+#include "rtm/serializer.h"
 
 namespace
 {
@@ -390,3 +397,500 @@ bool test_blackbox_file_header()
     fs::remove_all(tmp_dir);
     return true;
 }
+
+
+bool test_blackbox_memory_budget()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_bb_budget";
+    auto spill_dir = tmp_dir / "spill";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    std::string sock_path = (fs::temp_directory_path() / "rtm_bb_budget.sock").string();
+
+    Recorder recorder(tmp_dir.string(), 5s, 5s);
+    recorder.set_memory_budget(1, spill_dir.string());
+    LocalListener listener(sock_path);
+    {
+        auto rc = listener.listen(1);
+        CHECK(not rc, "listen failed");
+    }
+
+    std::thread probe_thread([&sock_path]()
+    {
+        sleep(50ms);
+        auto io = std::make_unique<LocalSocket>(sock_path);
+        if (io->open(access::Mode::READ_WRITE))
+        {
+            printf("  connect failed\n");
+            return;
+        }
+
+        Probe probe;
+        probe.init("test_process", "test_task", START, 1ms, 42, std::move(io));
+        probe.set_threshold(5ms);
+
+        nanoseconds offset{0};
+        for (int i = 0; i < NUM_SAMPLES; ++i)
+        {
+            if (i == 50)
+            {
+                // Let the recorder spill the ring before the spike arrives
+                probe.flush();
+                sleep(200ms);
+                offset += 50ms;
+            }
+            auto t = START + 20ms + nanoseconds(i * 1'000'000) + offset;
+            probe.log(t);
+            probe.log(t + 100us);
+        }
+        probe.flush();
+    });
+
+    std::size_t max_spilled = 0;
+    auto deadline = since_epoch() + 2s;
+    while (since_epoch() < deadline)
+    {
+        auto io = listener.accept(access::Mode::NON_BLOCKING);
+        if (io != nullptr)
+        {
+            recorder.add_client(std::move(io));
+        }
+        recorder.process();
+
+        auto stats = recorder.stats();
+        CHECK(stats.ring_ram_bytes <= 1, "ring memory above budget");
+        max_spilled = std::max(max_spilled, stats.ring_spilled_bytes);
+        sleep(1ms);
+    }
+    probe_thread.join();
+
+    CHECK(max_spilled > 0, "ring was never spilled");
+
+    auto files = find_all_tick_files(tmp_dir);
+    CHECK(files.size() == 1, "expected exactly one .tick file");
+
+    auto io = std::make_unique<File>(files[0].string());
+    auto rc = io->open(access::Mode::READ_ONLY);
+    CHECK(not rc, "cannot open blackbox .tick file");
+
+    Parser parser(std::move(io));
+    parser.load_header();
+    CHECK(parser.load_samples(), "failed to load samples from blackbox file");
+    CHECK(parser.samples().size() == 200, "spilled ring data was not fully restored");
+    CHECK(parser.samples()[0] == 20ms, "wrong first sample after restore");
+
+    int spill_files = 0;
+    for (auto const& entry : fs::directory_iterator(spill_dir))
+    {
+        (void) entry;
+        spill_files++;
+    }
+    CHECK(spill_files == 0, "spill files left behind after trigger");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+bool test_blackbox_correlated_trigger()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_bb_correlated";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    std::string sock_path = (fs::temp_directory_path() / "rtm_bb_correlated.sock").string();
+
+    auto run_probe = [&sock_path](char const* task, nanoseconds pause, nanoseconds spike)
+    {
+        sleep(50ms);
+        auto io = std::make_unique<LocalSocket>(sock_path);
+        if (io->open(access::Mode::READ_WRITE))
+        {
+            printf("  connect failed\n");
+            return;
+        }
+
+        Probe probe;
+        probe.init("test_process", task, START, 1ms, 42, std::move(io));
+        probe.set_threshold(5ms);
+
+        nanoseconds offset{0};
+        for (int i = 0; i < NUM_SAMPLES; ++i)
+        {
+            if (i == 50)
+            {
+                // Both clients are buffering when the spike arrives
+                probe.flush();
+                sleep(pause);
+                offset += spike;
+            }
+            auto t = START + 20ms + nanoseconds(i * 1'000'000) + offset;
+            probe.log(t);
+            probe.log(t + 100us);
+        }
+        probe.flush();
+    };
+
+    {
+        Recorder recorder(tmp_dir.string(), 5s, 5s);
+        recorder.set_correlated_trigger(true);
+        LocalListener listener(sock_path);
+        {
+            auto rc = listener.listen(2);
+            CHECK(not rc, "listen failed");
+        }
+
+        std::thread spiking_thread([&]() { run_probe("test_task", 200ms, 50ms); });
+        std::thread peer_thread([&]()    { run_probe("peer_task", 400ms, 0ms);  });
+
+        recorder_loop(recorder, listener, 2s);
+        spiking_thread.join();
+        peer_thread.join();
+
+        // The peer was dumped, it did not trigger
+        CHECK(recorder.metrics().triggers == 1, "one incident counted as several triggers");
+    } // recorder destroyed: every dump is on disk
+
+    CHECK(count_tick_files(tmp_dir) == 0, "correlated dumps written outside of the incident directory");
+
+    std::vector<fs::path> incidents;
+    for (auto const& entry : fs::directory_iterator(tmp_dir))
+    {
+        if (entry.is_directory() and entry.path().filename().string().find("incident_") == 0)
+        {
+            incidents.push_back(entry.path());
+        }
+    }
+    CHECK(incidents.size() == 1, "expected exactly one incident directory");
+
+    auto files = find_all_tick_files(incidents[0]);
+    CHECK(files.size() == 2, "expected one .tick file per blackbox client");
+
+    bool peer_found = false;
+    for (auto const& f : files)
+    {
+        auto fio = std::make_unique<File>(f.string());
+        auto frc = fio->open(access::Mode::READ_ONLY);
+        CHECK(not frc, "cannot open incident .tick file");
+
+        Parser p(std::move(fio));
+        p.load_header();
+        CHECK(p.load_samples(), "failed to load samples from incident file");
+        CHECK(p.samples().size() == 200, "incident file does not hold the whole window");
+        CHECK(p.samples()[0] == 20ms, "wrong first sample in incident file");
+
+        if (p.header().name.find("peer_task@") == 0)
+        {
+            peer_found = true;
+        }
+    }
+    CHECK(peer_found, "the non-triggering client was not dumped");
+
+    auto manifest_path = incidents[0] / "incident.manifest";
+    CHECK(fs::exists(manifest_path), "no incident manifest");
+
+    std::ifstream manifest(manifest_path);
+    std::string line;
+    int listed_files = 0;
+    bool trigger_listed = false;
+    while (std::getline(manifest, line))
+    {
+        if (line.find("file=") == 0)
+        {
+            listed_files++;
+        }
+        if (line == "trigger_client=test_process_test_task")
+        {
+            trigger_listed = true;
+        }
+    }
+    CHECK(listed_files == 2, "manifest does not list every dump");
+    CHECK(trigger_listed, "manifest does not name the triggering client");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_blackbox_journal_recovery()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_bb_journal";
+    auto journal_dir = tmp_dir / "journal";
+    auto recording_dir = tmp_dir / "recording";
+    auto crash_image = tmp_dir / "crashed.journal";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    std::string sock_path = (fs::temp_directory_path() / "rtm_bb_journal.sock").string();
+
+    {
+        Recorder recorder(recording_dir.string(), 5s, 5s);
+        recorder.set_journal(journal_dir.string(), 1024 * 1024);
+        LocalListener listener(sock_path);
+        {
+            auto rc = listener.listen(1);
+            CHECK(not rc, "listen failed");
+        }
+
+        std::atomic<bool> done{false};
+        std::thread probe_thread([&sock_path, &done]()
+        {
+            sleep(50ms);
+            auto io = std::make_unique<LocalSocket>(sock_path);
+            if (io->open(access::Mode::READ_WRITE))
+            {
+                printf("  connect failed\n");
+                return;
+            }
+            Probe probe;
+            probe.init("test_process", "test_task", START, 1ms, 42, std::move(io));
+            probe.set_threshold(100ms);
+            for (int i = 0; i < NUM_SAMPLES; ++i)
+            {
+                auto t = START + 20ms + nanoseconds(i * 1'000'000);
+                probe.log(t);
+                probe.log(t + 100us);
+            }
+            probe.flush();
+
+            // Stay connected: the journal is only kept while the client is alive
+            while (not done)
+            {
+                sleep(1ms);
+            }
+        });
+
+        recorder_loop(recorder, listener, 1s);
+
+        // The journal is always recoverable: a copy taken now is what a crash would leave behind
+        std::vector<fs::path> journals;
+        for (auto const& entry : fs::directory_iterator(journal_dir))
+        {
+            journals.push_back(entry.path());
+        }
+        done = true;
+        probe_thread.join();
+
+        CHECK(journals.size() == 1, "expected one journal per blackbox client");
+        CHECK(journals[0].extension() == ".journal", "wrong journal file extension");
+        fs::copy_file(journals[0], crash_image);
+    }
+    CHECK(fs::is_empty(journal_dir), "journal left behind after a clean shutdown");
+    CHECK(count_tick_files(recording_dir) == 0, "unexpected .tick file without trigger");
+
+    // Next start: the leftover journal is turned into a .tick file
+    fs::copy_file(crash_image, journal_dir / crash_image.filename());
+    {
+        Recorder recorder(recording_dir.string(), 5s, 5s);
+        recorder.set_journal(journal_dir.string(), 1024 * 1024);
+    }
+    CHECK(fs::is_empty(journal_dir), "recovered journal not removed");
+
+    auto files = find_all_tick_files(recording_dir);
+    CHECK(files.size() == 1, "expected one recovered .tick file");
+    CHECK(files[0].filename().string().find("_recovered.tick") != std::string::npos, "wrong recovered file name");
+
+    auto io = std::make_unique<File>(files[0].string());
+    auto rc = io->open(access::Mode::READ_ONLY);
+    CHECK(not rc, "cannot open recovered .tick file");
+
+    Parser parser(std::move(io));
+    parser.load_header();
+    CHECK(parser.header().process == "test_process", "wrong process name");
+    CHECK(parser.header().name == "test_task@recovered", "wrong task name");
+    CHECK(parser.header().start_time == START, "wrong start_time");
+    CHECK(parser.load_samples(), "failed to load samples from recovered file");
+    CHECK(parser.samples().size() == 200, "recovered file does not hold the whole ring");
+    CHECK(parser.samples()[0] == 20ms, "wrong first recovered sample");
+    CHECK(parser.samples()[199] == 119100us, "wrong last recovered sample");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_journal_wrap_around()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_journal_wrap";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    std::string journal_path = (tmp_dir / "wrap.journal").string();
+
+    std::array<uint8_t, 16> uuid{};
+    {
+        Journal journal;
+        auto rc = journal.create(journal_path, build_tick_header(uuid, START, "test_process", "test_task"), 4096);
+        CHECK(not rc, "cannot create journal");
+        journal.set_stream_state(1ms, 42);
+
+        // One pair per record, way more than the journal can hold
+        for (int i = 0; i < 1000; ++i)
+        {
+            nanoseconds t = START + 20ms + nanoseconds(i * 1'000'000);
+            std::vector<uint8_t> data;
+            append(data, ESCAPE | Command::UPDATE_REFERENCE);
+            append(data, static_cast<uint64_t>(t.count()));
+            append(data, static_cast<uint32_t>(100'000));
+
+            CHECK(journal.append(t, t - START, 2, Journal::LEADING_REFERENCE | Journal::PAIR_ALIGNED,
+                                 data.data(), data.size()), "append failed");
+        }
+        CHECK(journal.records() > 0 and journal.records() < 1000, "journal did not wrap around");
+    } // like a crash: the file stays
+
+    std::string tick_path;
+    auto rc = recover_journal(journal_path, tmp_dir.string(), tick_path);
+    CHECK(not rc, "recovery failed");
+
+    auto io = std::make_unique<File>(tick_path);
+    rc = io->open(access::Mode::READ_ONLY);
+    CHECK(not rc, "cannot open recovered .tick file");
+
+    Parser parser(std::move(io));
+    parser.load_header();
+    CHECK(parser.load_samples(), "failed to load samples from recovered file");
+
+    auto const& samples = parser.samples();
+    CHECK(samples.size() >= 2 and samples.size() % 2 == 0, "recovered samples not pair-aligned");
+    CHECK(samples.back() == 20ms + 999ms + 100us, "newest record lost");
+    for (std::size_t i = 2; i < samples.size(); i += 2)
+    {
+        CHECK(samples[i] - samples[i - 2] == 1ms, "gap between recovered records");
+    }
+
+    // A torn tick header must not be read past its end: the size of the process name
+    // (after the 64 bytes of the journal header, 16 of the tick header, the uuid and
+    // the start time), then the size of the tick header itself
+    auto damage = [&journal_path](std::streamoff offset, auto value)
+    {
+        std::fstream file(journal_path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(offset);
+        file.write(reinterpret_cast<char const*>(&value), sizeof(value));
+    };
+    damage(64 + 16 + 16 + 8, uint16_t{0xFFFF});
+    rc = recover_journal(journal_path, tmp_dir.string(), tick_path);
+    CHECK(rc.value() == EINVAL, "name read past the tick header");
+
+    damage(12, uint32_t{20});
+    rc = recover_journal(journal_path, tmp_dir.string(), tick_path);
+    CHECK(rc.value() == EINVAL, "truncated tick header accepted");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_blackbox_trigger_rules()
+{
+    auto loop_at = [](int i, nanoseconds up_time, nanoseconds start_to_start = 1ms)
+    {
+        LoopTiming loop;
+        loop.previous_start = i * nanoseconds(1ms);
+        loop.start = loop.previous_start + start_to_start;
+        loop.end = loop.start + up_time;
+        loop.has_previous = true;
+        loop.period = 1ms;
+        return loop;
+    };
+
+    // Misses: 3 loops off the period by more than 50% within the last 10
+    {
+        TriggerEngine engine;
+        CHECK(not engine.set({TriggerKind::MISSES, 11, 10, 50}), "count above the window accepted");
+        CHECK(engine.set({TriggerKind::MISSES, 3, 10, 50}), "misses rule rejected");
+
+        CHECK(engine.on_loop(loop_at(0, 100us, 2ms)) == nullptr, "fired on the first miss");
+        CHECK(engine.on_loop(loop_at(1, 100us, 1400us)) == nullptr, "fired on a 40% deviation");
+        CHECK(engine.on_loop(loop_at(2, 100us, 2ms)) == nullptr, "fired on the second miss");
+        CHECK(engine.on_loop(loop_at(3, 100us, 2ms)) != nullptr, "third miss did not fire");
+
+        for (int i = 4; i < 14; ++i)
+        {
+            CHECK(engine.on_loop(loop_at(i, 100us)) == nullptr, "fired on a loop on time");
+        }
+        CHECK(engine.on_loop(loop_at(14, 100us, 2ms)) == nullptr, "old misses not out of the window");
+    }
+
+    // Rolling p99: an up time twice the usual one
+    {
+        TriggerEngine engine;
+        CHECK(not engine.set({TriggerKind::ROLLING_P99, 0, 10, 200}), "window too small for a p99 accepted");
+        CHECK(engine.set({TriggerKind::ROLLING_P99, 0, 1000, 200}), "p99 rule rejected");
+
+        for (int i = 0; i < 2000; ++i)
+        {
+            // 2% of slower loops: the p99 covers them
+            nanoseconds up_time = (i % 50 == 0) ? 300us : 100us;
+            CHECK(engine.on_loop(loop_at(i, up_time)) == nullptr, "fired within the usual up times");
+        }
+        CHECK(engine.on_loop(loop_at(2000, 500us)) == nullptr, "fired below 200% of the p99");
+
+        TriggerCheck const* fired = engine.on_loop(loop_at(2001, 2ms));
+        CHECK(fired != nullptr, "up time excursion did not fire");
+        CHECK(fired->measured() == 2ms, "wrong measure");
+
+        CHECK(engine.set({TriggerKind::ROLLING_P99, 0, 0, 0}), "rule removal rejected");
+        CHECK(engine.empty(), "rule not removed");
+    }
+
+    // End to end: a probe without threshold, triggered on its up time
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_bb_rules";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    std::string sock_path = (fs::temp_directory_path() / "rtm_bb_rules.sock").string();
+
+    Recorder recorder(tmp_dir.string(), 5s, 5s);
+    CHECK(not recorder.add_trigger({TriggerKind::MISSES, 0, 10, 50}), "invalid recorder rule accepted");
+    CHECK(recorder.add_trigger({TriggerKind::PERIOD_DEVIATION, 0, 0, 1000}), "recorder rule rejected");
+
+    LocalListener listener(sock_path);
+    {
+        auto rc = listener.listen(1);
+        CHECK(not rc, "listen failed");
+    }
+
+    std::thread probe_thread([&sock_path]()
+    {
+        sleep(50ms);
+        auto io = std::make_unique<LocalSocket>(sock_path);
+        if (io->open(access::Mode::READ_WRITE))
+        {
+            printf("  connect failed\n");
+            return;
+        }
+
+        Probe probe;
+        probe.init("test_process", "test_task", START, 1ms, 42, std::move(io));
+        probe.set_trigger({TriggerKind::UP_TIME, 0, 0, static_cast<uint64_t>(nanoseconds(400us).count())});
+        for (int i = 0; i < NUM_SAMPLES; ++i)
+        {
+            auto t = START + 20ms + nanoseconds(i * 1'000'000);
+            probe.log(t);
+            probe.log(t + (i == 50 ? 600us : 100us));
+        }
+        probe.flush();
+    });
+
+    recorder_loop(recorder, listener, 2s);
+    probe_thread.join();
+
+    auto files = find_all_tick_files(tmp_dir);
+    CHECK(files.size() == 1, "expected exactly one .tick file");
+
+    auto io = std::make_unique<File>(files[0].string());
+    auto rc = io->open(access::Mode::READ_ONLY);
+    CHECK(not rc, "cannot open blackbox .tick file");
+
+    Parser parser(std::move(io));
+    parser.load_header();
+    CHECK(parser.load_samples(), "failed to load samples from blackbox file");
+
+    auto const& samples = parser.samples();
+    CHECK(samples.size() % 2 == 0, "samples not pair-aligned");
+    bool long_loop_found = false;
+    for (std::size_t i = 0; i + 1 < samples.size(); i += 2)
+    {
+        long_loop_found |= (samples[i + 1] - samples[i] == 600us);
+    }
+    CHECK(long_loop_found, "the triggering loop is not in the recording");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
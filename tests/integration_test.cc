@@ -1,14 +1,166 @@
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
 #include <thread>
+#include <vector>
+
+#include <sys/resource.h>
 
 #include "test_helpers.h"
+#include "rtm/delta.h"
+#include "rtm/fanout.h"
+#include "rtm/io/async.h"
+#include "rtm/io/datagram.h"
 #include "rtm/io/file.h"
+#include "rtm/io/mapped_file.h"
 #include "rtm/io/null.h"
 #include "rtm/io/posix/tcp_socket.h"
+#include "rtm/lod_cache.h"
+#include "rtm/relay.h"
+#include "rtm/serializer.h"
+#include "rtm/summary.h"
 
 namespace
 {
 constexpr uint16_t TCP_TEST_PORT = 19770;
+constexpr uint16_t UDP_TEST_PORT = 19771;
+
+// Loses one datagram out of four
+class LossyIO final : public AbstractIO
+{
+public:
+    LossyIO(std::unique_ptr<AbstractIO> io)
+        : io_{std::move(io)}
+    {
+        supported_modes_ = access::Mode::READ_WRITE;
+    }
+
+    int64_t read(void* data, int64_t data_size) override { return io_->read(data, data_size); }
+    int64_t write(void const* data, int64_t data_size) override
+    {
+        if (++count_ % 4 == 0)
+        {
+            return data_size;
+        }
+        return io_->write(data, data_size);
+    }
+
+protected:
+    std::error_code do_open(access::Mode mode) override { return io_->open(mode); }
+    std::error_code do_close() override { return io_->close(); }
+
+private:
+    std::unique_ptr<AbstractIO> io_;
+    int count_{0};
+};
+
+// Probes of a connect storm the machine can take: each one holds two descriptors,
+// and the kernel caps the listen backlog to somaxconn
+std::size_t storm_size(std::size_t wanted)
+{
+    std::size_t size = wanted;
+
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 and limit.rlim_cur != RLIM_INFINITY)
+    {
+        constexpr std::size_t SPARE = 64; // test runner, recorder files
+        std::size_t descriptors = static_cast<std::size_t>(limit.rlim_cur);
+        size = std::min(size, descriptors > SPARE ? (descriptors - SPARE) / 2 : 0);
+    }
+
+    std::ifstream somaxconn("/proc/sys/net/core/somaxconn");
+    std::size_t backlog = 0;
+    if (somaxconn >> backlog)
+    {
+        size = std::min(size, backlog);
+    }
+    return size;
+}
+
+// Keeps every write (a datagram for a DatagramWriter)
+class CaptureIO final : public AbstractIO
+{
+public:
+    CaptureIO(std::vector<std::vector<uint8_t>>& writes)
+        : writes_{writes}
+    {
+        supported_modes_ = access::Mode::READ_WRITE;
+    }
+
+    int64_t read(void*, int64_t) override { return -1; }
+    int64_t write(void const* data, int64_t data_size) override
+    {
+        auto bytes = static_cast<uint8_t const*>(data);
+        writes_.emplace_back(bytes, bytes + data_size);
+        return data_size;
+    }
+
+protected:
+    std::error_code do_open(access::Mode) override { return {}; }
+    std::error_code do_close() override { return {}; }
+
+private:
+    std::vector<std::vector<uint8_t>>& writes_;
+};
+
+// Commands found in a tick stream fragment (whole elements)
+std::vector<uint32_t> stream_commands(uint8_t const* pos, uint8_t const* end)
+{
+    std::vector<uint32_t> commands;
+    while (pos + sizeof(uint32_t) <= end)
+    {
+        uint32_t word;
+        std::memcpy(&word, pos, sizeof(word));
+        if (word & ESCAPE)
+        {
+            commands.push_back(word & ~ESCAPE);
+        }
+        pos += element_size(word);
+    }
+    return commands;
+}
+
+bool record_udp(fs::path const& dir, bool lossy, uint64_t& dropped)
+{
+    Recorder recorder(dir.string());
+    DatagramListener listener(UDP_TEST_PORT, 200ms);
+    CHECK(not listener.listen(), "UDP listen() failed");
+
+    std::thread probe_thread([lossy]()
+    {
+        sleep(50ms);
+        std::unique_ptr<AbstractIO> socket = std::make_unique<UdpSocket>("127.0.0.1", UDP_TEST_PORT);
+        if (lossy)
+        {
+            socket = std::make_unique<LossyIO>(std::move(socket));
+        }
+        auto io = std::make_unique<DatagramWriter>(std::move(socket));
+        if (io->open(access::Mode::READ_WRITE))
+        {
+            printf("  probe UDP open failed\n");
+            return;
+        }
+        send_probe_data(std::move(io));
+    });
+
+    auto deadline = since_epoch() + 1s;
+    while (since_epoch() < deadline)
+    {
+        for (auto& io : listener.receive())
+        {
+            recorder.add_client(std::move(io));
+        }
+        recorder.process();
+        sleep(1ms);
+    }
+    probe_thread.join();
+
+    dropped = listener.dropped();
+    return true;
+}
 }
 
 
@@ -41,6 +193,7 @@ bool test_file_sink()
         CHECK(parser.header().process == "test_process", "wrong process name");
         CHECK(parser.header().name == "test_task", "wrong task name");
         CHECK(parser.header().major == 2, "wrong protocol major version");
+        CHECK(parser.header().minor == PROTOCOL_MINOR, "wrong protocol minor version");
 
         bool loaded = parser.load_samples();
         CHECK(loaded, "failed to load samples");
@@ -231,3 +384,1853 @@ bool test_corrupted_data()
     fs::remove_all(tmp_dir);
     return true;
 }
+
+
+bool test_async_io()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_async";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    auto path = tmp_dir / "async.bin";
+
+    auto worker = std::make_shared<IOWorker>();
+    {
+        AsyncIO io(std::make_unique<File>(path.string()), worker);
+        auto rc = io.open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE);
+        CHECK(not rc, "cannot open async file");
+
+        // Staged writes, handed-over buffers and posted jobs must land in order
+        for (uint32_t i = 0; i < 1000; ++i)
+        {
+            if (i % 3 == 0)
+            {
+                std::vector<uint8_t> buffer(sizeof(i));
+                std::memcpy(buffer.data(), &i, sizeof(i));
+                io.write(std::move(buffer));
+            }
+            else if (i % 3 == 1)
+            {
+                io.post([i](AbstractIO& target) { target.write(&i, sizeof(i)); });
+            }
+            else
+            {
+                io.write(&i, sizeof(i));
+            }
+        }
+        io.sync();
+    }
+    worker->wait_idle();
+
+    CHECK(fs::file_size(path) == 1000 * sizeof(uint32_t), "wrong async file size");
+
+    File reader(path.string());
+    CHECK(not reader.open(access::Mode::READ_ONLY), "cannot read async file");
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        uint32_t value = 0;
+        CHECK(reader.read(&value, sizeof(value)) == sizeof(value), "short read");
+        CHECK(value == i, "async writes out of order");
+    }
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+bool test_rotation()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_rotation";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    std::string sock_path = (fs::temp_directory_path() / "rtm_rotation.sock").string();
+
+    {
+        Recorder recorder(tmp_dir.string());
+        recorder.set_rotation(0, 25ms);
+        LocalListener listener(sock_path);
+        {
+            auto rc = listener.listen(1);
+            CHECK(not rc, "local listen() failed");
+        }
+
+        std::thread probe_thread([&sock_path]()
+        {
+            sleep(50ms);
+            auto io = std::make_unique<LocalSocket>(sock_path);
+            if (io->open(access::Mode::READ_WRITE))
+            {
+                printf("  probe connect failed\n");
+                return;
+            }
+            send_probe_data(std::move(io));
+        });
+
+        recorder_loop(recorder, listener, 1s);
+        probe_thread.join();
+
+        // Each write is synced, not only the end of each segment
+        CHECK(recorder.metrics().sync_latency.count() > 4, "segments synced only when closed");
+    }
+
+    std::vector<fs::path> segments;
+    fs::path manifest_path;
+    for (auto const& entry : fs::directory_iterator(tmp_dir))
+    {
+        if (entry.path().extension() == ".tick")
+        {
+            segments.push_back(entry.path());
+        }
+        else if (entry.path().extension() == ".segments")
+        {
+            manifest_path = entry.path();
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+    CHECK(segments.size() == 4, "expected one segment per 25ms of samples");
+    CHECK(not manifest_path.empty(), "no segment manifest");
+
+    // Segments are standalone and, put together, hold the whole stream
+    std::vector<nanoseconds> samples;
+    std::vector<std::pair<nanoseconds, nanoseconds>> ranges;
+    for (std::size_t i = 0; i < segments.size(); ++i)
+    {
+        auto io = std::make_unique<File>(segments[i].string());
+        auto rc = io->open(access::Mode::READ_ONLY);
+        CHECK(not rc, "cannot open segment");
+
+        Parser parser(std::move(io));
+        parser.load_header();
+        CHECK(parser.header().process == "test_process", "wrong process name");
+        CHECK(parser.header().name == "test_task#000" + std::to_string(i), "wrong segment task name");
+        CHECK(parser.header().start_time == START, "wrong start_time");
+        CHECK(parser.load_samples(), "failed to load segment samples");
+        CHECK(parser.header().sentinel_pos > 0, "segment is not terminated");
+        CHECK(parser.samples().size() % 2 == 0, "segment not pair-aligned");
+
+        samples.insert(samples.end(), parser.samples().begin(), parser.samples().end());
+        ranges.push_back({parser.begin(), parser.end()});
+    }
+
+    CHECK(samples.size() == 2 * NUM_SAMPLES, "samples lost across segments");
+    for (int i = 0; i < NUM_SAMPLES; ++i)
+    {
+        CHECK(samples[2 * i]     == 20ms + i * 1ms,         "wrong start sample across segments");
+        CHECK(samples[2 * i + 1] == 20ms + i * 1ms + 100us, "wrong end sample across segments");
+    }
+
+    std::ifstream manifest(manifest_path);
+    std::string line;
+    std::size_t listed = 0;
+    while (std::getline(manifest, line))
+    {
+        if (line.empty() or line[0] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::string file_name;
+        int64_t begin_ns;
+        int64_t end_ns;
+        uint64_t count;
+        fields >> file_name >> begin_ns >> end_ns >> count;
+        CHECK(listed < segments.size(), "too many manifest entries");
+        CHECK(file_name == segments[listed].filename().string(), "manifest lists the wrong file");
+        CHECK(nanoseconds(begin_ns) == ranges[listed].first, "wrong segment begin in manifest");
+        CHECK(nanoseconds(end_ns) == ranges[listed].second, "wrong segment end in manifest");
+        listed++;
+    }
+    CHECK(listed == segments.size(), "manifest does not list every segment");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_fanout()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_fanout";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    std::string sock_path = (fs::temp_directory_path() / "rtm_fanout.sock").string();
+    std::string subscribe_path = (fs::temp_directory_path() / "rtm_fanout_sub.sock").string();
+
+    Recorder recorder((tmp_dir / "recording").string());
+    recorder.enable_fanout();
+
+    LocalListener listener(sock_path);
+    LocalListener subscribe_listener(subscribe_path);
+    CHECK(not listener.listen(1), "local listen() failed");
+    CHECK(not subscribe_listener.listen(2), "subscriber listen() failed");
+
+    // Each subscriber rebuilds a .tick file from the frames of the (only) client
+    auto subscribe = [&subscribe_path](fs::path const& output_dir)
+    {
+        sleep(10ms);
+        LocalSocket io{subscribe_path};
+        if (io.open(access::Mode::READ_WRITE))
+        {
+            printf("  subscriber connect failed\n");
+            return;
+        }
+
+        auto read_exactly = [&io](void* data, std::size_t size)
+        {
+            auto* bytes = static_cast<uint8_t*>(data);
+            while (size > 0)
+            {
+                int64_t r = io.read(bytes, static_cast<int64_t>(size));
+                if (r <= 0)
+                {
+                    return false;
+                }
+                bytes += r;
+                size -= static_cast<std::size_t>(r);
+            }
+            return true;
+        };
+
+        fs::create_directories(output_dir);
+        File output{(output_dir / "live.tick").string()};
+        output.open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE);
+
+        fanout::FrameHeader frame;
+        while (read_exactly(&frame, sizeof(frame)))
+        {
+            std::vector<uint8_t> payload(frame.size);
+            if (not read_exactly(payload.data(), payload.size()))
+            {
+                break;
+            }
+
+            if (frame.type == fanout::CLIENT_BEGIN)
+            {
+                // Skip the reference: the subscriber joined before the first sample
+                output.write(payload.data() + sizeof(uint64_t), static_cast<int64_t>(payload.size() - sizeof(uint64_t)));
+            }
+            else if (frame.type == fanout::CLIENT_DATA)
+            {
+                output.write(payload.data(), static_cast<int64_t>(payload.size()));
+            }
+            else if (frame.type == fanout::CLIENT_END)
+            {
+                break;
+            }
+        }
+    };
+
+    std::thread subscriber_a([&]() { subscribe(tmp_dir / "a"); });
+    std::thread subscriber_b([&]() { subscribe(tmp_dir / "b"); });
+    std::thread probe_thread([&sock_path]()
+    {
+        sleep(50ms);
+        auto io = std::make_unique<LocalSocket>(sock_path);
+        if (io->open(access::Mode::READ_WRITE))
+        {
+            printf("  probe connect failed\n");
+            return;
+        }
+        send_probe_data(std::move(io));
+    });
+
+    auto deadline = since_epoch() + 1s;
+    while (since_epoch() < deadline)
+    {
+        auto subscriber = subscribe_listener.accept(access::Mode::NON_BLOCKING);
+        if (subscriber != nullptr)
+        {
+            recorder.add_subscriber(std::move(subscriber));
+        }
+        auto io = listener.accept(access::Mode::NON_BLOCKING);
+        if (io != nullptr)
+        {
+            recorder.add_client(std::move(io));
+        }
+        recorder.process();
+        sleep(1ms);
+    }
+    probe_thread.join();
+    subscriber_a.join();
+    subscriber_b.join();
+
+    CHECK(verify_tick_file(tmp_dir / "recording"), "recording altered by the fan-out");
+    CHECK(verify_tick_file(tmp_dir / "a"), "first subscriber did not get the whole stream");
+    CHECK(verify_tick_file(tmp_dir / "b"), "second subscriber did not get the whole stream");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_udp()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_udp";
+    fs::remove_all(tmp_dir);
+
+    // Lossless link: the recording is identical to a stream one
+    uint64_t dropped = 0;
+    fs::create_directories(tmp_dir / "reliable");
+    CHECK(record_udp(tmp_dir / "reliable", false, dropped), "UDP recording failed");
+    CHECK(dropped == 0, "datagrams lost on the loopback");
+    CHECK(verify_tick_file(tmp_dir / "reliable"), "UDP recording differs from the probe data");
+
+    // Lossy link: every surviving pair is intact and the losses are recorded
+    fs::create_directories(tmp_dir / "lossy");
+    CHECK(record_udp(tmp_dir / "lossy", true, dropped), "lossy UDP recording failed");
+    CHECK(dropped > 0, "no loss detected");
+
+    auto tick_file = find_tick_file(tmp_dir / "lossy");
+    CHECK(not tick_file.empty(), "no .tick file found for the lossy link");
+    auto io = std::make_unique<File>(tick_file.string());
+    CHECK(not io->open(access::Mode::READ_ONLY), "cannot open the lossy recording");
+
+    Parser parser(std::move(io));
+    parser.load_header();
+    CHECK(parser.header().name == "test_task", "wrong task name");
+    CHECK(parser.load_samples(), "failed to load the lossy recording");
+    CHECK(parser.dropped() == dropped, "DATA_GAP does not match the datagrams lost");
+    CHECK(parser.load_samples() and parser.dropped() == dropped, "gaps counted again by a second load");
+
+    auto const& samples = parser.samples();
+    CHECK(not samples.empty() and samples.size() < 200, "unexpected sample count");
+    CHECK(samples.size() % 2 == 0, "pairs split by a loss");
+    for (std::size_t i = 0; i < samples.size(); i += 2)
+    {
+        CHECK(samples[i] >= 20ms and samples[i] <= 119ms, "start sample out of range");
+        CHECK((samples[i] - 20ms) % 1ms == 0ns, "start sample misplaced");
+        CHECK(samples[i + 1] - samples[i] == 100us, "pair altered by a loss");
+    }
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_metrics()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_metrics";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    std::string sock_path = (fs::temp_directory_path() / "rtm_metrics.sock").string();
+
+    Recorder recorder(tmp_dir.string());
+    LocalListener listener(sock_path);
+    CHECK(not listener.listen(1), "local listen() failed");
+
+    std::thread probe_thread([&sock_path]()
+    {
+        sleep(50ms);
+        auto io = std::make_unique<LocalSocket>(sock_path);
+        if (io->open(access::Mode::READ_WRITE))
+        {
+            printf("  probe connect failed\n");
+            return;
+        }
+        send_probe_data(std::move(io));
+    });
+
+    // Read concurrently, as an exporter would
+    std::atomic<bool> done{false};
+    std::thread reader([&]()
+    {
+        while (not done)
+        {
+            (void) recorder.metrics().prometheus();
+            sleep(1ms);
+        }
+    });
+
+    recorder_loop(recorder, listener, 1s);
+    probe_thread.join();
+    done = true;
+    reader.join();
+
+    auto& metrics = recorder.metrics();
+    CHECK(metrics.samples == 2 * NUM_SAMPLES, "wrong sample count");
+    CHECK(metrics.bytes > 2 * NUM_SAMPLES * sizeof(uint32_t), "wrong byte count");
+    CHECK(metrics.sync_latency.count() > 0, "fsync not measured");
+    CHECK(metrics.write_latency.count() > 0, "read-to-disk latency not measured");
+    CHECK(metrics.triggers == 0, "unexpected trigger");
+
+    std::string text = metrics.prometheus();
+    CHECK(text.find("rtm_received_samples_total 200\n") != std::string::npos, "samples counter not exported");
+    CHECK(text.find("rtm_clients 0\n") != std::string::npos, "disconnected client still exported");
+    CHECK(text.find("rtm_sync_latency_seconds_bucket{le=\"+Inf\"}") != std::string::npos, "histogram not exported");
+    CHECK(not metrics.summary().empty(), "empty summary");
+
+    // Long labels are not cut: each sample stays on its own line
+    std::string const long_name(1000, 'p');
+    auto client = metrics.add_client(7, long_name, "source");
+    text = metrics.prometheus();
+    std::string const series = "rtm_client_received_samples_total{client=\"7\",process=\"" + long_name + "\",source=\"source\"} 0\n";
+    CHECK(text.find(series) != std::string::npos, "long label truncated");
+    metrics.remove_client(client);
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_splice()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_splice";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    std::string sock_path = (fs::temp_directory_path() / "rtm_splice.sock").string();
+
+    Recorder recorder(tmp_dir.string());
+    recorder.set_splice(true);
+    LocalListener listener(sock_path);
+    CHECK(not listener.listen(1), "local listen() failed");
+
+    std::thread probe_thread([&sock_path]()
+    {
+        sleep(50ms);
+        auto io = std::make_unique<LocalSocket>(sock_path);
+        if (io->open(access::Mode::READ_WRITE))
+        {
+            printf("  probe connect failed\n");
+            return;
+        }
+
+        // Same data as send_probe_data(), the second half once the recorder has decided the mode
+        Probe probe;
+        probe.init("test_process", "test_task", START, 1ms, 42, std::move(io));
+        for (int i = 0; i < NUM_SAMPLES; ++i)
+        {
+            if (i == NUM_SAMPLES / 2)
+            {
+                probe.flush();
+                sleep(100ms);
+            }
+            auto t = START + 20ms + nanoseconds(i * 1'000'000);
+            probe.log(t);
+            probe.log(t + 100us);
+        }
+        probe.flush();
+    });
+
+    recorder_loop(recorder, listener, 1s);
+    probe_thread.join();
+
+    CHECK(recorder.metrics().samples < 2 * NUM_SAMPLES, "data copied instead of spliced");
+    bool ok = verify_tick_file(tmp_dir);
+    fs::remove_all(tmp_dir);
+    return ok;
+}
+
+
+bool test_direct_io()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_direct";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+
+    // Unaligned writes and syncs: the file must hold exactly what was written
+    auto path = tmp_dir / "direct.bin";
+    std::vector<uint8_t> expected;
+    {
+        File file{path.string()};
+        CHECK(not file.open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE | access::Mode::DIRECT), "DIRECT open failed");
+        CHECK(file.native_handle() < 0, "staged file exposes its handle");
+
+        std::vector<uint8_t> chunk(1000);
+        for (int i = 0; i < 300; ++i)
+        {
+            for (std::size_t j = 0; j < chunk.size(); ++j)
+            {
+                chunk[j] = static_cast<uint8_t>(i + j);
+            }
+            CHECK(file.write(chunk.data(), static_cast<int64_t>(chunk.size())) == 1000, "DIRECT write failed");
+            expected.insert(expected.end(), chunk.begin(), chunk.end());
+
+            if (i % 37 == 0)
+            {
+                CHECK(not file.sync(), "DIRECT sync failed");
+                CHECK(fs::file_size(path) == expected.size(), "synced tail not written");
+
+                std::ifstream input(path, std::ios::binary);
+                std::vector<uint8_t> content((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+                CHECK(content == expected, "synced DIRECT file content differs");
+            }
+        }
+    }
+    CHECK(fs::file_size(path) == expected.size(), "wrong size after close");
+    {
+        std::ifstream input(path, std::ios::binary);
+        std::vector<uint8_t> content((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        CHECK(content == expected, "DIRECT file content differs");
+    }
+
+    // Recorder sinks
+    std::string sock_path = (fs::temp_directory_path() / "rtm_direct.sock").string();
+    Recorder recorder((tmp_dir / "recording").string());
+    recorder.set_direct_io(true);
+    LocalListener listener(sock_path);
+    CHECK(not listener.listen(1), "local listen() failed");
+
+    std::thread probe_thread([&sock_path]()
+    {
+        sleep(50ms);
+        auto io = std::make_unique<LocalSocket>(sock_path);
+        if (io->open(access::Mode::READ_WRITE))
+        {
+            printf("  probe connect failed\n");
+            return;
+        }
+        send_probe_data(std::move(io));
+    });
+
+    recorder_loop(recorder, listener, 1s);
+    probe_thread.join();
+
+    CHECK(verify_tick_file(tmp_dir / "recording"), "DIRECT recording unreadable");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_quota()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_quota";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir / "incident_old");
+
+    // Recordings of previous runs, from the oldest to the newest
+    auto old_recording = [&tmp_dir](fs::path const& name, int age)
+    {
+        auto path = tmp_dir / name;
+        std::ofstream(path, std::ios::binary) << std::string(10'000, 'x');
+        fs::last_write_time(path, fs::file_time_type::clock::now() - std::chrono::hours(age));
+        return path;
+    };
+    auto oldest = old_recording("incident_old/a.tick", 3);
+    std::ofstream(tmp_dir / "incident_old" / "incident.manifest") << "trigger_client=a\n";
+    auto older  = old_recording("b.tick", 2);
+    auto old    = old_recording("c.tick", 1);
+    std::ofstream(tmp_dir / "notes.txt") << std::string(100'000, 'n');
+
+    {
+        // An open recording is never deleted, whatever its size
+        Retention retention{tmp_dir.string()};
+
+        // Spelled differently from what the scan finds
+        auto path = (tmp_dir / "." / "open.tick").string();
+        auto sink = retention.track(path, std::make_unique<File>(path));
+        CHECK(not sink->open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE), "cannot open the tracked file");
+        std::vector<uint8_t> data(40'000, 0);
+        CHECK(sink->write(data.data(), static_cast<int64_t>(data.size())) == 40'000, "tracked write failed");
+        retention.set_quota(25'000);
+
+        retention.enforce();
+        CHECK(retention.used() == 40'000, "wrong usage");
+        CHECK(not fs::exists(oldest) and not fs::exists(older) and not fs::exists(old), "complete recordings kept");
+        CHECK(not fs::exists(tmp_dir / "incident_old"), "empty incident directory kept");
+        CHECK(fs::exists(path), "open recording deleted");
+        CHECK(fs::exists(tmp_dir / "notes.txt"), "not a recording, deleted");
+
+        sink.reset();
+        retention.enforce();
+        CHECK(not fs::exists(path), "closed recording kept over quota");
+        CHECK(retention.used() == 0 and retention.deleted() == 4, "wrong accounting");
+    }
+
+    // Recorder: the new recording pushes the oldest one out
+    oldest = old_recording("a.tick", 3);
+    older  = old_recording("b.tick", 2);
+    old    = old_recording("c.tick", 1);
+
+    std::string sock_path = (fs::temp_directory_path() / "rtm_quota.sock").string();
+    Recorder recorder(tmp_dir.string());
+    recorder.set_quota(30'500);
+    LocalListener listener(sock_path);
+    CHECK(not listener.listen(1), "local listen() failed");
+
+    std::thread probe_thread([&sock_path]()
+    {
+        sleep(50ms);
+        auto io = std::make_unique<LocalSocket>(sock_path);
+        if (io->open(access::Mode::READ_WRITE))
+        {
+            printf("  probe connect failed\n");
+            return;
+        }
+        send_probe_data(std::move(io));
+    });
+
+    recorder_loop(recorder, listener, 1s);
+    probe_thread.join();
+
+    CHECK(not fs::exists(oldest), "oldest recording kept over quota");
+    CHECK(fs::exists(older) and fs::exists(old), "recent recordings deleted");
+    CHECK(recorder.metrics().recordings_deleted == 1, "deletion not in the metrics");
+    CHECK(recorder.metrics().recorded_bytes <= 30'500, "usage over quota");
+    CHECK(recorder.metrics().write_errors == 0, "write errors");
+
+    fs::remove(older);
+    fs::remove(old);
+    CHECK(verify_tick_file(tmp_dir), "new recording unreadable");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_relay()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_relay";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir / "relay");
+    fs::create_directories(tmp_dir / "upstream");
+    std::string probe_path = (fs::temp_directory_path() / "rtm_relay_probe.sock").string();
+    std::string upstream_path = (fs::temp_directory_path() / "rtm_relay_upstream.sock").string();
+    fs::remove(upstream_path);
+
+    auto link = std::make_shared<RelayLink>(std::make_unique<LocalSocket>(upstream_path), 1024 * 1024, true);
+    Recorder relay((tmp_dir / "relay").string());
+    relay.set_relay(link);
+    LocalListener probe_listener(probe_path);
+    CHECK(not probe_listener.listen(1), "local listen() failed");
+
+    std::thread probe_thread([&probe_path]()
+    {
+        sleep(50ms);
+        auto io = std::make_unique<LocalSocket>(probe_path);
+        if (io->open(access::Mode::READ_WRITE))
+        {
+            printf("  probe connect failed\n");
+            return;
+        }
+        send_probe_data(std::move(io));
+    });
+
+    // The upstream is down while the probe streams: the relay buffers
+    recorder_loop(relay, probe_listener, 300ms);
+    probe_thread.join();
+    CHECK(not link->connected(), "connected to nothing");
+    CHECK(link->buffered() > 0, "nothing buffered during the outage");
+
+    Recorder upstream((tmp_dir / "upstream").string());
+    RelayListener relay_listener(std::make_unique<LocalListener>(upstream_path));
+    CHECK(not relay_listener.listen(1), "relay listen() failed");
+
+    auto deadline = since_epoch() + RelayLink::RECONNECT_DELAY + 500ms;
+    while (since_epoch() < deadline)
+    {
+        relay.process();
+        for (auto& io : relay_listener.receive())
+        {
+            upstream.add_client(std::move(io));
+        }
+        upstream.process();
+        sleep(1ms);
+    }
+
+    CHECK(link->connected() and link->buffered() == 0, "buffer not drained");
+    CHECK(link->dropped() == 0 and relay_listener.dropped() == 0, "datagrams lost");
+    CHECK(find_tick_file(tmp_dir / "relay").empty(), "relayed stream recorded locally");
+    CHECK(verify_tick_file(tmp_dir / "upstream"), "upstream recording differs from the probe data");
+
+    // The buffer is bounded: an outage longer than it loses the oldest data
+    RelayLink tiny(std::make_unique<LocalSocket>(upstream_path + ".none"), 64);
+    send_probe_data(tiny.open_stream());
+    CHECK(tiny.dropped() > 0 and tiny.buffered() <= 64, "buffer not bounded");
+
+    // Compression round trip
+    std::vector<uint8_t> words;
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        append(words, i * 1'000'000u + (i % 7));
+        append(words, 100'000u - (i % 3));
+    }
+    auto compressed = relay::compress(words.data(), words.size());
+    CHECK(not compressed.empty() and compressed.size() < words.size() / 2, "poor compression");
+    std::vector<uint8_t> plain;
+    CHECK(relay::decompress(compressed.data(), compressed.size(), plain) and plain == words, "compression round trip failed");
+    CHECK(not relay::decompress(compressed.data(), compressed.size() - 1, plain), "truncated payload accepted");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_summary_index()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_summary";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    std::string sock_path = (fs::temp_directory_path() / "rtm_summary.sock").string();
+
+    Recorder recorder(tmp_dir.string());
+    LocalListener listener(sock_path);
+    CHECK(not listener.listen(1), "local listen() failed");
+
+    std::thread probe_thread([&sock_path]()
+    {
+        sleep(50ms);
+        auto io = std::make_unique<LocalSocket>(sock_path);
+        if (io->open(access::Mode::READ_WRITE))
+        {
+            printf("  probe connect failed\n");
+            return;
+        }
+        send_probe_data(std::move(io));
+    });
+
+    recorder_loop(recorder, listener, 500ms);
+    probe_thread.join();
+
+    auto tick_file = find_tick_file(tmp_dir);
+    CHECK(not tick_file.empty(), "no .tick file found");
+    auto io = std::make_unique<File>(tick_file.string());
+    CHECK(not io->open(access::Mode::READ_ONLY), "cannot open the recording");
+    Parser parser(std::move(io));
+    parser.load_header();
+    CHECK(parser.header().metadata_footer_offset > 0, "no metadata footer");
+    parser.load_metadata();
+
+    // The overview matches the data, without reading it
+    SummaryBlock overview;
+    CHECK(parser.overview(overview), "no summary index");
+    CHECK(overview.samples == 2 * NUM_SAMPLES, "wrong sample count");
+    CHECK(overview.period.count == NUM_SAMPLES - 1 and overview.up.count == NUM_SAMPLES, "wrong loop count");
+    CHECK(overview.period.min == 1'000'000 and overview.period.max == 1'000'000, "wrong period");
+    CHECK(overview.up.min == 100'000 and overview.up.max == 100'000 and overview.up.stddev() < 1, "wrong up time");
+
+    CHECK(parser.load_samples(), "failed to load samples");
+    CHECK(overview.begin == parser.begin() and overview.end == parser.end(), "wrong time range");
+
+    SummaryBlock none;
+    CHECK(parser.overview(none, parser.end() + 1s, parser.end() + 2s) and none.samples == 0, "range not honored");
+
+    // Small blocks, fed in odd pieces: each block starts where its samples are
+    std::ifstream file(tick_file, std::ios::binary);
+    std::vector<uint8_t> bytes{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    bytes.resize(static_cast<std::size_t>(parser.header().sentinel_pos) + sizeof(uint32_t));
+
+    SummaryBuilder builder(16);
+    for (std::size_t pos = 0; pos < bytes.size(); pos += 7)
+    {
+        builder.write(bytes.data() + pos, std::min<std::size_t>(7, bytes.size() - pos));
+    }
+    CHECK(builder.ended(), "sentinel not seen");
+    auto blocks = builder.finish();
+    CHECK(blocks.size() == (2 * NUM_SAMPLES + 15) / 16, "wrong block count");
+
+    auto const& samples = parser.samples();
+    std::size_t index = 0;
+    for (auto const& block : blocks)
+    {
+        CHECK(block.samples % 2 == 0, "block splits a pair");
+        CHECK(block.begin - parser.header().start_time == samples[index], "wrong block begin");
+        CHECK(block.offset >= static_cast<int64_t>(parser.header().data_section_offset) + 8, "offset in the header");
+
+        // Decode the first sample from the block offset, skipping the commands
+        nanoseconds first{-1};
+        for (std::size_t pos = static_cast<std::size_t>(block.offset); pos < bytes.size(); )
+        {
+            uint32_t word;
+            std::memcpy(&word, bytes.data() + pos, sizeof(word));
+            if (not (word & ESCAPE))
+            {
+                first = block.reference + nanoseconds{word};
+                break;
+            }
+            if (word == (ESCAPE | Command::UPDATE_REFERENCE))
+            {
+                uint64_t reference;
+                std::memcpy(&reference, bytes.data() + pos + sizeof(word), sizeof(reference));
+                first = nanoseconds{reference};
+                break;
+            }
+            pos += element_size(word);
+        }
+        CHECK(first == block.begin, "block not decodable from its offset");
+        index += block.samples;
+    }
+    CHECK(index == samples.size(), "samples missing from the blocks");
+
+    // Editing the metadata as the monitor does keeps the index
+    TickMetadata edited = parser.metadata();
+    edited.display_name = "renamed";
+    edited.default_visibility = 0;
+    {
+        File rw(tick_file.string());
+        CHECK(not rw.open(access::Mode::READ_WRITE), "cannot open the recording for writing");
+        save_metadata(rw, parser.header(), edited);
+    }
+
+    auto reopened_io = std::make_unique<File>(tick_file.string());
+    CHECK(not reopened_io->open(access::Mode::READ_ONLY), "cannot reopen the recording");
+    Parser reopened(std::move(reopened_io));
+    reopened.load_header();
+    reopened.load_metadata();
+    CHECK(reopened.metadata().display_name == "renamed" and reopened.metadata().default_visibility == 0,
+          "metadata not saved");
+    SummaryBlock kept;
+    CHECK(reopened.overview(kept) and kept.samples == overview.samples, "summary index lost by the edit");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_connect_storm()
+{
+    std::size_t const PROBES = storm_size(512);
+    CHECK(PROBES >= 16, "too few file descriptors for a connect storm");
+
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_storm";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    std::string sock_path = (fs::temp_directory_path() / "rtm_storm.sock").string();
+
+    Recorder recorder(tmp_dir.string());
+    LocalListener listener(sock_path);
+    CHECK(not listener.listen(LISTEN_BACKLOG), "local listen() failed");
+
+    // A fleet restart: every probe connects before the recorder wakes up
+    auto begin = since_epoch();
+    std::vector<std::unique_ptr<LocalSocket>> probes;
+    for (std::size_t i = 0; i < PROBES; ++i)
+    {
+        probes.push_back(std::make_unique<LocalSocket>(sock_path));
+        CHECK(not probes.back()->open(access::Mode::READ_WRITE | access::Mode::NON_BLOCKING), "connection refused: backlog full");
+    }
+    auto connected = since_epoch();
+
+    // A single wakeup accepts them all
+    while (auto io = listener.accept(access::Mode::NON_BLOCKING))
+    {
+        recorder.add_client(std::move(io));
+    }
+    recorder.process();
+    auto accepted = since_epoch();
+    CHECK(recorder.stats().clients == PROBES, "pending connections left in the backlog");
+
+    printf("  %zu probes: connected in %.2f ms, accepted in %.2f ms\n", PROBES,
+           milliseconds_f(connected - begin).count(),
+           milliseconds_f(accepted - connected).count());
+
+    probes.clear();
+    recorder.process();
+    CHECK(recorder.stats().clients == 0, "disconnections not handled");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_mapped_parser()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_mapped";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    auto tick_path = tmp_dir / "mapped.tick";
+
+    {
+        auto io = std::make_unique<File>(tick_path.string());
+        CHECK(not io->open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE), "cannot open file for writing");
+        send_probe_data(std::move(io));
+    }
+
+    auto parse = [](std::unique_ptr<AbstractIO> io)
+    {
+        auto parser = std::make_unique<Parser>(std::move(io));
+        parser->load_header();
+        parser->load_samples();
+        return parser;
+    };
+
+    // Complete file, then truncated in the middle of an element: both backends agree
+    auto full_size = fs::file_size(tick_path);
+    for (auto size : {full_size, full_size / 2 + 1})
+    {
+        fs::resize_file(tick_path, size);
+
+        auto file = std::make_unique<File>(tick_path.string());
+        CHECK(not file->open(access::Mode::READ_ONLY), "cannot open file for reading");
+        auto mapped = std::make_unique<MappedFile>(tick_path.string());
+        CHECK(not mapped->open(access::Mode::READ_ONLY), "cannot map file");
+        CHECK(mapped->size() == size and mapped->data() != nullptr, "wrong mapping");
+
+        auto expected = parse(std::move(file));
+        auto actual = parse(std::move(mapped));
+        CHECK(actual->header().name == "test_task", "wrong task name");
+        CHECK(actual->header().data_version == expected->header().data_version, "wrong data version");
+        CHECK(actual->samples() == expected->samples(), "samples differ");
+        CHECK(actual->header().sentinel_pos == expected->header().sentinel_pos, "sentinel position differs");
+        CHECK(actual->dropped() == expected->dropped(), "gap count differs");
+
+        if (size == full_size)
+        {
+            CHECK(actual->samples().size() == 2 * NUM_SAMPLES, "unexpected sample count");
+            CHECK(actual->header().sentinel_pos == static_cast<int64_t>(full_size) - 4, "sentinel not found");
+        }
+        else
+        {
+            CHECK(actual->header().needs_sentinel_repair() > 0, "truncation not detected");
+            CHECK(actual->header().needs_sentinel_repair() % 4 == 0, "repair would keep a partial element");
+        }
+    }
+
+    // Nothing to map
+    fs::resize_file(tick_path, 0);
+    auto empty = std::make_unique<MappedFile>(tick_path.string());
+    CHECK(not empty->open(access::Mode::READ_ONLY), "cannot open an empty file");
+    uint8_t byte;
+    CHECK(empty->size() == 0 and empty->read(&byte, 1) == 0, "empty file not empty");
+    CHECK(empty->write(&byte, 1) < 0, "write on a read-only mapping");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_parallel_parser()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_parallel";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    auto tick_path = tmp_dir / "parallel.tick";
+
+    // ~12 MiB of samples, with a reference update every 1000 samples and commands whose
+    // payload looks like a reference update: the splits must survive the false candidates.
+    auto stream = build_tick_header({}, START, "test_process", "test_task");
+    auto push = [&stream](auto value)
+    {
+        uint8_t const* raw = reinterpret_cast<uint8_t const*>(&value);
+        stream.insert(stream.end(), raw, raw + sizeof(value));
+    };
+    constexpr uint64_t DECOY = (uint64_t{ESCAPE | Command::UPDATE_REFERENCE} << 32) | (ESCAPE | Command::UPDATE_REFERENCE);
+    nanoseconds reference = START;
+    for (uint32_t i = 0; i < 1'500'000; ++i)
+    {
+        if (i % 1000 == 0)
+        {
+            reference += 3s;
+            push(uint32_t{ESCAPE | Command::UPDATE_REFERENCE});
+            push(static_cast<uint64_t>(reference.count()));
+        }
+        if (i % 1000 == 500)
+        {
+            push(uint32_t{ESCAPE | Command::SET_THRESHOLD});
+            push(DECOY);
+        }
+        if (i % 100'000 == 7)
+        {
+            push(uint32_t{ESCAPE | Command::DATA_GAP});
+            push(uint64_t{3});
+        }
+        push(static_cast<uint32_t>((i % 1000) * 1'000'000));
+        push(static_cast<uint32_t>((i % 1000) * 1'000'000 + 100'000));
+    }
+    push(uint32_t{ESCAPE | Command::DATA_STREAM_END});
+
+    {
+        // Written through the recorder decorator to get a summary index
+        SummaryIO io(std::make_unique<File>(tick_path.string()), tick_path.string());
+        CHECK(not io.open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE), "cannot open file for writing");
+        CHECK(io.write(stream.data(), static_cast<int64_t>(stream.size())) == static_cast<int64_t>(stream.size()), "short write");
+    }
+
+    auto open_parser = [](fs::path const& path)
+    {
+        auto io = std::make_unique<MappedFile>(path.string());
+        io->open(access::Mode::READ_ONLY);
+        auto parser = std::make_unique<Parser>(std::move(io));
+        parser->load_header();
+        return parser;
+    };
+
+    auto expected = open_parser(tick_path);
+    CHECK(expected->load_samples(), "failed to load samples");
+    CHECK(expected->samples().size() == 3'000'000 + 1'500, "unexpected sample count");
+    CHECK(expected->dropped() == 15 * 3, "unexpected gap count");
+
+    for (bool indexed : {false, true})
+    {
+        for (std::size_t threads : {2, 3, 8})
+        {
+            auto actual = open_parser(tick_path);
+            if (indexed)
+            {
+                actual->load_metadata();
+                CHECK(not actual->summary().empty(), "no summary index");
+            }
+            CHECK(actual->load_samples_parallel(threads), "failed to load samples in parallel");
+
+            CHECK(actual->samples() == expected->samples(), "samples differ");
+            CHECK(actual->header().sentinel_pos == expected->header().sentinel_pos, "sentinel position differs");
+            CHECK(actual->dropped() == expected->dropped(), "gap count differs");
+            CHECK(actual->begin() == expected->begin() and actual->end() == expected->end(), "time range differs");
+        }
+    }
+
+    // Truncated in the middle of an element
+    fs::resize_file(tick_path, fs::file_size(tick_path) / 2 + 3);
+    expected = open_parser(tick_path);
+    expected->load_samples();
+    auto actual = open_parser(tick_path);
+    actual->load_samples_parallel(4);
+    CHECK(actual->samples() == expected->samples(), "truncated samples differ");
+    CHECK(actual->header().sentinel_pos == expected->header().sentinel_pos, "truncated sentinel position differs");
+    CHECK(actual->header().needs_sentinel_repair() > 0, "truncation not detected");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_time_range()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_range";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    auto tick_path = tmp_dir / "range.tick";
+
+    // 10 minutes of 1 kHz loop, a reference update every second: ~18 summary blocks
+    auto stream = build_tick_header({}, START, "test_process", "test_task");
+    auto push = [&stream](auto value)
+    {
+        uint8_t const* raw = reinterpret_cast<uint8_t const*>(&value);
+        stream.insert(stream.end(), raw, raw + sizeof(value));
+    };
+    for (uint32_t i = 0; i < 600'000; ++i)
+    {
+        uint32_t delta = (i % 1000) * 1'000'000;
+        if (delta == 0)
+        {
+            push(uint32_t{ESCAPE | Command::UPDATE_REFERENCE});
+            push(static_cast<uint64_t>((START + seconds(i / 1000)).count()));
+        }
+        else
+        {
+            push(delta);
+        }
+        push(delta + 100'000);
+    }
+    push(uint32_t{ESCAPE | Command::DATA_STREAM_END});
+
+    {
+        SummaryIO io(std::make_unique<File>(tick_path.string()), tick_path.string());
+        CHECK(not io.open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE), "cannot open file for writing");
+        CHECK(io.write(stream.data(), static_cast<int64_t>(stream.size())) == static_cast<int64_t>(stream.size()), "short write");
+    }
+
+    auto load = [&](bool indexed, nanoseconds begin, nanoseconds end)
+    {
+        auto io = std::make_unique<MappedFile>(tick_path.string());
+        io->open(access::Mode::READ_ONLY);
+        auto parser = std::make_unique<Parser>(std::move(io));
+        parser->load_header();
+        if (indexed)
+        {
+            parser->load_metadata();
+        }
+        parser->load_samples(begin, end);
+        return parser;
+    };
+
+    auto full = load(false, 0ns, 0ns);
+    auto const& all = full->samples();
+    CHECK(all.size() == 1'200'000, "unexpected sample count");
+    CHECK(full->header().sentinel_pos > 0, "sentinel not found");
+
+    struct Range { nanoseconds begin; nanoseconds end; nanoseconds first; nanoseconds last; };
+    Range const ranges[] =
+    {
+        {-5min,     0ns,    all.back() - 5min,  all.back()},    // the last 5 minutes
+        {10s,       20s,    10s,                20s},
+        {-20s,      -10s,   all.back() - 20s,   all.back() - 10s},
+        {12050us,   12060us, 12050us,           12060us},       // within a loop
+    };
+    for (auto const& range : ranges)
+    {
+        auto indexed = load(true, range.begin, range.end);
+        CHECK(not indexed->summary().empty(), "no summary index");
+        auto scanned = load(false, range.begin, range.end);
+        CHECK(indexed->samples() == scanned->samples(), "indexed and scanned loads differ");
+
+        auto const& samples = indexed->samples();
+        CHECK(not samples.empty() and samples.size() % 2 == 0, "not whole pairs");
+        CHECK(samples[1] >= range.first and samples[samples.size() - 2] <= range.last, "range not honored");
+        CHECK(samples.front() <= range.first + 1ms and samples.back() >= range.last - 1ms, "range too short");
+
+        // A contiguous run of the file, starting with a loop start
+        auto it = std::search(all.begin(), all.end(), samples.begin(), samples.end());
+        CHECK(it != all.end() and (it - all.begin()) % 2 == 0, "not the file samples");
+    }
+
+    // Only the last blocks are decoded: the sentinel is checked
+    auto last = load(true, -1s, 0ns);
+    CHECK(last->header().sentinel_pos == full->header().sentinel_pos, "sentinel not found");
+
+    auto none = load(true, 1h, 0ns);
+    CHECK(none->samples().empty(), "samples after the end");
+
+    // Without index, reference updates on the end of a loop: the pairs are kept whole
+    stream = build_tick_header({}, START, "test_process", "test_task");
+    for (uint32_t i = 0; i < 200'000; ++i)
+    {
+        uint32_t delta = (i % 1000) * 1'000'000;
+        push(delta + 500'000);
+        if (i % 1000 == 999)
+        {
+            push(uint32_t{ESCAPE | Command::UPDATE_REFERENCE});
+            push(static_cast<uint64_t>((START + seconds(i / 1000 + 1)).count()));
+        }
+        else
+        {
+            push(delta + 600'000);
+        }
+    }
+    push(uint32_t{ESCAPE | Command::DATA_STREAM_END});
+    {
+        File io(tick_path.string());
+        CHECK(not io.open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE), "cannot open file for writing");
+        CHECK(io.write(stream.data(), static_cast<int64_t>(stream.size())) == static_cast<int64_t>(stream.size()), "short write");
+    }
+    full = load(false, 0ns, 0ns);
+    auto tail = load(false, -20s, 0ns);
+    auto const& samples = tail->samples();
+    CHECK(not samples.empty() and samples.size() % 2 == 0, "not whole pairs");
+    CHECK(samples.front() >= full->samples().back() - 20s - 1ms, "range not honored");
+    auto it = std::search(full->samples().begin(), full->samples().end(), samples.begin(), samples.end());
+    CHECK(it != full->samples().end() and (it - full->samples().begin()) % 2 == 0, "pairs split");
+    CHECK(tail->header().sentinel_pos == full->header().sentinel_pos, "sentinel not found");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_delta_decode()
+{
+    printf("  decode_deltas: %s\n", decode_deltas_isa());
+
+    // Runs of every length around the vector widths, at every alignment, with an escaped
+    // word at every position: the vector path must agree with the scalar one.
+    std::vector<uint32_t> words(64);
+    for (std::size_t i = 0; i < words.size(); ++i)
+    {
+        words[i] = static_cast<uint32_t>(rand()) & ~ESCAPE;
+    }
+    words[3] = ESCAPE - 1; // largest plain delta
+
+    std::vector<uint8_t> bytes(words.size() * sizeof(uint32_t) + sizeof(uint32_t));
+    std::vector<nanoseconds> expected(words.size());
+    std::vector<nanoseconds> actual(words.size());
+    nanoseconds const reference = -1s; // the first reference can be before the start time
+
+    for (std::size_t misalign = 0; misalign < sizeof(uint32_t); ++misalign)
+    {
+        for (std::size_t escape = 0; escape <= words.size(); ++escape)
+        {
+            auto stream = words;
+            if (escape < stream.size())
+            {
+                stream[escape] = ESCAPE | Command::UPDATE_REFERENCE;
+            }
+            std::memcpy(bytes.data() + misalign, stream.data(), stream.size() * sizeof(uint32_t));
+
+            for (std::size_t count = 0; count <= words.size(); ++count)
+            {
+                std::fill(expected.begin(), expected.end(), 0ns);
+                std::fill(actual.begin(), actual.end(), 0ns);
+                std::size_t n = decode_deltas_scalar(bytes.data() + misalign, count, reference, expected.data());
+                CHECK(n == std::min(count, escape), "scalar decoder did not stop on the escaped word");
+                CHECK(decode_deltas(bytes.data() + misalign, count, reference, actual.data()) == n, "decoders stop apart");
+                CHECK(delta_run(bytes.data() + misalign, count) == n, "run length differs from the decoders");
+                CHECK(actual == expected, "decoders disagree");
+            }
+        }
+    }
+    CHECK(expected[3] == reference + nanoseconds{ESCAPE - 1}, "wrong widening");
+
+    return true;
+}
+
+
+bool test_visit()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_visit";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    auto tick_path = tmp_dir / "visit.tick";
+
+    {
+        auto io = std::make_unique<File>(tick_path.string());
+        CHECK(not io->open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE), "cannot open file for writing");
+
+        Probe probe;
+        probe.init("test_process", "test_task", START, 1ms, 42, std::move(io));
+        probe.set_threshold(2ms);
+        probe.set_trigger({TriggerKind::UP_TIME, 1, 0, 500'000});
+        for (int i = 0; i < NUM_SAMPLES; ++i)
+        {
+            auto t = START + 20ms + nanoseconds(i * 1'000'000);
+            probe.log(t);
+            probe.log(t + 100us);
+        }
+        probe.log(START + 1h); // a reference update, then a start without its end
+    }
+
+    auto open_parser = [&]()
+    {
+        auto io = std::make_unique<File>(tick_path.string());
+        io->open(access::Mode::READ_ONLY);
+        auto parser = std::make_unique<Parser>(std::move(io));
+        parser->load_header();
+        return parser;
+    };
+
+    struct Recorded final : TickVisitor
+    {
+        std::vector<nanoseconds> samples;
+        nanoseconds period{0};
+        int32_t priority{0};
+        nanoseconds threshold{0};
+        TriggerRule rule{};
+
+        bool on_loop(nanoseconds start, nanoseconds end) override
+        {
+            samples.push_back(start);
+            samples.push_back(end);
+            return true;
+        }
+        void on_period(nanoseconds p) override             { period = p; }
+        void on_priority(int32_t p) override               { priority = p; }
+        void on_threshold(nanoseconds t) override          { threshold = t; }
+        void on_trigger(TriggerRule const& r) override     { rule = r; }
+    } recorded;
+
+    auto expected = open_parser();
+    CHECK(expected->load_samples(), "failed to load samples");
+    CHECK(expected->samples().size() == 2 * NUM_SAMPLES + 1, "unexpected sample count");
+
+    auto visited = open_parser();
+    CHECK(visited->visit(recorded), "visit stopped");
+    CHECK(visited->samples().empty(), "samples stored");
+    CHECK(recorded.samples.size() == 2 * NUM_SAMPLES, "wrong loop count");
+    CHECK(std::equal(recorded.samples.begin(), recorded.samples.end(), expected->samples().begin()), "loops differ from samples");
+    CHECK(recorded.period == 1ms and recorded.priority == 42, "wrong period or priority");
+    CHECK(recorded.threshold == 2ms, "wrong threshold");
+    CHECK(recorded.rule.kind == TriggerKind::UP_TIME and recorded.rule.value == 500'000, "wrong trigger");
+    CHECK(visited->header().sentinel_pos == expected->header().sentinel_pos, "sentinel position differs");
+
+    // Stopped by the callback
+    int loops = 0;
+    auto stopped = open_parser();
+    CHECK(not stopped->visit([&](nanoseconds, nanoseconds) { return ++loops < 10; }), "visit not stopped");
+    CHECK(loops == 10, "visited after the stop");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_fused_series()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_fused";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    auto tick_path = tmp_dir / "fused.tick";
+
+    {
+        auto io = std::make_unique<File>(tick_path.string());
+        CHECK(not io->open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE), "cannot open file for writing");
+
+        Probe probe;
+        probe.init("test_process", "test_task", START, 1ms, 42, std::move(io));
+        for (int i = 0; i < NUM_SAMPLES; ++i)
+        {
+            auto t = START + 20ms + nanoseconds(i * i * 10'000);
+            probe.log(t);
+            probe.log(t + nanoseconds(i * 1'000));
+        }
+        probe.log(START + 1h); // a start without its end
+    }
+
+    auto open_parser = [&]()
+    {
+        auto io = std::make_unique<MappedFile>(tick_path.string());
+        io->open(access::Mode::READ_ONLY);
+        auto parser = std::make_unique<Parser>(std::move(io));
+        parser->load_header();
+        return parser;
+    };
+
+    auto expected = open_parser();
+    CHECK(expected->load_samples(), "failed to load samples");
+    auto diff = expected->generate_times_diff();
+    auto up = expected->generate_times_up();
+
+    auto fused = open_parser();
+    TickSeries series;
+    CHECK(fused->load_series(series), "failed to load series");
+    CHECK(fused->samples().empty(), "samples stored");
+
+    auto same = [](std::vector<Point> const& a, std::vector<Point> const& b)
+    {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                          [](Point const& l, Point const& r) { return l.x == r.x and l.y == r.y; });
+    };
+    CHECK(same(series.diff, diff), "diff series differ");
+    CHECK(same(series.up, up), "up series differ");
+
+    CHECK(fused->begin() == expected->begin() and fused->end() == expected->end(), "time range differs");
+    CHECK(fused->diff_min() == expected->diff_min() and fused->diff_max() == expected->diff_max(), "diff bounds differ");
+    CHECK(fused->up_min() == expected->up_min() and fused->up_max() == expected->up_max(), "up bounds differ");
+
+    CHECK(series.up_stats.count == NUM_SAMPLES and series.diff_stats.count == NUM_SAMPLES, "wrong statistics count");
+    CHECK(series.up_stats.min == 0 and series.up_stats.max == (NUM_SAMPLES - 1) * 1'000, "wrong up statistics");
+    CHECK(series.up_stats.mean() == (NUM_SAMPLES - 1) * 500.0, "wrong up mean");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+bool test_follow()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_follow";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    auto source_path = tmp_dir / "source.tick";
+    auto growing_path = tmp_dir / "growing.tick";
+
+    {
+        auto io = std::make_unique<File>(source_path.string());
+        CHECK(not io->open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE), "cannot open file for writing");
+        send_probe_data(std::move(io));
+    }
+
+    auto source_io = std::make_unique<File>(source_path.string());
+    CHECK(not source_io->open(access::Mode::READ_ONLY), "cannot open source file");
+    Parser expected(std::move(source_io));
+    expected.load_header();
+    CHECK(expected.load_samples(), "failed to load the source file");
+    auto expected_diff = expected.generate_times_diff();
+    auto expected_up = expected.generate_times_up();
+
+    std::vector<uint8_t> bytes(fs::file_size(source_path));
+    {
+        File source(source_path.string());
+        CHECK(not source.open(access::Mode::READ_ONLY), "cannot open source file");
+        CHECK(source.read(bytes.data(), static_cast<int64_t>(bytes.size())) == static_cast<int64_t>(bytes.size()), "short read");
+    }
+
+    // The writer appends the stream in slices which tear elements apart, the reader polls in between
+    File writer(growing_path.string());
+    CHECK(not writer.open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE), "cannot open growing file");
+    std::size_t written = expected.header().data_section_offset + 8;
+    CHECK(writer.write(bytes.data(), static_cast<int64_t>(written)) == static_cast<int64_t>(written), "short write");
+
+    auto reader = std::make_unique<File>(growing_path.string());
+    CHECK(not reader->open(access::Mode::READ_ONLY), "cannot open growing file for reading");
+    Parser follower(std::move(reader));
+    follower.load_header();
+    CHECK(follower.poll_samples() == 0, "samples without data");
+
+    std::vector<Point> diff;
+    std::vector<Point> up;
+    constexpr std::size_t SLICE = 37; // not a multiple of an element size
+    while (written < bytes.size())
+    {
+        std::size_t size = std::min(SLICE, bytes.size() - written);
+        CHECK(writer.write(bytes.data() + written, static_cast<int64_t>(size)) == static_cast<int64_t>(size), "short write");
+        written += size;
+
+        std::size_t from = follower.samples().size();
+        std::size_t count = follower.poll_samples();
+        CHECK(follower.samples().size() == from + count, "wrong new samples count");
+        if (written < bytes.size())
+        {
+            CHECK(follower.header().needs_sentinel_repair() > 0, "a growing file looks complete");
+        }
+
+        auto new_diff = follower.generate_times_diff(from);
+        auto new_up = follower.generate_times_up(from);
+        diff.insert(diff.end(), new_diff.begin(), new_diff.end());
+        up.insert(up.end(), new_up.begin(), new_up.end());
+    }
+
+    CHECK(follower.samples() == expected.samples(), "followed samples differ");
+    CHECK(follower.header().sentinel_pos == expected.header().sentinel_pos, "sentinel not found");
+    CHECK(follower.begin() == expected.begin() and follower.end() == expected.end(), "wrong time range");
+    CHECK(follower.dropped() == expected.dropped(), "gap count differs");
+
+    auto same = [](std::vector<Point> const& a, std::vector<Point> const& b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (std::size_t i = 0; i < a.size(); ++i)
+        {
+            if (a[i].x != b[i].x or a[i].y != b[i].y)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+    CHECK(same(diff, expected_diff), "incremental diff serie differs");
+    CHECK(same(up, expected_up), "incremental up serie differs");
+    CHECK(follower.diff_max() == expected.diff_max() and follower.up_min() == expected.up_min(), "wrong min/max");
+
+    // Past the sentinel, nothing more is decoded
+    uint32_t garbage = 0xdeadbeef;
+    writer.write(&garbage, sizeof(garbage));
+    CHECK(follower.poll_samples() == 0, "decoded past the sentinel");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+bool test_lod_cache()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_lod_cache";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    auto tick_path = (tmp_dir / "cached.tick").string();
+
+    {
+        auto io = std::make_unique<File>(tick_path);
+        CHECK(not io->open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE), "cannot open file for writing");
+        send_probe_data(std::move(io));
+    }
+
+    auto io = std::make_unique<File>(tick_path);
+    CHECK(not io->open(access::Mode::READ_ONLY), "cannot open file for reading");
+    Parser parser(std::move(io));
+    parser.load_header();
+    CHECK(parser.load_samples(), "failed to load samples");
+    auto diff = parser.generate_times_diff();
+    auto up = parser.generate_times_up();
+    constexpr uint32_t OVERVIEW = 10;
+    auto diff_overview = lttb(diff, OVERVIEW);
+    auto up_overview = lttb(up, OVERVIEW);
+
+    auto uuid = parser.header().uuid;
+    LodKey key = LodCache::key_of(tick_path, uuid, OVERVIEW);
+    CHECK(key.file_size == fs::file_size(tick_path), "wrong key size");
+
+    LodCache missing;
+    CHECK(missing.open(tick_path, key), "opened a missing cache");
+
+    // Laid out as the monitor does: the series cut in sections, by column
+    struct Built
+    {
+        std::vector<Columns> sections;
+        Columns overview;
+    };
+    auto build = [](std::vector<Point> const& points, std::vector<Point> const& overview)
+    {
+        Built built;
+        std::size_t half = points.size() / 2;
+        built.sections.emplace_back(points.data(), points.data() + half);
+        built.sections.emplace_back(points.data() + half, points.data() + points.size());
+        built.overview = Columns{overview.data(), overview.data() + overview.size()};
+        return built;
+    };
+    auto view = [](Built const& built, milliseconds_f min, milliseconds_f max)
+    {
+        LodSerie serie;
+        for (auto const& section : built.sections)
+        {
+            serie.sections.push_back({section.x(0), section.x(section.size() - 1), section.span()});
+        }
+        serie.overview = built.overview.span();
+        serie.min = min;
+        serie.max = max;
+        return serie;
+    };
+    Built diff_columns = build(diff, diff_overview);
+    Built up_columns = build(up, up_overview);
+
+    LodContent content;
+    content.begin = parser.begin();
+    content.end = parser.end();
+    content.sentinel_pos = parser.header().sentinel_pos;
+    content.diff = view(diff_columns, parser.diff_min(), parser.diff_max());
+    content.up = view(up_columns, parser.up_min(), parser.up_max());
+    CHECK(not LodCache::write(tick_path, key, content), "cannot write the cache");
+    CHECK(fs::exists(tick_path + LodCache::EXTENSION), "no cache file");
+
+    auto same_columns = [](ColumnSpan const& span, Columns const& columns)
+    {
+        Columns copy{span};
+        if (copy.size() != columns.size())
+        {
+            return false;
+        }
+        for (std::size_t i = 0; i < columns.size(); ++i)
+        {
+            if (copy.x(i) != columns.x(i) or copy.y(i) != columns.y(i))
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto same = [&](LodSerie const& serie, Built const& built)
+    {
+        if (serie.sections.size() != built.sections.size())
+        {
+            return false;
+        }
+        for (std::size_t i = 0; i < built.sections.size(); ++i)
+        {
+            auto const& section = serie.sections[i];
+            if (section.min != built.sections[i].x(0) or not same_columns(section.points, built.sections[i]))
+            {
+                return false;
+            }
+        }
+        return same_columns(serie.overview, built.overview);
+    };
+
+    {
+        LodCache cache;
+        CHECK(not cache.open(tick_path, key), "cannot open the cache");
+        auto const& cached = cache.content();
+        CHECK(cached.begin == parser.begin() and cached.end == parser.end(), "wrong bounds");
+        CHECK(cached.sentinel_pos == parser.header().sentinel_pos and cached.sentinel_pos > 0, "wrong sentinel position");
+        CHECK(same(cached.diff, diff_columns), "wrong diff serie");
+        CHECK(same(cached.up, up_columns), "wrong up serie");
+        CHECK(cached.diff.overview.size == OVERVIEW, "overview not downsampled");
+        CHECK(cached.diff.max == parser.diff_max() and cached.up.min == parser.up_min(), "wrong min/max");
+    }
+
+    // The quota accounts the cache with its recording
+    {
+        Retention retention{tmp_dir.string()};
+        retention.set_quota(1ull << 40);
+        while (retention.scanning())
+        {
+            retention.enforce();
+        }
+        CHECK(retention.used() == fs::file_size(tick_path) + fs::file_size(tick_path + LodCache::EXTENSION),
+              "cache not accounted");
+    }
+
+    // Another overview size, another file, or the file changed: the cache is stale
+    LodCache stale;
+    CHECK(stale.open(tick_path, LodCache::key_of(tick_path, uuid, OVERVIEW * 2)), "opened with another overview size");
+    auto other_uuid = uuid;
+    other_uuid[0] ^= 0xff;
+    CHECK(stale.open(tick_path, LodCache::key_of(tick_path, other_uuid, OVERVIEW)), "opened for another file");
+    fs::last_write_time(tick_path, fs::last_write_time(tick_path) + 1s);
+    CHECK(stale.open(tick_path, LodCache::key_of(tick_path, uuid, OVERVIEW)), "opened a stale cache");
+
+    // Corrupted: truncated in the middle of its arrays
+    key = LodCache::key_of(tick_path, uuid, OVERVIEW);
+    CHECK(not LodCache::write(tick_path, key, content), "cannot rewrite the cache");
+    CHECK(not stale.open(tick_path, key), "cannot reopen the rewritten cache");
+    fs::resize_file(tick_path + LodCache::EXTENSION, fs::file_size(tick_path + LodCache::EXTENSION) / 2);
+    LodCache corrupted;
+    CHECK(corrupted.open(tick_path, key), "opened a truncated cache");
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+bool test_fanout_late_subscriber()
+{
+    auto tmp_dir = fs::temp_directory_path() / "rtm_test_fanout_late";
+    fs::remove_all(tmp_dir);
+    fs::create_directories(tmp_dir);
+    std::string sock_path = (fs::temp_directory_path() / "rtm_fanout_late.sock").string();
+    std::string subscribe_path = (fs::temp_directory_path() / "rtm_fanout_late_sub.sock").string();
+
+    // The probe stream, replayed in two parts around the arrival of the subscriber
+    auto source_path = tmp_dir / "source.tick";
+    {
+        auto io = std::make_unique<File>(source_path.string());
+        CHECK(not io->open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE), "cannot open file for writing");
+        send_probe_data(std::move(io));
+    }
+    std::vector<uint8_t> bytes(fs::file_size(source_path));
+    {
+        File source(source_path.string());
+        CHECK(not source.open(access::Mode::READ_ONLY), "cannot open source file");
+        CHECK(source.read(bytes.data(), static_cast<int64_t>(bytes.size())) == static_cast<int64_t>(bytes.size()), "short read");
+    }
+    auto source_io = std::make_unique<File>(source_path.string());
+    CHECK(not source_io->open(access::Mode::READ_ONLY), "cannot open source file");
+    Parser source(std::move(source_io));
+    source.load_header();
+    CHECK(source.load_samples(), "failed to load the source");
+
+    // Cut on either parity of the stream (deltas are 4 bytes), in the middle of an element too
+    std::size_t const middle = bytes.size() / 2 / 4 * 4;
+    for (std::size_t cut : {middle, middle + 4 + 2})
+    {
+        fs::path output_path = tmp_dir / ("late_" + std::to_string(cut) + ".tick");
+
+        Recorder recorder((tmp_dir / ("recording_" + std::to_string(cut))).string());
+        recorder.enable_fanout();
+        LocalListener listener(sock_path);
+        LocalListener subscribe_listener(subscribe_path);
+        CHECK(not listener.listen(1), "local listen() failed");
+        CHECK(not subscribe_listener.listen(1), "subscriber listen() failed");
+
+        std::atomic<int> step{0}; // 1: first part sent, 2: subscriber accepted
+        std::thread probe_thread([&]()
+        {
+            LocalSocket io{sock_path};
+            if (io.open(access::Mode::READ_WRITE))
+            {
+                printf("  probe connect failed\n");
+                return;
+            }
+            io.write(bytes.data(), static_cast<int64_t>(cut));
+            step = 1;
+            while (step != 2)
+            {
+                sleep(1ms);
+            }
+            sleep(50ms);
+            io.write(bytes.data() + cut, static_cast<int64_t>(bytes.size() - cut));
+        });
+
+        std::thread subscriber_thread([&]()
+        {
+            while (step != 1)
+            {
+                sleep(1ms);
+            }
+            sleep(50ms);
+            LocalSocket io{subscribe_path};
+            if (io.open(access::Mode::READ_WRITE))
+            {
+                printf("  subscriber connect failed\n");
+                return;
+            }
+
+            auto read_exactly = [&io](void* data, std::size_t size)
+            {
+                auto* out = static_cast<uint8_t*>(data);
+                while (size > 0)
+                {
+                    int64_t r = io.read(out, static_cast<int64_t>(size));
+                    if (r <= 0)
+                    {
+                        return false;
+                    }
+                    out += r;
+                    size -= static_cast<std::size_t>(r);
+                }
+                return true;
+            };
+
+            // The reference of the BEGIN frame is the state, not a sample: written as one, it is
+            // dropped from the comparison below.
+            File output{output_path.string()};
+            output.open(access::Mode::WRITE_ONLY | access::Mode::TRUNCATE);
+            fanout::FrameHeader frame;
+            while (read_exactly(&frame, sizeof(frame)))
+            {
+                std::vector<uint8_t> payload(frame.size);
+                if (not read_exactly(payload.data(), payload.size()))
+                {
+                    break;
+                }
+
+                if (frame.type == fanout::CLIENT_BEGIN)
+                {
+                    output.write(payload.data() + sizeof(uint64_t), static_cast<int64_t>(payload.size() - sizeof(uint64_t)));
+                    uint32_t command = ESCAPE | Command::UPDATE_REFERENCE;
+                    output.write(&command, sizeof(command));
+                    output.write(payload.data(), sizeof(uint64_t));
+                }
+                else if (frame.type == fanout::CLIENT_DATA)
+                {
+                    output.write(payload.data(), static_cast<int64_t>(payload.size()));
+                }
+                else if (frame.type == fanout::CLIENT_END)
+                {
+                    break;
+                }
+            }
+        });
+
+        auto deadline = since_epoch() + 1s;
+        while (since_epoch() < deadline)
+        {
+            if (auto subscriber = subscribe_listener.accept(access::Mode::NON_BLOCKING))
+            {
+                recorder.add_subscriber(std::move(subscriber));
+                step = 2;
+            }
+            if (auto io = listener.accept(access::Mode::NON_BLOCKING))
+            {
+                recorder.add_client(std::move(io));
+            }
+            recorder.process();
+            sleep(1ms);
+        }
+        probe_thread.join();
+        subscriber_thread.join();
+
+        auto io = std::make_unique<File>(output_path.string());
+        CHECK(not io->open(access::Mode::READ_ONLY), "no output for the late subscriber");
+        Parser late(std::move(io));
+        late.load_header();
+        CHECK(late.load_samples(), "the late subscriber got no samples");
+
+        std::vector<nanoseconds> received(late.samples().begin() + 1, late.samples().end());
+        auto const& expected = source.samples();
+        CHECK(not received.empty() and received.size() < expected.size(), "the late subscriber got the whole stream");
+        CHECK(received.size() % 2 == 0, "the late subscriber does not start on a pair");
+        CHECK(std::equal(received.begin(), received.end(), expected.end() - static_cast<std::ptrdiff_t>(received.size())),
+              "the late subscriber samples differ");
+    }
+
+    fs::remove_all(tmp_dir);
+    return true;
+}
+
+
+bool test_udp_configuration()
+{
+    std::vector<std::vector<uint8_t>> datagrams;
+    {
+        auto io = std::make_unique<DatagramWriter>(std::make_unique<CaptureIO>(datagrams));
+        CHECK(not io->open(access::Mode::READ_WRITE), "cannot open the datagram writer");
+
+        Probe probe;
+        probe.init("test_process", "test_task", START, 1ms, 42, std::move(io));
+        probe.set_threshold(5ms);
+        for (int i = 0; i < NUM_SAMPLES; ++i)
+        {
+            if (i == NUM_SAMPLES / 2)
+            {
+                probe.set_trigger({TriggerKind::UP_TIME, 0, 0, 500'000});
+            }
+            auto t = START + 20ms + nanoseconds(i * 1'000'000);
+            probe.log(t);
+            probe.log(t + 100us);
+            probe.flush();
+        }
+    }
+
+    // Lose every data datagram carrying the configuration: the headers must restore it
+    DatagramAssembler assembler(1s);
+    std::vector<std::unique_ptr<AbstractIO>> started;
+    uint64_t lost = 0;
+    for (auto const& datagram : datagrams)
+    {
+        datagram::Header header;
+        std::memcpy(&header, datagram.data(), sizeof(header));
+        if (header.type == datagram::STREAM_DATA)
+        {
+            auto commands = stream_commands(datagram.data() + sizeof(header), datagram.data() + datagram.size());
+            bool configures = std::any_of(commands.begin(), commands.end(), [](uint32_t command)
+            {
+                return command & (Command::SET_THRESHOLD | Command::SET_TRIGGER);
+            });
+            if (configures)
+            {
+                ++lost;
+                continue;
+            }
+        }
+        assembler.dispatch("probe", datagram.data(), datagram.size(), 0ns, started);
+    }
+    CHECK(lost == 2, "configuration not sent in its own datagrams");
+    CHECK(assembler.dropped() == lost, "losses not detected");
+    CHECK(started.size() == 1, "stream not started");
+
+    std::vector<uint8_t> stream(64 * 1024);
+    int64_t size = started[0]->read(stream.data(), static_cast<int64_t>(stream.size()));
+    CHECK(size > 0, "empty stream");
+
+    // Skip the tick header
+    uint64_t data_offset;
+    std::memcpy(&data_offset, stream.data() + 8, sizeof(data_offset));
+    auto commands = stream_commands(stream.data() + data_offset + 8, stream.data() + size);
+
+    auto threshold = std::find(commands.begin(), commands.end(), Command::SET_THRESHOLD);
+    auto reference = std::find(commands.begin(), commands.end(), Command::UPDATE_REFERENCE);
+    CHECK(threshold < reference, "threshold lost before the first sample");
+
+    auto gap = std::find(reference, commands.end(), Command::DATA_GAP);
+    CHECK(gap != commands.end(), "no gap recorded");
+    CHECK(std::find(gap, commands.end(), Command::SET_TRIGGER) != commands.end(), "trigger rule lost in the gap");
+
+    return true;
+}
+
+
+bool test_udp_queue_capacity()
+{
+    std::vector<std::vector<uint8_t>> datagrams;
+    {
+        auto io = std::make_unique<DatagramWriter>(std::make_unique<CaptureIO>(datagrams));
+        CHECK(not io->open(access::Mode::READ_WRITE), "cannot open the datagram writer");
+
+        Probe probe;
+        probe.init("test_process", "test_task", START, 1ms, 42, std::move(io));
+        for (int i = 0; i < NUM_SAMPLES; ++i)
+        {
+            auto t = START + 20ms + nanoseconds(i * 1'000'000);
+            probe.log(t);
+            probe.log(t + 100us);
+            probe.flush();
+        }
+    }
+
+    auto data = std::find_if(datagrams.begin(), datagrams.end(), [](std::vector<uint8_t> const& datagram)
+    {
+        datagram::Header header;
+        std::memcpy(&header, datagram.data(), sizeof(header));
+        return header.type == datagram::STREAM_DATA;
+    });
+    CHECK(data != datagrams.end(), "no data datagram");
+    datagram::Header header;
+    std::memcpy(&header, data->data(), sizeof(header));
+
+    // A probe faster than the recorder: nothing is read while the datagrams keep coming
+    DatagramAssembler assembler(1s);
+    std::vector<std::unique_ptr<AbstractIO>> started;
+    assembler.dispatch("probe", datagrams.front().data(), datagrams.front().size(), 0ns, started);
+    CHECK(started.size() == 1, "stream not started");
+    datagram::Header first;
+    std::memcpy(&first, datagrams.front().data(), sizeof(first));
+
+    std::size_t const count = DatagramAssembler::QUEUE_CAPACITY / header.size + 100;
+    std::vector<uint8_t> datagram = *data;
+    for (std::size_t i = 0; i <= count; ++i)
+    {
+        header.sequence = first.sequence + 1 + i;
+        std::memcpy(datagram.data(), &header, sizeof(header));
+        assembler.dispatch("probe", datagram.data(), datagram.size(), 0ns, started);
+    }
+    CHECK(assembler.dropped() > 0, "queue not bounded");
+
+    std::vector<uint8_t> stream;
+    std::vector<uint8_t> buffer(64 * 1024);
+    int64_t size;
+    while ((size = started[0]->read(buffer.data(), static_cast<int64_t>(buffer.size()))) > 0)
+    {
+        stream.insert(stream.end(), buffer.begin(), buffer.begin() + size);
+    }
+    CHECK(stream.size() <= DatagramAssembler::QUEUE_CAPACITY + datagrams.front().size(), "queue over capacity");
+
+    // Once drained, the next datagram goes through after the gap
+    header.sequence = first.sequence + 2 + count;
+    std::memcpy(datagram.data(), &header, sizeof(header));
+    assembler.dispatch("probe", datagram.data(), datagram.size(), 0ns, started);
+    size = started[0]->read(buffer.data(), static_cast<int64_t>(buffer.size()));
+    CHECK(size == static_cast<int64_t>(sizeof(uint32_t) + sizeof(uint64_t) + header.size), "datagram not queued");
+
+    uint32_t word;
+    uint64_t gap;
+    std::memcpy(&word, buffer.data(), sizeof(word));
+    std::memcpy(&gap, buffer.data() + sizeof(word), sizeof(gap));
+    CHECK(word == (ESCAPE | Command::DATA_GAP) and gap == assembler.dropped(), "overflow not recorded as a gap");
+
+    return true;
+}
@@ -75,8 +75,7 @@ inline void recorder_loop(Recorder& recorder, AbstractListener& listener, nanose
     auto deadline = since_epoch() + timeout;
     while (since_epoch() < deadline)
     {
-        auto io = listener.accept(access::Mode::NON_BLOCKING);
-        if (io != nullptr)
+        while (auto io = listener.accept(access::Mode::NON_BLOCKING))
         {
             recorder.add_client(std::move(io));
         }
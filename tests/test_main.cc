@@ -6,6 +6,28 @@ bool test_tcp();
 bool test_empty_data();
 bool test_truncated_data();
 bool test_corrupted_data();
+bool test_async_io();
+bool test_rotation();
+bool test_fanout();
+bool test_udp();
+bool test_metrics();
+bool test_splice();
+bool test_direct_io();
+bool test_quota();
+bool test_relay();
+bool test_summary_index();
+bool test_connect_storm();
+bool test_mapped_parser();
+bool test_parallel_parser();
+bool test_time_range();
+bool test_delta_decode();
+bool test_visit();
+bool test_fused_series();
+bool test_follow();
+bool test_lod_cache();
+bool test_fanout_late_subscriber();
+bool test_udp_configuration();
+bool test_udp_queue_capacity();
 
 bool test_blackbox_no_trigger();
 bool test_blackbox_trigger();
@@ -13,6 +35,11 @@ bool test_blackbox_multiple_triggers();
 bool test_blackbox_retrigger_extends();
 bool test_blackbox_backward_compat();
 bool test_blackbox_file_header();
+bool test_blackbox_memory_budget();
+bool test_blackbox_correlated_trigger();
+bool test_blackbox_journal_recovery();
+bool test_journal_wrap_around();
+bool test_blackbox_trigger_rules();
 
 
 int main()
@@ -25,12 +52,39 @@ int main()
         {"empty_data",                 test_empty_data},
         {"truncated_data",             test_truncated_data},
         {"corrupted_data",             test_corrupted_data},
+        {"async_io",                   test_async_io},
+        {"rotation",                   test_rotation},
+        {"fanout",                     test_fanout},
+        {"udp",                        test_udp},
+        {"metrics",                    test_metrics},
+        {"splice",                     test_splice},
+        {"direct_io",                  test_direct_io},
+        {"quota",                      test_quota},
+        {"relay",                      test_relay},
+        {"summary_index",              test_summary_index},
+        {"connect_storm",              test_connect_storm},
+        {"mapped_parser",              test_mapped_parser},
+        {"parallel_parser",            test_parallel_parser},
+        {"time_range",                 test_time_range},
+        {"delta_decode",               test_delta_decode},
+        {"visit",                      test_visit},
+        {"fused_series",               test_fused_series},
+        {"follow",                     test_follow},
+        {"lod_cache",                  test_lod_cache},
+        {"fanout_late_subscriber",     test_fanout_late_subscriber},
+        {"udp_configuration",          test_udp_configuration},
+        {"udp_queue_capacity",         test_udp_queue_capacity},
         {"blackbox_no_trigger",        test_blackbox_no_trigger},
         {"blackbox_trigger",           test_blackbox_trigger},
         {"blackbox_multiple_triggers", test_blackbox_multiple_triggers},
         {"blackbox_retrigger_extends", test_blackbox_retrigger_extends},
         {"blackbox_backward_compat",   test_blackbox_backward_compat},
         {"blackbox_file_header",       test_blackbox_file_header},
+        {"blackbox_memory_budget",     test_blackbox_memory_budget},
+        {"blackbox_correlated_trigger",test_blackbox_correlated_trigger},
+        {"blackbox_journal_recovery",  test_blackbox_journal_recovery},
+        {"journal_wrap_around",        test_journal_wrap_around},
+        {"blackbox_trigger_rules",     test_blackbox_trigger_rules},
     };
 
     return run_tests(tests, std::size(tests));
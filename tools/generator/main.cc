@@ -1,8 +1,10 @@
 #include <argparse/argparse.hpp>
 #include "rtm/probe.h"
+#include "rtm/io/datagram.h"
 #include "rtm/io/file.h"
 #include "rtm/io/posix/local_socket.h"
 #include "rtm/io/posix/tcp_socket.h"
+#include "rtm/io/posix/udp_socket.h"
 
 using namespace std::chrono;
 
@@ -42,6 +44,10 @@ int main(int argc, char *argv[])
         .help("connect via TCP to host:port")
         .default_value(std::string{});
 
+    parser.add_argument("-u", "--udp")
+        .help("send datagrams to host:port")
+        .default_value(std::string{});
+
     try
     {
         parser.parse_args(argc, argv);
@@ -68,6 +74,13 @@ int main(int argc, char *argv[])
         io = std::make_unique<rtm::TcpSocket>(host, port);
         mode = rtm::access::Mode::READ_WRITE;
     }
+    else if (parser.is_used("--udp"))
+    {
+        auto [host, port] = parse_host_port(parser.get<std::string>("--udp"));
+        printf("Sending datagrams to %s:%u\n", host.c_str(), port);
+        io = std::make_unique<rtm::DatagramWriter>(std::make_unique<rtm::UdpSocket>(host, port));
+        mode = rtm::access::Mode::READ_WRITE;
+    }
     else if (parser.is_used("--listen"))
     {
         printf("Connecting via local socket to %s\n", listening_path.c_str());
@@ -1,9 +1,13 @@
+#include <algorithm>
 #include <csignal>
+#include <cerrno>
 #include <atomic>
 #include <argparse/argparse.hpp>
 
 #include "rtm/recorder.h"
+#include "rtm/relay.h"
 #include "rtm/os/time.h"
+#include "rtm/io/datagram.h"
 #include "rtm/io/posix/local_socket.h"
 #include "rtm/io/posix/tcp_socket.h"
 
@@ -19,6 +23,71 @@ void signal_handler(int signal)
     }
 }
 
+// Scrape in progress on the metrics socket
+struct MetricsRequest
+{
+    std::unique_ptr<AbstractSocket> io;
+    std::string request;
+    nanoseconds accepted;
+    std::string response{};     // empty until the request is read
+    std::size_t sent{0};
+};
+
+// A client that does not take its response in time is dropped
+constexpr nanoseconds METRICS_TIMEOUT = 10s;
+
+// Answer with a minimal HTTP response, so that both `curl --unix-socket` and a plain
+// `nc -U` get the Prometheus text. The response is written as the socket accepts it,
+// one step per loop: a slow client never stalls the ingestion. Returns true once the
+// request is served (or failed).
+static bool serve_metrics(MetricsRequest& request, Recorder& recorder)
+{
+    nanoseconds now = since_epoch();
+    if (request.response.empty())
+    {
+        char buffer[1024];
+        int64_t received = request.io->read(buffer, sizeof(buffer));
+        if (received > 0)
+        {
+            request.request.append(buffer, static_cast<std::size_t>(received));
+        }
+
+        bool complete = request.request.find("\r\n\r\n") != std::string::npos;
+        bool waited = now - request.accepted > 100ms;
+        if (not complete and not waited and received != 0)
+        {
+            return false;
+        }
+
+        std::string body = recorder.metrics().prometheus();
+        request.response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: ";
+        request.response += std::to_string(body.size());
+        request.response += "\r\n\r\n";
+        request.response += body;
+    }
+
+    while (request.sent < request.response.size())
+    {
+        int64_t written = request.io->write(request.response.data() + request.sent,
+                                            static_cast<int64_t>(request.response.size() - request.sent));
+        if (written < 0)
+        {
+            if (errno != EAGAIN)
+            {
+                return true;
+            }
+            if (now - request.accepted > METRICS_TIMEOUT)
+            {
+                printf("[Recorder] Metrics client too slow: dropped\n");
+                return true;
+            }
+            return false;
+        }
+        request.sent += static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
 static std::pair<std::string, uint16_t> parse_host_port(std::string const& str)
 {
     auto pos = str.rfind(':');
@@ -29,6 +98,68 @@ static std::pair<std::string, uint16_t> parse_host_port(std::string const& str)
     return {str.substr(0, pos), static_cast<uint16_t>(std::stoi(str.substr(pos + 1)))};
 }
 
+// <kind>:<value>[:<count>/<window>], durations in microseconds:
+// jitter:<us>, uptime:<us>, deviation:<%>, misses:<%>:<count>/<window>, p99:<%>:<window>
+static bool parse_trigger(std::string const& spec, TriggerRule& rule)
+{
+    auto colon = spec.find(':');
+    if (colon == std::string::npos)
+    {
+        return false;
+    }
+    std::string kind = spec.substr(0, colon);
+
+    unsigned long value = 0;
+    unsigned long count = 0;
+    unsigned long window = 0;
+    char const* args = spec.c_str() + colon + 1;
+    try
+    {
+        std::size_t end = 0;
+        value = std::stoul(args, &end);
+        args += end;
+        if (kind == "misses" and sscanf(args, ":%lu/%lu", &count, &window) != 2)
+        {
+            return false;
+        }
+        if (kind == "p99" and sscanf(args, ":%lu", &window) != 1)
+        {
+            return false;
+        }
+    }
+    catch (std::exception const&)
+    {
+        return false;
+    }
+
+    if (kind == "jitter" or kind == "uptime")
+    {
+        rule.kind = (kind == "jitter") ? TriggerKind::JITTER : TriggerKind::UP_TIME;
+        value *= 1000;
+    }
+    else if (kind == "deviation")
+    {
+        rule.kind = TriggerKind::PERIOD_DEVIATION;
+    }
+    else if (kind == "misses")
+    {
+        rule.kind = TriggerKind::MISSES;
+    }
+    else if (kind == "p99")
+    {
+        rule.kind = TriggerKind::ROLLING_P99;
+    }
+    else
+    {
+        return false;
+    }
+
+    rule.value = value;
+    rule.count = static_cast<uint16_t>(std::min(count, 0xFFFFul));
+    rule.window = static_cast<uint32_t>(std::min(window, 0xFFFFFFFFul));
+    return true;
+}
+
 int main(int argc, char* argv[])
 {
     std::signal(SIGINT, signal_handler);
@@ -49,6 +180,30 @@ int main(int argc, char* argv[])
         .help("listen on a TCP socket at [host:]port (repeatable)")
         .default_value(std::vector<std::string>{})
         .append();
+    parser.add_argument("-u", "--udp")
+        .help("receive probe datagrams on the given UDP port (repeatable)")
+        .default_value(std::vector<std::string>{})
+        .append();
+    parser.add_argument("--relay")
+        .help("relay mode: forward the probe streams to the upstream recorder at host:port instead of recording them")
+        .default_value(std::string{});
+    parser.add_argument("--relay-buffer")
+        .help("data kept while the upstream is unreachable in MiB, the oldest is dropped past it (default: 64)")
+        .default_value(64u)
+        .scan<'u', unsigned>();
+    parser.add_argument("--relay-compress")
+        .help("compress the sample data sent to the upstream")
+        .flag();
+    parser.add_argument("--relay-listen")
+        .help("accept relay recorders on a TCP socket at [host:]port (repeatable)")
+        .default_value(std::vector<std::string>{})
+        .append();
+    parser.add_argument("--subscribe-local")
+        .help("serve the live stream to subscribers on a local (Unix) socket at the given path")
+        .default_value(std::string{});
+    parser.add_argument("--subscribe-tcp")
+        .help("serve the live stream to subscribers on a TCP socket at [host:]port")
+        .default_value(std::string{});
     parser.add_argument("--pre-duration")
         .help("blackbox pre-event capture duration in seconds (default: 120)")
         .default_value(120u)
@@ -57,6 +212,53 @@ int main(int argc, char* argv[])
         .help("blackbox post-event capture duration in seconds (default: 120)")
         .default_value(120u)
         .scan<'u', unsigned>();
+    parser.add_argument("--memory-budget")
+        .help("memory budget for all blackbox rings in MiB, older data spills to disk (default: 0 = unlimited)")
+        .default_value(0u)
+        .scan<'u', unsigned>();
+    parser.add_argument("--spill-path")
+        .help("directory for blackbox spill files (default: <output>/.spill)")
+        .default_value(std::string{});
+    parser.add_argument("--rotate-size")
+        .help("start a new segment of continuous recordings every N MiB (default: 0 = never)")
+        .default_value(0u)
+        .scan<'u', unsigned>();
+    parser.add_argument("--rotate-interval")
+        .help("start a new segment of continuous recordings every N seconds of data (default: 0 = never)")
+        .default_value(0u)
+        .scan<'u', unsigned>();
+    parser.add_argument("--quota")
+        .help("keep the recordings under N MiB, deleting the oldest complete ones first (default: 0 = unlimited)")
+        .default_value(0u)
+        .scan<'u', unsigned>();
+    parser.add_argument("--splice")
+        .help("move continuous recordings from socket to file in the kernel (Linux splice, no fan-out)")
+        .flag();
+    parser.add_argument("--direct-io")
+        .help("write the recordings with O_DIRECT, bypassing the page cache")
+        .flag();
+    parser.add_argument("--journal")
+        .help("directory of the crash-surviving blackbox journals, ideally on a tmpfs (default: disabled)")
+        .default_value(std::string{});
+    parser.add_argument("--journal-size")
+        .help("capacity of each blackbox journal in MiB (default: 64)")
+        .default_value(64u)
+        .scan<'u', unsigned>();
+    parser.add_argument("--metrics")
+        .help("serve the recorder metrics (Prometheus text format) on a local (Unix) socket at the given path")
+        .default_value(std::string{});
+    parser.add_argument("--stats-interval")
+        .help("print a one-line summary of the metrics every N seconds (default: 0 = never)")
+        .default_value(0u)
+        .scan<'u', unsigned>();
+    parser.add_argument("--trigger")
+        .help("blackbox trigger rule of the probes that set a threshold or a rule (repeatable): jitter:<us>, "
+              "uptime:<us>, deviation:<%>, misses:<%>:<count>/<window>, p99:<%>:<window>")
+        .default_value(std::vector<std::string>{})
+        .append();
+    parser.add_argument("--correlated")
+        .help("on any blackbox trigger, dump every blackbox client into a shared incident directory")
+        .flag();
 
     try
     {
@@ -71,9 +273,11 @@ int main(int argc, char* argv[])
 
     auto local_args = parser.get<std::vector<std::string>>("--local");
     auto tcp_args   = parser.get<std::vector<std::string>>("--tcp");
+    auto udp_args   = parser.get<std::vector<std::string>>("--udp");
+    auto relay_args = parser.get<std::vector<std::string>>("--relay-listen");
 
     // Default to a local socket if nothing is specified
-    if (local_args.empty() and tcp_args.empty())
+    if (local_args.empty() and tcp_args.empty() and udp_args.empty() and relay_args.empty())
     {
         local_args.push_back(DEFAULT_LISTENING_PATH);
     }
@@ -89,12 +293,83 @@ int main(int argc, char* argv[])
 
     Recorder recorder{recording_path, pre_duration, post_duration};
 
+    auto memory_budget = parser.get<unsigned>("--memory-budget");
+    if (memory_budget > 0)
+    {
+        auto spill_path = parser.get<std::string>("--spill-path");
+        recorder.set_memory_budget(std::size_t{memory_budget} * 1024 * 1024, spill_path);
+        printf("[Recorder] Blackbox memory budget: %u MiB\n", memory_budget);
+    }
+
+    auto rotate_size = parser.get<unsigned>("--rotate-size");
+    auto rotate_interval = parser.get<unsigned>("--rotate-interval");
+    if (rotate_size > 0 or rotate_interval > 0)
+    {
+        recorder.set_rotation(std::size_t{rotate_size} * 1024 * 1024, std::chrono::seconds{rotate_interval});
+        printf("[Recorder] Segment rotation: %u MiB / %us\n", rotate_size, rotate_interval);
+    }
+
+    auto quota = parser.get<unsigned>("--quota");
+    if (quota > 0)
+    {
+        recorder.set_quota(uint64_t{quota} * 1024 * 1024);
+        printf("[Recorder] Disk quota: %u MiB\n", quota);
+    }
+
+    if (parser.get<bool>("--splice"))
+    {
+        recorder.set_splice(true);
+        printf("[Recorder] Zero-copy recording enabled\n");
+    }
+
+    if (parser.get<bool>("--direct-io"))
+    {
+        recorder.set_direct_io(true);
+        printf("[Recorder] Direct I/O enabled\n");
+    }
+
+    auto journal_path = parser.get<std::string>("--journal");
+    if (not journal_path.empty())
+    {
+        auto journal_size = parser.get<unsigned>("--journal-size");
+        recorder.set_journal(journal_path, std::size_t{journal_size} * 1024 * 1024);
+        printf("[Recorder] Blackbox journals: %s (%u MiB per client)\n", journal_path.c_str(), journal_size);
+    }
+
+    for (auto const& spec : parser.get<std::vector<std::string>>("--trigger"))
+    {
+        TriggerRule rule;
+        if (not parse_trigger(spec, rule) or not recorder.add_trigger(rule))
+        {
+            printf("[Recorder] Invalid trigger rule '%s'\n", spec.c_str());
+            return 1;
+        }
+        printf("[Recorder] Blackbox trigger rule: %s\n", spec.c_str());
+    }
+
+    if (parser.get<bool>("--correlated"))
+    {
+        recorder.set_correlated_trigger(true);
+        printf("[Recorder] Blackbox correlated trigger enabled\n");
+    }
+
+    auto relay = parser.get<std::string>("--relay");
+    if (not relay.empty())
+    {
+        auto [host, port] = parse_host_port(relay);
+        auto relay_buffer = parser.get<unsigned>("--relay-buffer");
+        recorder.set_relay(std::make_shared<RelayLink>(std::make_unique<TcpSocket>(host, port),
+                                                       std::size_t{relay_buffer} * 1024 * 1024,
+                                                       parser.get<bool>("--relay-compress")));
+        printf("[Recorder] Relaying to %s (buffer: %u MiB)\n", relay.c_str(), relay_buffer);
+    }
+
     // --- Set up local (Unix) listeners ---
     std::vector<std::unique_ptr<LocalListener>> local_listeners;
     for (auto const& path : local_args)
     {
         auto listener = std::make_unique<LocalListener>(path);
-        auto rc = listener->listen(1);
+        auto rc = listener->listen(LISTEN_BACKLOG);
         if (rc)
         {
             printf("[Recorder] listen() error on local '%s': %s\n", path.c_str(), rc.message().c_str());
@@ -110,7 +385,7 @@ int main(int argc, char* argv[])
     {
         auto [host, port] = parse_host_port(arg);
         auto listener = std::make_unique<TcpListener>(host, port);
-        auto rc = listener->listen(4);
+        auto rc = listener->listen(LISTEN_BACKLOG);
         if (rc)
         {
             printf("[Recorder] listen() error on TCP '%s': %s\n", arg.c_str(), rc.message().c_str());
@@ -125,12 +400,107 @@ int main(int argc, char* argv[])
         tcp_listeners.push_back(std::move(listener));
     }
 
+    // --- Set up UDP listeners ---
+    std::vector<std::unique_ptr<DatagramListener>> udp_listeners;
+    for (auto const& arg : udp_args)
+    {
+        auto port = static_cast<uint16_t>(std::stoi(arg));
+        auto listener = std::make_unique<DatagramListener>(port);
+        auto rc = listener->listen();
+        if (rc)
+        {
+            printf("[Recorder] listen() error on UDP '%s': %s\n", arg.c_str(), rc.message().c_str());
+            return 1;
+        }
+        printf("[Recorder] Listening on UDP *:%u\n", port);
+        udp_listeners.push_back(std::move(listener));
+    }
+
+    // --- Set up relay listeners ---
+    std::vector<std::unique_ptr<RelayListener>> relay_listeners;
+    for (auto const& arg : relay_args)
+    {
+        auto [host, port] = parse_host_port(arg);
+        auto listener = std::make_unique<RelayListener>(std::make_unique<TcpListener>(host, port));
+        auto rc = listener->listen(LISTEN_BACKLOG);
+        if (rc)
+        {
+            printf("[Recorder] listen() error on TCP '%s': %s\n", arg.c_str(), rc.message().c_str());
+            return 1;
+        }
+        printf("[Recorder] Accepting relays on TCP %s\n", arg.c_str());
+        relay_listeners.push_back(std::move(listener));
+    }
+
+    // --- Set up subscriber listeners ---
+    std::vector<std::unique_ptr<AbstractListener>> subscriber_listeners;
+    auto subscribe_local = parser.get<std::string>("--subscribe-local");
+    if (not subscribe_local.empty())
+    {
+        auto listener = std::make_unique<LocalListener>(subscribe_local);
+        auto rc = listener->listen(4);
+        if (rc)
+        {
+            printf("[Recorder] listen() error on local '%s': %s\n", subscribe_local.c_str(), rc.message().c_str());
+            return 1;
+        }
+        printf("[Recorder] Serving subscribers on local socket %s\n", subscribe_local.c_str());
+        subscriber_listeners.push_back(std::move(listener));
+    }
+    auto subscribe_tcp = parser.get<std::string>("--subscribe-tcp");
+    if (not subscribe_tcp.empty())
+    {
+        auto [host, port] = parse_host_port(subscribe_tcp);
+        auto listener = std::make_unique<TcpListener>(host, port);
+        auto rc = listener->listen(4);
+        if (rc)
+        {
+            printf("[Recorder] listen() error on TCP '%s': %s\n", subscribe_tcp.c_str(), rc.message().c_str());
+            return 1;
+        }
+        printf("[Recorder] Serving subscribers on TCP %s\n", subscribe_tcp.c_str());
+        subscriber_listeners.push_back(std::move(listener));
+    }
+    if (not subscriber_listeners.empty())
+    {
+        recorder.enable_fanout();
+    }
+
+    // --- Set up metrics ---
+    std::unique_ptr<LocalListener> metrics_listener;
+    std::vector<MetricsRequest> metrics_requests;
+    auto metrics_path = parser.get<std::string>("--metrics");
+    if (not metrics_path.empty())
+    {
+        metrics_listener = std::make_unique<LocalListener>(metrics_path);
+        auto rc = metrics_listener->listen(4);
+        if (rc)
+        {
+            printf("[Recorder] listen() error on local '%s': %s\n", metrics_path.c_str(), rc.message().c_str());
+            return 1;
+        }
+        printf("[Recorder] Serving metrics on local socket %s\n", metrics_path.c_str());
+    }
+    nanoseconds stats_interval = std::chrono::seconds{parser.get<unsigned>("--stats-interval")};
+    nanoseconds next_stats = since_epoch() + stats_interval;
+    if (stats_interval > 0ns)
+    {
+        recorder.metrics().summary(); // rates start now
+    }
+
     while (keep_running)
     {
+        for (auto& listener : subscriber_listeners)
+        {
+            while (auto io = listener->accept(access::Mode::NON_BLOCKING))
+            {
+                recorder.add_subscriber(std::move(io));
+            }
+        }
+
         for (auto& listener : local_listeners)
         {
-            auto io = listener->accept(access::Mode::NON_BLOCKING);
-            if (io != nullptr)
+            while (auto io = listener->accept(access::Mode::NON_BLOCKING))
             {
                 recorder.add_client(std::move(io));
             }
@@ -138,16 +508,52 @@ int main(int argc, char* argv[])
 
         for (auto& listener : tcp_listeners)
         {
-            auto io = listener->accept(access::Mode::NON_BLOCKING);
-            if (io != nullptr)
+            while (auto io = listener->accept(access::Mode::NON_BLOCKING))
+            {
+                recorder.add_client(std::move(io));
+            }
+        }
+
+        for (auto& listener : udp_listeners)
+        {
+            for (auto& io : listener->receive())
+            {
+                recorder.add_client(std::move(io));
+            }
+        }
+
+        for (auto& listener : relay_listeners)
+        {
+            for (auto& io : listener->receive())
             {
                 recorder.add_client(std::move(io));
             }
         }
 
         recorder.process();
+
+        if (metrics_listener != nullptr)
+        {
+            while (auto io = metrics_listener->accept(access::Mode::NON_BLOCKING))
+            {
+                metrics_requests.push_back({std::move(io), {}, since_epoch()});
+            }
+            metrics_requests.erase(std::remove_if(metrics_requests.begin(), metrics_requests.end(),
+                [&recorder](MetricsRequest& request) { return serve_metrics(request, recorder); }), metrics_requests.end());
+        }
+
+        if (stats_interval > 0ns and since_epoch() >= next_stats)
+        {
+            printf("[Recorder] %s\n", recorder.metrics().summary().c_str());
+            next_stats += stats_interval;
+        }
+
         sleep(1ms);
     }
 
+    auto stats = recorder.stats();
+    printf("[Recorder] Stopping: %zu client(s), blackbox rings %zu B in RAM / %zu B spilled\n",
+           stats.clients, stats.ring_ram_bytes, stats.ring_spilled_bytes);
+
     return 0;
 }